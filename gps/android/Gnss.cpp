@@ -21,6 +21,7 @@
 #define LOG_TAG "LocSvc_GnssInterface"
 
 #include <fstream>
+#include <inttypes.h>
 #include <log_util.h>
 #include <dlfcn.h>
 #include <cutils/properties.h>
@@ -321,6 +322,43 @@ Return<sp<V1_0::IGnssDebug>> Gnss::getExtensionGnssDebug() {
     return mGnssDebug;
 }
 
+static void dumpMsgLane(int fd, const char* name, const GnssDebugMsgLane& lane) {
+    dprintf(fd, "  %s lane: depth %u max %u total %" PRIu64 " dropped %" PRIu64
+            " rejected %" PRIu64 " blocked %" PRIu64 "\n",
+            name, lane.depth, lane.maxDepth, lane.total, lane.dropped,
+            lane.rejected, lane.blocked);
+}
+
+Return<void> Gnss::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& /*options*/) {
+    ENTRY_LOG_CALLFLOW();
+    if (fd == nullptr || fd->numFds < 1) {
+        LOC_LOGE("%s]: no fd to dump to", __func__);
+        return Void();
+    }
+    GnssInterface* gnssInterface = getGnssInterface();
+    if (nullptr == gnssInterface) {
+        LOC_LOGE("%s]: getGnssInterface is nullptr", __func__);
+        return Void();
+    }
+
+    GnssDebugReport report;
+    gnssInterface->getDebugReport(report);
+    const GnssDebugMsgTask& msgTask = report.mMsgTask;
+    int out = fd->data[0];
+    dprintf(out, "GnssAdapter msg queue:\n");
+    dprintf(out, "  pool: hits %" PRIu64 " misses %" PRIu64 "\n",
+            msgTask.poolHits, msgTask.poolMisses);
+    dumpMsgLane(out, "control", msgTask.mControlLane);
+    dumpMsgLane(out, "telemetry", msgTask.mTelemetryLane);
+    dprintf(out, "  %-32s %10s %10s %10s %10s %10s %10s %10s\n", "type", "count",
+            "wait p50", "wait p99", "wait max", "proc p50", "proc p99", "proc max");
+    for (const GnssDebugMsgType& t : msgTask.mMsgTypes) {
+        dprintf(out, "  %-32s %10u %10u %10u %10u %10u %10u %10u\n", t.name, t.count,
+                t.waitP50Us, t.waitP99Us, t.waitMaxUs, t.procP50Us, t.procP99Us, t.procMaxUs);
+    }
+    return Void();
+}
+
 Return<sp<V1_0::IAGnssRil>> Gnss::getExtensionAGnssRil() {
     mGnssRil = new AGnssRil(this);
     return mGnssRil;
@@ -44,6 +44,7 @@ namespace V1_0 {
 namespace implementation {
 
 using ::android::hardware::hidl_array;
+using ::android::hardware::hidl_handle;
 using ::android::hardware::hidl_memory;
 using ::android::hardware::hidl_string;
 using ::android::hardware::hidl_vec;
@@ -95,6 +96,9 @@ struct Gnss : public IGnss {
 
     Return<sp<V1_0::IGnssDebug>> getExtensionGnssDebug() override;
 
+    // Dumps the msg queue stats of the GNSS adapter, for lshal debug
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
+
     // These methods are not part of the IGnss base class.
     GnssAPIClient* getApi();
     Return<bool> setGnssNiCb(const sp<IGnssNiCallback>& niCb);
@@ -89,6 +89,24 @@ public:
         mMsgTask->sendMsg(msg);
     }
 
+    inline void sendMsg(const LocMsg* msg, MsgTask::Priority priority) const {
+        mMsgTask->sendMsg(msg, priority);
+    }
+
+    inline void sendMsg(const LocMsg* msg, MsgTask::Priority priority) {
+        mMsgTask->sendMsg(msg, priority);
+    }
+
+    inline void sendMsg(const LocMsg* msg, MsgTask::Priority priority,
+                        const void* coalesceKey) const {
+        mMsgTask->sendMsg(msg, priority, coalesceKey);
+    }
+
+    inline void sendMsg(const LocMsg* msg, MsgTask::Priority priority,
+                        const void* coalesceKey) {
+        mMsgTask->sendMsg(msg, priority, coalesceKey);
+    }
+
     inline void updateEvtMask(LOC_API_ADAPTER_EVENT_MASK_T event,
                               loc_registration_mask_status status)
     {
@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <LocDualContext.h>
 #include <msg_q.h>
+#include <LocExecutor.h>
 #include <log_util.h>
 #include <loc_log.h>
 
@@ -70,7 +71,31 @@ const MsgTask* LocDualContext::getMsgTask(LocThread::tCreate tCreator,
                                           const char* name, bool joinable)
 {
     if (NULL == mMsgTask) {
-        mMsgTask = new MsgTask(tCreator, name, joinable);
+        uint32_t ringSize = 0;
+        uint32_t executor = 0;
+        uint32_t capacity = 0;
+        uint32_t overflowPolicy = MsgTask::OVERFLOW_DROP_OLDEST;
+        const loc_param_s_type gps_conf_param_table[] =
+        {
+            {"MSG_TASK_RING_SIZE", &ringSize, NULL, 'n'},
+            {"MSG_TASK_EXECUTOR", &executor, NULL, 'n'},
+            {"MSG_TASK_CAPACITY", &capacity, NULL, 'n'},
+            {"MSG_TASK_OVERFLOW_POLICY", &overflowPolicy, NULL, 'n'},
+        };
+        UTIL_READ_CONF(LOC_PATH_GPS_CONF, gps_conf_param_table);
+        // the adapters send msgs to their own MsgTask, so it must not block
+        if (MsgTask::OVERFLOW_REJECT != overflowPolicy) {
+            overflowPolicy = MsgTask::OVERFLOW_DROP_OLDEST;
+        }
+        // a custom tCreator may do more than create a thread, e.g. attach it
+        // to a VM, so with one the MsgTask keeps a thread of its own
+        if (executor && NULL == tCreator && LocExecutor::start()) {
+            mMsgTask = new MsgTask(*LocExecutor::getInstance(), ringSize, capacity,
+                                   (MsgTask::OverflowPolicy)overflowPolicy);
+        } else {
+            mMsgTask = new MsgTask(tCreator, name, joinable, ringSize, capacity,
+                                   (MsgTask::OverflowPolicy)overflowPolicy);
+        }
     }
     return mMsgTask;
 }
@@ -51,36 +51,13 @@ namespace loc_core
 class SystemStatusNmeaBase
 {
 protected:
-    std::vector<std::string> mField;
+    // the fields, in place in the sentence, which outlives the parser
+    LocNmeaFields mField;
 
     SystemStatusNmeaBase(const char *str_in, uint32_t len_in)
-    {
         // check size and talker
-        if (!loc_nmea_is_debug(str_in, len_in)) {
-            return;
-        }
-
-        std::string parser(str_in);
-        std::string::size_type index = 0;
-
-        // verify checksum field
-        index = parser.find("*");
-        if (index == std::string::npos) {
-            return;
-        }
-        parser[index] = ',';
-
-        // tokenize parser
-        while (1) {
-            std::string str;
-            index = parser.find(",");
-            if (index == std::string::npos) {
-                break;
-            }
-            str = parser.substr(0, index);
-            parser = parser.substr(index + 1);
-            mField.push_back(str);
-        }
+        : mField(str_in, loc_nmea_is_debug(str_in, len_in) ? len_in : 0)
+    {
     }
 
     virtual ~SystemStatusNmeaBase() { }
@@ -207,43 +184,43 @@ public:
     {
         memset(&mM1, 0, sizeof(mM1));
         if (mField.size() <= eMax0) {
-            LOC_LOGE("PQWM1parser - invalid size=%zu", mField.size());
+            LOC_LOGE("PQWM1parser - invalid size=%u", mField.size());
             mM1.mTimeValid = 0;
             return;
         }
-        mM1.mGpsWeek = atoi(mField[eGpsWeek].c_str());
-        mM1.mGpsTowMs = atoi(mField[eGpsTowMs].c_str());
-        mM1.mTimeValid = atoi(mField[eTimeValid].c_str());
-        mM1.mTimeSource = atoi(mField[eTimeSource].c_str());
-        mM1.mTimeUnc = atoi(mField[eTimeUnc].c_str());
-        mM1.mClockFreqBias = atoi(mField[eClockFreqBias].c_str());
-        mM1.mClockFreqBiasUnc = atoi(mField[eClockFreqBiasUnc].c_str());
-        mM1.mXoState = atoi(mField[eXoState].c_str());
-        mM1.mPgaGain = atoi(mField[ePgaGain].c_str());
-        mM1.mGpsBpAmpI = atoi(mField[eGpsBpAmpI].c_str());
-        mM1.mGpsBpAmpQ = atoi(mField[eGpsBpAmpQ].c_str());
-        mM1.mAdcI = atoi(mField[eAdcI].c_str());
-        mM1.mAdcQ = atoi(mField[eAdcQ].c_str());
-        mM1.mJammerGps = atoi(mField[eJammerGps].c_str());
-        mM1.mJammerGlo = atoi(mField[eJammerGlo].c_str());
-        mM1.mJammerBds = atoi(mField[eJammerBds].c_str());
-        mM1.mJammerGal = atoi(mField[eJammerGal].c_str());
-        mM1.mRecErrorRecovery = atoi(mField[eRecErrorRecovery].c_str());
-        mM1.mAgcGps = atof(mField[eAgcGps].c_str());
-        mM1.mAgcGlo = atof(mField[eAgcGlo].c_str());
-        mM1.mAgcBds = atof(mField[eAgcBds].c_str());
-        mM1.mAgcGal = atof(mField[eAgcGal].c_str());
+        mM1.mGpsWeek = mField.getInt(eGpsWeek);
+        mM1.mGpsTowMs = mField.getInt(eGpsTowMs);
+        mM1.mTimeValid = mField.getInt(eTimeValid);
+        mM1.mTimeSource = mField.getInt(eTimeSource);
+        mM1.mTimeUnc = mField.getInt(eTimeUnc);
+        mM1.mClockFreqBias = mField.getInt(eClockFreqBias);
+        mM1.mClockFreqBiasUnc = mField.getInt(eClockFreqBiasUnc);
+        mM1.mXoState = mField.getInt(eXoState);
+        mM1.mPgaGain = mField.getInt(ePgaGain);
+        mM1.mGpsBpAmpI = mField.getInt(eGpsBpAmpI);
+        mM1.mGpsBpAmpQ = mField.getInt(eGpsBpAmpQ);
+        mM1.mAdcI = mField.getInt(eAdcI);
+        mM1.mAdcQ = mField.getInt(eAdcQ);
+        mM1.mJammerGps = mField.getInt(eJammerGps);
+        mM1.mJammerGlo = mField.getInt(eJammerGlo);
+        mM1.mJammerBds = mField.getInt(eJammerBds);
+        mM1.mJammerGal = mField.getInt(eJammerGal);
+        mM1.mRecErrorRecovery = mField.getInt(eRecErrorRecovery);
+        mM1.mAgcGps = mField.getDouble(eAgcGps);
+        mM1.mAgcGlo = mField.getDouble(eAgcGlo);
+        mM1.mAgcBds = mField.getDouble(eAgcBds);
+        mM1.mAgcGal = mField.getDouble(eAgcGal);
         if (mField.size() > eLeapSecUnc) {
-            mM1.mLeapSeconds = atoi(mField[eLeapSeconds].c_str());
-            mM1.mLeapSecUnc = atoi(mField[eLeapSecUnc].c_str());
+            mM1.mLeapSeconds = mField.getInt(eLeapSeconds);
+            mM1.mLeapSecUnc = mField.getInt(eLeapSecUnc);
         }
         if (mField.size() > eGalBpAmpQ) {
-            mM1.mGloBpAmpI = atoi(mField[eGloBpAmpI].c_str());
-            mM1.mGloBpAmpQ = atoi(mField[eGloBpAmpQ].c_str());
-            mM1.mBdsBpAmpI = atoi(mField[eBdsBpAmpI].c_str());
-            mM1.mBdsBpAmpQ = atoi(mField[eBdsBpAmpQ].c_str());
-            mM1.mGalBpAmpI = atoi(mField[eGalBpAmpI].c_str());
-            mM1.mGalBpAmpQ = atoi(mField[eGalBpAmpQ].c_str());
+            mM1.mGloBpAmpI = mField.getInt(eGloBpAmpI);
+            mM1.mGloBpAmpQ = mField.getInt(eGloBpAmpQ);
+            mM1.mBdsBpAmpI = mField.getInt(eBdsBpAmpI);
+            mM1.mBdsBpAmpQ = mField.getInt(eBdsBpAmpQ);
+            mM1.mGalBpAmpI = mField.getInt(eGalBpAmpI);
+            mM1.mGalBpAmpQ = mField.getInt(eGalBpAmpQ);
         }
     }
 
@@ -299,13 +276,13 @@ public:
             return;
         }
         memset(&mP1, 0, sizeof(mP1));
-        mP1.mEpiValidity = strtol(mField[eEpiValidity].c_str(), NULL, 16);
-        mP1.mEpiLat = atof(mField[eEpiLat].c_str());
-        mP1.mEpiLon = atof(mField[eEpiLon].c_str());
-        mP1.mEpiAlt = atof(mField[eEpiAlt].c_str());
-        mP1.mEpiHepe = atoi(mField[eEpiHepe].c_str());
-        mP1.mEpiAltUnc = atof(mField[eEpiAltUnc].c_str());
-        mP1.mEpiSrc = atoi(mField[eEpiSrc].c_str());
+        mP1.mEpiValidity = mField.getHex(eEpiValidity);
+        mP1.mEpiLat = mField.getDouble(eEpiLat);
+        mP1.mEpiLon = mField.getDouble(eEpiLon);
+        mP1.mEpiAlt = mField.getDouble(eEpiAlt);
+        mP1.mEpiHepe = mField.getInt(eEpiHepe);
+        mP1.mEpiAltUnc = mField.getDouble(eEpiAltUnc);
+        mP1.mEpiSrc = mField.getInt(eEpiSrc);
     }
 
     inline SystemStatusPQWP1& get() { return mP1;}
@@ -354,11 +331,11 @@ public:
             return;
         }
         memset(&mP2, 0, sizeof(mP2));
-        mP2.mBestLat = atof(mField[eBestLat].c_str());
-        mP2.mBestLon = atof(mField[eBestLon].c_str());
-        mP2.mBestAlt = atof(mField[eBestAlt].c_str());
-        mP2.mBestHepe = atof(mField[eBestHepe].c_str());
-        mP2.mBestAltUnc = atof(mField[eBestAltUnc].c_str());
+        mP2.mBestLat = mField.getDouble(eBestLat);
+        mP2.mBestLon = mField.getDouble(eBestLon);
+        mP2.mBestAlt = mField.getDouble(eBestAlt);
+        mP2.mBestHepe = mField.getDouble(eBestHepe);
+        mP2.mBestAltUnc = mField.getDouble(eBestAltUnc);
     }
 
     inline SystemStatusPQWP2& get() { return mP2;}
@@ -425,17 +402,17 @@ public:
             return;
         }
         memset(&mP3, 0, sizeof(mP3));
-        mP3.mXtraValidMask = strtol(mField[eXtraValidMask].c_str(), NULL, 16);
-        mP3.mGpsXtraAge = atoi(mField[eGpsXtraAge].c_str());
-        mP3.mGloXtraAge = atoi(mField[eGloXtraAge].c_str());
-        mP3.mBdsXtraAge = atoi(mField[eBdsXtraAge].c_str());
-        mP3.mGalXtraAge = atoi(mField[eGalXtraAge].c_str());
-        mP3.mQzssXtraAge = atoi(mField[eQzssXtraAge].c_str());
-        mP3.mGpsXtraValid = strtol(mField[eGpsXtraValid].c_str(), NULL, 16);
-        mP3.mGloXtraValid = strtol(mField[eGloXtraValid].c_str(), NULL, 16);
-        mP3.mBdsXtraValid = strtol(mField[eBdsXtraValid].c_str(), NULL, 16);
-        mP3.mGalXtraValid = strtol(mField[eGalXtraValid].c_str(), NULL, 16);
-        mP3.mQzssXtraValid = strtol(mField[eQzssXtraValid].c_str(), NULL, 16);
+        mP3.mXtraValidMask = mField.getHex(eXtraValidMask);
+        mP3.mGpsXtraAge = mField.getInt(eGpsXtraAge);
+        mP3.mGloXtraAge = mField.getInt(eGloXtraAge);
+        mP3.mBdsXtraAge = mField.getInt(eBdsXtraAge);
+        mP3.mGalXtraAge = mField.getInt(eGalXtraAge);
+        mP3.mQzssXtraAge = mField.getInt(eQzssXtraAge);
+        mP3.mGpsXtraValid = mField.getHex(eGpsXtraValid);
+        mP3.mGloXtraValid = mField.getHex(eGloXtraValid);
+        mP3.mBdsXtraValid = mField.getHex(eBdsXtraValid);
+        mP3.mGalXtraValid = mField.getHex(eGalXtraValid);
+        mP3.mQzssXtraValid = mField.getHex(eQzssXtraValid);
     }
 
     inline SystemStatusPQWP3& get() { return mP3;}
@@ -484,11 +461,11 @@ public:
             return;
         }
         memset(&mP4, 0, sizeof(mP4));
-        mP4.mGpsEpheValid = strtol(mField[eGpsEpheValid].c_str(), NULL, 16);
-        mP4.mGloEpheValid = strtol(mField[eGloEpheValid].c_str(), NULL, 16);
-        mP4.mBdsEpheValid = strtol(mField[eBdsEpheValid].c_str(), NULL, 16);
-        mP4.mGalEpheValid = strtol(mField[eGalEpheValid].c_str(), NULL, 16);
-        mP4.mQzssEpheValid = strtol(mField[eQzssEpheValid].c_str(), NULL, 16);
+        mP4.mGpsEpheValid = mField.getHex(eGpsEpheValid);
+        mP4.mGloEpheValid = mField.getHex(eGloEpheValid);
+        mP4.mBdsEpheValid = mField.getHex(eBdsEpheValid);
+        mP4.mGalEpheValid = mField.getHex(eGalEpheValid);
+        mP4.mQzssEpheValid = mField.getHex(eQzssEpheValid);
     }
 
     inline SystemStatusPQWP4& get() { return mP4;}
@@ -567,21 +544,21 @@ public:
             return;
         }
         memset(&mP5, 0, sizeof(mP5));
-        mP5.mGpsUnknownMask = strtol(mField[eGpsUnknownMask].c_str(), NULL, 16);
-        mP5.mGloUnknownMask = strtol(mField[eGloUnknownMask].c_str(), NULL, 16);
-        mP5.mBdsUnknownMask = strtol(mField[eBdsUnknownMask].c_str(), NULL, 16);
-        mP5.mGalUnknownMask = strtol(mField[eGalUnknownMask].c_str(), NULL, 16);
-        mP5.mQzssUnknownMask = strtol(mField[eQzssUnknownMask].c_str(), NULL, 16);
-        mP5.mGpsGoodMask = strtol(mField[eGpsGoodMask].c_str(), NULL, 16);
-        mP5.mGloGoodMask = strtol(mField[eGloGoodMask].c_str(), NULL, 16);
-        mP5.mBdsGoodMask = strtol(mField[eBdsGoodMask].c_str(), NULL, 16);
-        mP5.mGalGoodMask = strtol(mField[eGalGoodMask].c_str(), NULL, 16);
-        mP5.mQzssGoodMask = strtol(mField[eQzssGoodMask].c_str(), NULL, 16);
-        mP5.mGpsBadMask = strtol(mField[eGpsBadMask].c_str(), NULL, 16);
-        mP5.mGloBadMask = strtol(mField[eGloBadMask].c_str(), NULL, 16);
-        mP5.mBdsBadMask = strtol(mField[eBdsBadMask].c_str(), NULL, 16);
-        mP5.mGalBadMask = strtol(mField[eGalBadMask].c_str(), NULL, 16);
-        mP5.mQzssBadMask = strtol(mField[eQzssBadMask].c_str(), NULL, 16);
+        mP5.mGpsUnknownMask = mField.getHex(eGpsUnknownMask);
+        mP5.mGloUnknownMask = mField.getHex(eGloUnknownMask);
+        mP5.mBdsUnknownMask = mField.getHex(eBdsUnknownMask);
+        mP5.mGalUnknownMask = mField.getHex(eGalUnknownMask);
+        mP5.mQzssUnknownMask = mField.getHex(eQzssUnknownMask);
+        mP5.mGpsGoodMask = mField.getHex(eGpsGoodMask);
+        mP5.mGloGoodMask = mField.getHex(eGloGoodMask);
+        mP5.mBdsGoodMask = mField.getHex(eBdsGoodMask);
+        mP5.mGalGoodMask = mField.getHex(eGalGoodMask);
+        mP5.mQzssGoodMask = mField.getHex(eQzssGoodMask);
+        mP5.mGpsBadMask = mField.getHex(eGpsBadMask);
+        mP5.mGloBadMask = mField.getHex(eGloBadMask);
+        mP5.mBdsBadMask = mField.getHex(eBdsBadMask);
+        mP5.mGalBadMask = mField.getHex(eGalBadMask);
+        mP5.mQzssBadMask = mField.getHex(eQzssBadMask);
     }
 
     inline SystemStatusPQWP5& get() { return mP5;}
@@ -618,7 +595,7 @@ public:
             return;
         }
         memset(&mP6, 0, sizeof(mP6));
-        mP6.mFixInfoMask = strtol(mField[eFixInfoMask].c_str(), NULL, 16);
+        mP6.mFixInfoMask = mField.getHex(eFixInfoMask);
     }
 
     inline SystemStatusPQWP6& get() { return mP6;}
@@ -649,13 +626,13 @@ public:
         : SystemStatusNmeaBase(str_in, len_in)
     {
         if (mField.size() < eMax) {
-            LOC_LOGE("PQWP7parser - invalid size=%zu", mField.size());
+            LOC_LOGE("PQWP7parser - invalid size=%u", mField.size());
             return;
         }
         for (uint32_t i=0; i<SV_ALL_NUM; i++) {
-            mP7.mNav[i].mType   = GnssEphemerisType(atoi(mField[i*3+2].c_str()));
-            mP7.mNav[i].mSource = GnssEphemerisSource(atoi(mField[i*3+3].c_str()));
-            mP7.mNav[i].mAgeSec = atoi(mField[i*3+4].c_str());
+            mP7.mNav[i].mType   = GnssEphemerisType(mField.getInt(i*3+2));
+            mP7.mNav[i].mSource = GnssEphemerisSource(mField.getInt(i*3+3));
+            mP7.mNav[i].mAgeSec = mField.getInt(i*3+4);
         }
     }
 
@@ -696,8 +673,8 @@ public:
             return;
         }
         memset(&mS1, 0, sizeof(mS1));
-        mS1.mFixInfoMask = atoi(mField[eFixInfoMask].c_str());
-        mS1.mHepeLimit = atoi(mField[eHepeLimit].c_str());
+        mS1.mFixInfoMask = mField.getInt(eFixInfoMask);
+        mS1.mHepeLimit = mField.getInt(eHepeLimit);
     }
 
     inline SystemStatusPQWS1& get() { return mS1;}
@@ -1355,7 +1332,8 @@ bool SystemStatus::setNmeaString(const char *data, uint32_t len)
         return false;
     }
 
-    char buf[SystemStatusNmeaBase::NMEA_MAXSIZE + 1] = { 0 };
+    // the parsers below take their fields in place, out of this copy
+    char buf[SystemStatusNmeaBase::NMEA_MAXSIZE + 1];
     strlcpy(buf, data, sizeof(buf));
 
     pthread_mutex_lock(&mMutexSystemStatus);
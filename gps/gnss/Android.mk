@@ -20,8 +20,10 @@ LOCAL_SHARED_LIBRARIES := \
 LOCAL_SRC_FILES += \
     location_gnss.cpp \
     GnssAdapter.cpp \
+    GnssTrace.cpp \
     Agps.cpp \
-    XtraSystemStatusObserver.cpp
+    XtraSystemStatusObserver.cpp \
+    XtraSystemStatusCodec.cpp
 
 LOCAL_CFLAGS += \
      -fno-short-enums \
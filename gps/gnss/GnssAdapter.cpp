@@ -80,7 +80,8 @@ GnssAdapter::GnssAdapter() :
     mOdcpiRequest(),
     mSystemStatus(SystemStatus::getInstance(mMsgTask)),
     mServerUrl(":"),
-    mXtraObserver(mSystemStatus->getOsObserver(), mMsgTask)
+    mXtraObserver(mSystemStatus->getOsObserver(), mMsgTask),
+    mTrace(GnssTraceRecorder::createFromConfig())
 {
     LOC_LOGD("%s]: Constructor %p", __func__, this);
     mUlpPositionMode.mode = LOC_POSITION_MODE_INVALID;
@@ -728,6 +729,10 @@ GnssAdapter::gnssUpdateConfigCommand(GnssConfig config)
 
     LOC_LOGD("%s]: ids %s flags 0x%X", __func__, idsString.c_str(), config.flags);
 
+    if (nullptr != mTrace) {
+        mTrace->recordUpdateConfig(config);
+    }
+
     struct MsgGnssUpdateConfig : public LocMsg {
         GnssAdapter& mAdapter;
         LocApiBase& mApi;
@@ -928,6 +933,10 @@ GnssAdapter::gnssDeleteAidingDataCommand(GnssAidingData& data)
     uint32_t sessionId = generateSessionId();
     LOC_LOGD("%s]: id %u", __func__, sessionId);
 
+    if (nullptr != mTrace) {
+        mTrace->recordDeleteAidingData(data);
+    }
+
     struct MsgDeleteAidingData : public LocMsg {
         GnssAdapter& mAdapter;
         LocApiBase& mApi;
@@ -1098,6 +1107,10 @@ GnssAdapter::addClientCommand(LocationAPI* client, const LocationCallbacks& call
 {
     LOC_LOGD("%s]: client %p", __func__, client);
 
+    if (nullptr != mTrace) {
+        mTrace->recordAddClient(client, callbacks);
+    }
+
     struct MsgAddClient : public LocMsg {
         GnssAdapter& mAdapter;
         LocationAPI* mClient;
@@ -1122,6 +1135,10 @@ GnssAdapter::removeClientCommand(LocationAPI* client)
 {
     LOC_LOGD("%s]: client %p", __func__, client);
 
+    if (nullptr != mTrace) {
+        mTrace->recordRemoveClient(client);
+    }
+
     struct MsgRemoveClient : public LocMsg {
         GnssAdapter& mAdapter;
         LocationAPI* mClient;
@@ -1454,6 +1471,10 @@ GnssAdapter::startTrackingCommand(LocationAPI* client, LocationOptions& options)
     LOC_LOGD("%s]: client %p id %u minInterval %u mode %u",
              __func__, client, sessionId, options.minInterval, options.mode);
 
+    if (nullptr != mTrace) {
+        mTrace->recordTracking(GNSS_TRACE_START_TRACKING, client, sessionId, &options);
+    }
+
     struct MsgStartTracking : public LocMsg {
         GnssAdapter& mAdapter;
         LocApiBase& mApi;
@@ -1602,6 +1623,10 @@ GnssAdapter::updateTrackingOptionsCommand(LocationAPI* client, uint32_t id,
     LOC_LOGD("%s]: client %p id %u minInterval %u mode %u",
              __func__, client, id, options.minInterval, options.mode);
 
+    if (nullptr != mTrace) {
+        mTrace->recordTracking(GNSS_TRACE_UPDATE_TRACKING, client, id, &options);
+    }
+
     struct MsgUpdateTracking : public LocMsg {
         GnssAdapter& mAdapter;
         LocApiBase& mApi;
@@ -1686,6 +1711,10 @@ GnssAdapter::stopTrackingCommand(LocationAPI* client, uint32_t id)
 {
     LOC_LOGD("%s]: client %p id %u", __func__, client, id);
 
+    if (nullptr != mTrace) {
+        mTrace->recordTracking(GNSS_TRACE_STOP_TRACKING, client, id, nullptr);
+    }
+
     struct MsgStopTracking : public LocMsg {
         GnssAdapter& mAdapter;
         LocApiBase& mApi;
@@ -2044,6 +2073,11 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
         }
     }
 
+    // only what the adapter itself processes is recorded, and replayed as fromUlp
+    if (nullptr != mTrace) {
+        mTrace->recordPosition(ulpLocation, locationExtended, status, techMask);
+    }
+
     struct MsgReportPosition : public LocMsg {
         GnssAdapter& mAdapter;
         const UlpLocation mUlpLocation;
@@ -2061,6 +2095,13 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
             mLocationExtended(locationExtended),
             mStatus(status),
             mTechMask(techMask) {}
+        inline virtual ~MsgReportPosition() {
+            // rawData is freed by reportPosition(), unless this report got
+            // superseded by a newer one before it could be processed
+            if (nullptr != mUlpLocation.rawData) {
+                delete (char*)mUlpLocation.rawData;
+            }
+        }
         inline virtual void proc() const {
             // extract bug report info - this returns true if consumed by systemstatus
             SystemStatus* s = mAdapter.getSystemStatus();
@@ -2072,7 +2113,20 @@ GnssAdapter::reportPositionEvent(const UlpLocation& ulpLocation,
         }
     };
 
-    sendMsg(new MsgReportPosition(*this, ulpLocation, locationExtended, status, techMask));
+    MsgReportPosition* msg = new (*mMsgTask) MsgReportPosition(*this, ulpLocation,
+                                                               locationExtended,
+                                                               status, techMask);
+    MsgTask::nameMsgType(msg, "MsgReportPosition");
+    // A stale intermediate position is of no use once a newer one is queued,
+    // but final fixes are all reported, in order. GnssAdapter is a singleton,
+    // so a key per message type is unique.
+    static const char sCoalesceKey = 0;
+    if (LOC_SESS_INTERMEDIATE == status) {
+        sendMsg(msg, MsgTask::PRIORITY_TELEMETRY, &sCoalesceKey);
+    } else {
+        mMsgTask->closeCoalescing(&sCoalesceKey);
+        sendMsg(msg, MsgTask::PRIORITY_TELEMETRY);
+    }
 }
 
 bool
@@ -2165,6 +2219,10 @@ GnssAdapter::reportSvEvent(const GnssSvNotification& svNotify,
         }
     }
 
+    if (nullptr != mTrace) {
+        mTrace->recordSv(svNotify);
+    }
+
     struct MsgReportSv : public LocMsg {
         GnssAdapter& mAdapter;
         const GnssSvNotification mSvNotify;
@@ -2178,7 +2236,11 @@ GnssAdapter::reportSvEvent(const GnssSvNotification& svNotify,
         }
     };
 
-    sendMsg(new MsgReportSv(*this, svNotify));
+    MsgReportSv* msg = new (*mMsgTask) MsgReportSv(*this, svNotify);
+    MsgTask::nameMsgType(msg, "MsgReportSv");
+    // a stale SV report is of no use once a newer one is queued
+    static const char sCoalesceKey = 0;
+    sendMsg(msg, MsgTask::PRIORITY_TELEMETRY, &sCoalesceKey);
 }
 
 void
@@ -2259,16 +2321,23 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length, bool fromUlp)
         }
     }
 
+    if (nullptr != mTrace) {
+        mTrace->recordNmea(nmea, length);
+    }
+
     struct MsgReportNmea : public LocMsg {
         GnssAdapter& mAdapter;
         const char* mNmea;
         size_t mLength;
+        // regular sentences fit in here, so that only the odd long
+        // one needs a heap allocation of its own
+        char mNmeaBuf[NMEA_SENTENCE_MAX_LENGTH + 1];
         inline MsgReportNmea(GnssAdapter& adapter,
                              const char* nmea,
                              size_t length) :
             LocMsg(),
             mAdapter(adapter),
-            mNmea(new char[length+1]),
+            mNmea((length < sizeof(mNmeaBuf)) ? mNmeaBuf : new char[length+1]),
             mLength(length) {
                 if (mNmea == nullptr) {
                     LOC_LOGE("%s] new allocation failed, fatal error.", __func__);
@@ -2278,7 +2347,9 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length, bool fromUlp)
             }
         inline virtual ~MsgReportNmea()
         {
-            delete[] mNmea;
+            if (mNmea != mNmeaBuf) {
+                delete[] mNmea;
+            }
         }
         inline virtual void proc() const {
             // extract bug report info - this returns true if consumed by systemstatus
@@ -2294,7 +2365,9 @@ GnssAdapter::reportNmeaEvent(const char* nmea, size_t length, bool fromUlp)
         }
     };
 
-    sendMsg(new MsgReportNmea(*this, nmea, length));
+    MsgReportNmea* msg = new (*mMsgTask) MsgReportNmea(*this, nmea, length);
+    MsgTask::nameMsgType(msg, "MsgReportNmea");
+    sendMsg(msg, MsgTask::PRIORITY_TELEMETRY);
 }
 
 void
@@ -2486,6 +2559,10 @@ GnssAdapter::reportGnssMeasurementDataEvent(const GnssMeasurementsNotification&
 {
     LOC_LOGD("%s]: msInWeek=%d", __func__, msInWeek);
 
+    if (nullptr != mTrace) {
+        mTrace->recordMeasurements(measurements, msInWeek);
+    }
+
     struct MsgReportGnssMeasurementData : public LocMsg {
         GnssAdapter& mAdapter;
         GnssMeasurementsNotification mMeasurementsNotify;
@@ -2504,7 +2581,10 @@ GnssAdapter::reportGnssMeasurementDataEvent(const GnssMeasurementsNotification&
         }
     };
 
-    sendMsg(new MsgReportGnssMeasurementData(*this, measurements, msInWeek));
+    MsgReportGnssMeasurementData* msg =
+            new (*mMsgTask) MsgReportGnssMeasurementData(*this, measurements, msInWeek);
+    MsgTask::nameMsgType(msg, "MsgReportGnssMeasurementData");
+    sendMsg(msg, MsgTask::PRIORITY_TELEMETRY);
 }
 
 void
@@ -3135,10 +3215,55 @@ void GnssAdapter::convertSatelliteInfo(std::vector<GnssDebugSatelliteInfo>& out,
     return;
 }
 
+static void
+getDebugMsgLane(const MsgTask& msgTask, MsgTask::Priority priority, GnssDebugMsgLane& out)
+{
+    LocMsgLaneStats stats = {};
+    msgTask.getLaneStats(priority, stats);
+    out.size = sizeof(out);
+    out.depth = stats.depth;
+    out.maxDepth = stats.maxDepth;
+    out.total = stats.total;
+    out.dropped = stats.dropped;
+    out.rejected = stats.rejected;
+    out.blocked = stats.blocked;
+}
+
+void
+GnssAdapter::getDebugMsgTask(GnssDebugMsgTask& out)
+{
+    LocMsgPoolStats poolStats = {};
+    mMsgTask->getPoolStats(poolStats);
+    out.size = sizeof(out);
+    out.poolHits = poolStats.hits;
+    out.poolMisses = poolStats.misses;
+    getDebugMsgLane(*mMsgTask, MsgTask::PRIORITY_CONTROL, out.mControlLane);
+    getDebugMsgLane(*mMsgTask, MsgTask::PRIORITY_TELEMETRY, out.mTelemetryLane);
+
+    LocMsgTypeStats typeStats[GNSS_DEBUG_MSG_TYPES_MAX];
+    uint32_t count = mMsgTask->getMsgTypeStats(typeStats, GNSS_DEBUG_MSG_TYPES_MAX);
+    out.mMsgTypes.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        GnssDebugMsgType t = {};
+        t.size = sizeof(t);
+        strlcpy(t.name, typeStats[i].name, sizeof(t.name));
+        t.count = typeStats[i].count;
+        t.waitP50Us = typeStats[i].waitP50Us;
+        t.waitP99Us = typeStats[i].waitP99Us;
+        t.waitMaxUs = typeStats[i].waitMaxUs;
+        t.procP50Us = typeStats[i].procP50Us;
+        t.procP99Us = typeStats[i].procP99Us;
+        t.procMaxUs = typeStats[i].procMaxUs;
+        out.mMsgTypes.push_back(t);
+    }
+}
+
 bool GnssAdapter::getDebugReport(GnssDebugReport& r)
 {
     LOC_LOGD("%s]: ", __func__);
 
+    getDebugMsgTask(r.mMsgTask);
+
     SystemStatus* systemstatus = getSystemStatus();
     if (nullptr == systemstatus) {
         return false;
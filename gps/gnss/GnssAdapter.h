@@ -36,6 +36,7 @@
 #include <Agps.h>
 #include <SystemStatus.h>
 #include <XtraSystemStatusObserver.h>
+#include <GnssTrace.h>
 
 #define MAX_URL_LEN 256
 #define NMEA_SENTENCE_MAX_LENGTH 200
@@ -44,6 +45,7 @@
 #define LOC_NI_NO_RESPONSE_TIME 20
 #define LOC_GPS_NI_RESPONSE_IGNORE 4
 #define ODCPI_EXPECTED_INJECTION_TIME_MS 10000
+#define GNSS_DEBUG_MSG_TYPES_MAX 64
 
 class GnssAdapter;
 
@@ -151,6 +153,10 @@ class GnssAdapter : public LocAdapterBase {
     std::string mServerUrl;
     XtraSystemStatusObserver mXtraObserver;
 
+    /* ==== TRACE ========================================================================== */
+    // records the events and commands below for host side replay, NULL unless configured
+    GnssTraceRecorder* mTrace;
+
     /*==== CONVERSION ===================================================================*/
     static void convertOptions(LocPosMode& out, const LocationOptions& options);
     static void convertLocation(Location& out, const LocGpsLocation& locGpsLocation,
@@ -306,6 +312,8 @@ public:
 
     /*======== GNSSDEBUG ================================================================*/
     bool getDebugReport(GnssDebugReport& report);
+    /* get the stats of the msg queue of the adapter */
+    void getDebugMsgTask(GnssDebugMsgTask& msgTask);
     /* get AGC information from system status and fill it */
     void getAgcInformation(GnssMeasurementsNotification& measurements, int msInWeek);
 
@@ -0,0 +1,597 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_GnssTrace"
+
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <loc_cfg.h>
+#include <log_util.h>
+#include <GnssTrace.h>
+
+// the trace is written through stdio buffering and pushed out at most
+// this often, so that recording costs no write() per event
+#define GNSS_TRACE_FLUSH_INTERVAL_NS 1000000000ULL
+
+static inline uint64_t gnssTraceNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*****GnssTraceRecorder methods*****/
+
+GnssTraceRecorder::GnssTraceRecorder(FILE* file) :
+    mFile(file), mMutex(PTHREAD_MUTEX_INITIALIZER), mFlushNs(gnssTraceNowNs()),
+    mNextClientId(0), mClientIds()
+{
+}
+
+GnssTraceRecorder::~GnssTraceRecorder()
+{
+    fclose(mFile);
+    pthread_mutex_destroy(&mMutex);
+}
+
+GnssTraceRecorder* GnssTraceRecorder::createFromConfig()
+{
+    GnssTraceRecorder* recorder = NULL;
+#ifndef TARGET_BUILD_VARIANT_USER
+    char path[LOC_MAX_PARAM_STRING + 1] = {0};
+    const loc_param_s_type gps_conf_param_table[] =
+    {
+        {"GNSS_TRACE_FILE", &path, NULL, 's'},
+    };
+    UTIL_READ_CONF(LOC_PATH_GPS_CONF, gps_conf_param_table);
+
+    if ('\0' != path[0]) {
+        FILE* file = fopen(path, "w");
+        GnssTraceFileHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = GNSS_TRACE_MAGIC;
+        header.version = GNSS_TRACE_VERSION;
+        header.pointerSize = sizeof(void*);
+        header.positionSize = sizeof(GnssTracePosition);
+        header.measurementSize = sizeof(GnssMeasurementsData);
+
+        if (NULL == file) {
+            LOC_LOGE("%s]: failed to open %s, errno %d", __func__, path, errno);
+        } else if (1 != fwrite(&header, sizeof(header), 1, file)) {
+            LOC_LOGE("%s]: failed to write %s, errno %d", __func__, path, errno);
+            fclose(file);
+        } else {
+            LOC_LOGI("%s]: recording GNSS trace to %s", __func__, path);
+            recorder = new GnssTraceRecorder(file);
+        }
+    }
+#endif
+    return recorder;
+}
+
+// must be called with mMutex held
+uint32_t GnssTraceRecorder::getClientId(const LocationAPI* client)
+{
+    auto it = mClientIds.find(client);
+    if (it == mClientIds.end()) {
+        it = mClientIds.emplace(client, mNextClientId++).first;
+    }
+    return it->second;
+}
+
+void GnssTraceRecorder::record(GnssTraceRecordType type, const void* data, size_t length,
+                               const void* data2, size_t length2)
+{
+    GnssTraceRecordHeader header;
+    header.length = length + length2;
+    header.type = type;
+    header.reserved = 0;
+
+    pthread_mutex_lock(&mMutex);
+    // stamped under the lock, so that timestamps never go back in the file
+    header.timestampNs = gnssTraceNowNs();
+    if (1 != fwrite(&header, sizeof(header), 1, mFile) ||
+        (length > 0 && 1 != fwrite(data, length, 1, mFile)) ||
+        (length2 > 0 && 1 != fwrite(data2, length2, 1, mFile))) {
+        LOC_LOGE("%s]: failed to write record type %u, errno %d", __func__, type, errno);
+    }
+    if (header.timestampNs - mFlushNs >= GNSS_TRACE_FLUSH_INTERVAL_NS) {
+        fflush(mFile);
+        mFlushNs = header.timestampNs;
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void GnssTraceRecorder::recordPosition(const UlpLocation& ulpLocation,
+                                       const GpsLocationExtended& locationExtended,
+                                       enum loc_sess_status status, LocPosTechMask techMask)
+{
+    GnssTracePosition position;
+    memset(&position, 0, sizeof(position));
+    position.ulpLocation = ulpLocation;
+    position.ulpLocation.rawDataSize = 0;
+    position.ulpLocation.rawData = NULL;
+    position.locationExtended = locationExtended;
+    position.status = status;
+    position.techMask = techMask;
+    record(GNSS_TRACE_POSITION, &position, sizeof(position));
+}
+
+void GnssTraceRecorder::recordSv(const GnssSvNotification& svNotify)
+{
+    size_t count = (svNotify.count < GNSS_SV_MAX) ? svNotify.count : GNSS_SV_MAX;
+    record(GNSS_TRACE_SV, svNotify.gnssSvs, count * sizeof(GnssSv));
+}
+
+void GnssTraceRecorder::recordNmea(const char* nmea, size_t length)
+{
+    record(GNSS_TRACE_NMEA, nmea, length);
+}
+
+void GnssTraceRecorder::recordMeasurements(const GnssMeasurementsNotification& measurements,
+                                           int msInWeek)
+{
+    GnssTraceMeasurements header;
+    memset(&header, 0, sizeof(header));
+    header.msInWeek = msInWeek;
+    header.clock = measurements.clock;
+    size_t count = (measurements.count < GNSS_MEASUREMENTS_MAX) ?
+            measurements.count : GNSS_MEASUREMENTS_MAX;
+    record(GNSS_TRACE_MEASUREMENTS, &header, sizeof(header),
+           measurements.measurements, count * sizeof(GnssMeasurementsData));
+}
+
+void GnssTraceRecorder::recordAddClient(const LocationAPI* client,
+                                        const LocationCallbacks& callbacks)
+{
+    GnssTraceClient traceClient;
+    traceClient.callbacksMask =
+            ((nullptr != callbacks.trackingCb) ? GNSS_TRACE_CB_TRACKING : 0) |
+            ((nullptr != callbacks.gnssLocationInfoCb) ? GNSS_TRACE_CB_LOCATION_INFO : 0) |
+            ((nullptr != callbacks.gnssSvCb) ? GNSS_TRACE_CB_SV : 0) |
+            ((nullptr != callbacks.gnssNmeaCb) ? GNSS_TRACE_CB_NMEA : 0) |
+            ((nullptr != callbacks.gnssMeasurementsCb) ? GNSS_TRACE_CB_MEASUREMENTS : 0);
+
+    pthread_mutex_lock(&mMutex);
+    traceClient.clientId = getClientId(client);
+    pthread_mutex_unlock(&mMutex);
+    record(GNSS_TRACE_ADD_CLIENT, &traceClient, sizeof(traceClient));
+}
+
+void GnssTraceRecorder::recordRemoveClient(const LocationAPI* client)
+{
+    GnssTraceClient traceClient;
+    traceClient.callbacksMask = 0;
+
+    pthread_mutex_lock(&mMutex);
+    traceClient.clientId = getClientId(client);
+    // a later client at the same address is a new one
+    mClientIds.erase(client);
+    pthread_mutex_unlock(&mMutex);
+    record(GNSS_TRACE_REMOVE_CLIENT, &traceClient, sizeof(traceClient));
+}
+
+void GnssTraceRecorder::recordTracking(GnssTraceRecordType type, const LocationAPI* client,
+                                       uint32_t sessionId, const LocationOptions* options)
+{
+    GnssTraceTracking tracking;
+    memset(&tracking, 0, sizeof(tracking));
+    tracking.sessionId = sessionId;
+    if (NULL != options) {
+        tracking.options = *options;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    tracking.clientId = getClientId(client);
+    pthread_mutex_unlock(&mMutex);
+    record(type, &tracking, sizeof(tracking));
+}
+
+void GnssTraceRecorder::recordUpdateConfig(const GnssConfig& config)
+{
+    GnssConfig traceConfig = config;
+    const char* hostName = traceConfig.assistanceServer.hostName;
+    traceConfig.assistanceServer.hostName = NULL;
+
+    if ((traceConfig.flags & GNSS_CONFIG_FLAGS_SET_ASSISTANCE_DATA_VALID_BIT) &&
+        NULL != hostName) {
+        record(GNSS_TRACE_UPDATE_CONFIG, &traceConfig, sizeof(traceConfig),
+               hostName, strlen(hostName) + 1);
+    } else {
+        record(GNSS_TRACE_UPDATE_CONFIG, &traceConfig, sizeof(traceConfig));
+    }
+}
+
+void GnssTraceRecorder::recordDeleteAidingData(const GnssAidingData& data)
+{
+    record(GNSS_TRACE_DELETE_AIDING_DATA, &data, sizeof(data));
+}
+
+/*****GnssTraceReader methods*****/
+
+bool GnssTraceReader::open(const char* path)
+{
+    close();
+    mFile = fopen(path, "r");
+    if (NULL == mFile) {
+        LOC_LOGE("%s]: failed to open %s, errno %d", __func__, path, errno);
+        return false;
+    }
+
+    GnssTraceFileHeader header;
+    if (1 != fread(&header, sizeof(header), 1, mFile) ||
+        GNSS_TRACE_MAGIC != header.magic ||
+        GNSS_TRACE_VERSION != header.version) {
+        LOC_LOGE("%s]: %s is not a GNSS trace", __func__, path);
+        close();
+        return false;
+    }
+    if (sizeof(void*) != header.pointerSize ||
+        sizeof(GnssTracePosition) != header.positionSize ||
+        sizeof(GnssMeasurementsData) != header.measurementSize) {
+        LOC_LOGE("%s]: %s was recorded by a build with another struct layout",
+                 __func__, path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void GnssTraceReader::close()
+{
+    if (NULL != mFile) {
+        fclose(mFile);
+        mFile = NULL;
+    }
+}
+
+bool GnssTraceReader::next(GnssTraceRecordHeader& header, std::vector<uint8_t>& payload)
+{
+    if (NULL == mFile || 1 != fread(&header, sizeof(header), 1, mFile)) {
+        return false;
+    }
+    payload.resize(header.length);
+    if (header.length > 0 && 1 != fread(payload.data(), header.length, 1, mFile)) {
+        LOC_LOGW("%s]: truncated record type %u", __func__, header.type);
+        return false;
+    }
+    return true;
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+#include <list>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <GnssAdapter.h>
+
+// The adapter uses the LocationAPI pointer of a client as a key only,
+// so the replayed clients are just distinct addresses.
+#define GNSS_TRACE_REPLAY_MAX_CLIENTS 64
+static char sReplayClients[GNSS_TRACE_REPLAY_MAX_CLIENTS];
+
+// Feeds a trace into a real GnssAdapter. Without libloc_api_v02.so, as on a
+// host, the adapter runs on top of the LocApiBase stub, so this measures the
+// HAL side of the event flow only.
+class GnssTraceReplayer {
+    GnssAdapter* mAdapter;
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    bool mDrained;
+    std::map<uint64_t, uint64_t> mPositionsInFlight; // fix timestamp -> inject time
+    std::vector<uint64_t> mLatenciesNs;
+    uint32_t mLocationCbs;
+    uint32_t mSvCbs;
+    uint32_t mNmeaCbs;
+    uint32_t mMeasurementsCbs;
+    std::map<uint32_t, uint32_t> mSessionIds;         // recorded -> replayed
+    std::list<std::string> mHostNames;
+
+    static inline LocationAPI* getClient(uint32_t clientId) {
+        return (clientId < GNSS_TRACE_REPLAY_MAX_CLIENTS) ?
+                reinterpret_cast<LocationAPI*>(&sReplayClients[clientId]) : nullptr;
+    }
+    template <typename T>
+    static inline bool copyPayload(T& out, const std::vector<uint8_t>& payload) {
+        if (payload.size() < sizeof(T)) {
+            return false;
+        }
+        memcpy(&out, payload.data(), sizeof(T));
+        return true;
+    }
+    uint32_t getSessionId(uint32_t recordedId) {
+        auto it = mSessionIds.find(recordedId);
+        return (it == mSessionIds.end()) ? 0 : it->second;
+    }
+
+    void onLocation(uint64_t timestamp) {
+        uint64_t nowNs = gnssTraceNowNs();
+        pthread_mutex_lock(&mMutex);
+        mLocationCbs++;
+        auto it = mPositionsInFlight.find(timestamp);
+        if (it != mPositionsInFlight.end()) {
+            mLatenciesNs.push_back(nowNs - it->second);
+            // fixes ahead of this one were filtered out by the adapter
+            mPositionsInFlight.erase(mPositionsInFlight.begin(), ++it);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    LocationCallbacks getCallbacks(uint32_t callbacksMask) {
+        LocationCallbacks callbacks = {};
+        callbacks.size = sizeof(LocationCallbacks);
+        callbacks.capabilitiesCb = [](LocationCapabilitiesMask) {};
+        callbacks.responseCb = [](LocationError, uint32_t) {};
+        callbacks.collectiveResponseCb = [](size_t, LocationError*, uint32_t*) {};
+        if (callbacksMask & GNSS_TRACE_CB_TRACKING) {
+            callbacks.trackingCb = [this](Location location) {
+                onLocation(location.timestamp);
+            };
+        }
+        if (callbacksMask & GNSS_TRACE_CB_LOCATION_INFO) {
+            callbacks.gnssLocationInfoCb = [](GnssLocationInfoNotification) {};
+        }
+        if (callbacksMask & GNSS_TRACE_CB_SV) {
+            callbacks.gnssSvCb = [this](GnssSvNotification) {
+                __atomic_add_fetch(&mSvCbs, 1, __ATOMIC_RELAXED);
+            };
+        }
+        if (callbacksMask & GNSS_TRACE_CB_NMEA) {
+            callbacks.gnssNmeaCb = [this](GnssNmeaNotification) {
+                __atomic_add_fetch(&mNmeaCbs, 1, __ATOMIC_RELAXED);
+            };
+        }
+        if (callbacksMask & GNSS_TRACE_CB_MEASUREMENTS) {
+            callbacks.gnssMeasurementsCb = [this](GnssMeasurementsNotification) {
+                __atomic_add_fetch(&mMeasurementsCbs, 1, __ATOMIC_RELAXED);
+            };
+        }
+        return callbacks;
+    }
+
+public:
+    inline GnssTraceReplayer(GnssAdapter* adapter) :
+        mAdapter(adapter), mMutex(PTHREAD_MUTEX_INITIALIZER),
+        mCond(PTHREAD_COND_INITIALIZER), mDrained(false),
+        mLocationCbs(0), mSvCbs(0), mNmeaCbs(0), mMeasurementsCbs(0) {}
+
+    bool inject(const GnssTraceRecordHeader& header, std::vector<uint8_t>& payload) {
+        switch (header.type) {
+        case GNSS_TRACE_POSITION: {
+            GnssTracePosition position;
+            if (!copyPayload(position, payload)) {
+                return false;
+            }
+            pthread_mutex_lock(&mMutex);
+            mPositionsInFlight[position.ulpLocation.gpsLocation.timestamp] = gnssTraceNowNs();
+            pthread_mutex_unlock(&mMutex);
+            mAdapter->reportPositionEvent(position.ulpLocation, position.locationExtended,
+                                          (enum loc_sess_status)position.status,
+                                          position.techMask, true);
+            break;
+        }
+        case GNSS_TRACE_SV: {
+            GnssSvNotification svNotify;
+            memset(&svNotify, 0, sizeof(svNotify));
+            svNotify.size = sizeof(svNotify);
+            svNotify.count = std::min(payload.size() / sizeof(GnssSv), (size_t)GNSS_SV_MAX);
+            memcpy(svNotify.gnssSvs, payload.data(), svNotify.count * sizeof(GnssSv));
+            mAdapter->reportSvEvent(svNotify, true);
+            break;
+        }
+        case GNSS_TRACE_NMEA: {
+            size_t length = payload.size();
+            payload.push_back('\0');
+            mAdapter->reportNmeaEvent((const char*)payload.data(), length, true);
+            break;
+        }
+        case GNSS_TRACE_MEASUREMENTS: {
+            GnssTraceMeasurements traceMeasurements;
+            if (!copyPayload(traceMeasurements, payload)) {
+                return false;
+            }
+            GnssMeasurementsNotification measurements;
+            memset(&measurements, 0, sizeof(measurements));
+            measurements.size = sizeof(measurements);
+            measurements.clock = traceMeasurements.clock;
+            measurements.count = std::min(
+                    (payload.size() - sizeof(traceMeasurements)) / sizeof(GnssMeasurementsData),
+                    (size_t)GNSS_MEASUREMENTS_MAX);
+            memcpy(measurements.measurements, payload.data() + sizeof(traceMeasurements),
+                   measurements.count * sizeof(GnssMeasurementsData));
+            mAdapter->reportGnssMeasurementDataEvent(measurements, traceMeasurements.msInWeek);
+            break;
+        }
+        case GNSS_TRACE_ADD_CLIENT:
+        case GNSS_TRACE_REMOVE_CLIENT: {
+            GnssTraceClient traceClient;
+            if (!copyPayload(traceClient, payload) ||
+                nullptr == getClient(traceClient.clientId)) {
+                return false;
+            }
+            if (GNSS_TRACE_ADD_CLIENT == header.type) {
+                mAdapter->addClientCommand(getClient(traceClient.clientId),
+                                           getCallbacks(traceClient.callbacksMask));
+            } else {
+                mAdapter->removeClientCommand(getClient(traceClient.clientId));
+            }
+            break;
+        }
+        case GNSS_TRACE_START_TRACKING:
+        case GNSS_TRACE_UPDATE_TRACKING:
+        case GNSS_TRACE_STOP_TRACKING: {
+            GnssTraceTracking tracking;
+            if (!copyPayload(tracking, payload) ||
+                nullptr == getClient(tracking.clientId)) {
+                return false;
+            }
+            LocationAPI* client = getClient(tracking.clientId);
+            if (GNSS_TRACE_START_TRACKING == header.type) {
+                mSessionIds[tracking.sessionId] =
+                        mAdapter->startTrackingCommand(client, tracking.options);
+            } else if (GNSS_TRACE_UPDATE_TRACKING == header.type) {
+                mAdapter->updateTrackingOptionsCommand(
+                        client, getSessionId(tracking.sessionId), tracking.options);
+            } else {
+                mAdapter->stopTrackingCommand(client, getSessionId(tracking.sessionId));
+                mSessionIds.erase(tracking.sessionId);
+            }
+            break;
+        }
+        case GNSS_TRACE_UPDATE_CONFIG: {
+            GnssConfig config;
+            if (!copyPayload(config, payload)) {
+                return false;
+            }
+            config.assistanceServer.hostName = NULL;
+            if (payload.size() > sizeof(config)) {
+                // the config msg keeps the host name pointer, so it must outlive it
+                mHostNames.emplace_back((const char*)payload.data() + sizeof(config),
+                                        payload.size() - sizeof(config) - 1);
+                config.assistanceServer.hostName = mHostNames.back().c_str();
+            } else {
+                config.flags &= ~GNSS_CONFIG_FLAGS_SET_ASSISTANCE_DATA_VALID_BIT;
+            }
+            // the returned ids belong to the config msg
+            mAdapter->gnssUpdateConfigCommand(config);
+            break;
+        }
+        case GNSS_TRACE_DELETE_AIDING_DATA: {
+            GnssAidingData data;
+            if (!copyPayload(data, payload)) {
+                return false;
+            }
+            mAdapter->gnssDeleteAidingDataCommand(data);
+            break;
+        }
+        default:
+            return false;
+        }
+        return true;
+    }
+
+    // waits until the adapter has processed everything injected so far
+    void drain() {
+        struct MsgReplayDrained : public LocMsg {
+            GnssTraceReplayer& mReplayer;
+            inline MsgReplayDrained(GnssTraceReplayer& replayer) :
+                LocMsg(), mReplayer(replayer) {}
+            inline virtual void proc() const {
+                pthread_mutex_lock(&mReplayer.mMutex);
+                mReplayer.mDrained = true;
+                pthread_cond_signal(&mReplayer.mCond);
+                pthread_mutex_unlock(&mReplayer.mMutex);
+            }
+        };
+
+        pthread_mutex_lock(&mMutex);
+        mDrained = false;
+        pthread_mutex_unlock(&mMutex);
+        mAdapter->sendMsg(new MsgReplayDrained(*this));
+        pthread_mutex_lock(&mMutex);
+        while (!mDrained) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    void printStats() {
+        pthread_mutex_lock(&mMutex);
+        printf("callbacks: location %u sv %u nmea %u measurements %u\n",
+               mLocationCbs, mSvCbs, mNmeaCbs, mMeasurementsCbs);
+        if (!mLatenciesNs.empty()) {
+            std::sort(mLatenciesNs.begin(), mLatenciesNs.end());
+            size_t n = mLatenciesNs.size();
+            printf("position to callback latency: %zu fixes, p50 %.1f us, "
+                   "p99 %.1f us, max %.1f us\n", n,
+                   mLatenciesNs[n / 2] / 1000.0,
+                   mLatenciesNs[(n * 99) / 100] / 1000.0,
+                   mLatenciesNs[n - 1] / 1000.0);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+// on linux command line, with the location HAL libraries built for the host:
+// build: make check, for gnss_trace_replay, linked with libgnss, libloc_core
+//        and libgps_utils
+// record: GNSS_TRACE_FILE = /data/vendor/location/gnss.trace in gps.conf
+// replay at recorded speed: ./gnss_trace_replay gnss.trace
+// replay as fast as possible: ./gnss_trace_replay gnss.trace fast
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <trace> [fast]\n", argv[0]);
+        return 1;
+    }
+    bool fast = (argc > 2 && 0 == strcmp(argv[2], "fast"));
+
+    GnssTraceReader reader;
+    if (!reader.open(argv[1])) {
+        printf("failed to open trace %s\n", argv[1]);
+        return 1;
+    }
+
+    GnssAdapter* adapter = new GnssAdapter();
+    GnssTraceReplayer replayer(adapter);
+    GnssTraceRecordHeader header;
+    std::vector<uint8_t> payload;
+    uint64_t firstNs = 0;
+    uint32_t records = 0;
+    uint32_t skipped = 0;
+    uint64_t startNs = gnssTraceNowNs();
+
+    while (reader.next(header, payload)) {
+        if (0 == records + skipped) {
+            firstNs = header.timestampNs;
+        }
+        if (!fast) {
+            uint64_t dueNs = startNs + (header.timestampNs - firstNs);
+            struct timespec due = { (time_t)(dueNs / 1000000000ULL),
+                                    (long)(dueNs % 1000000000ULL) };
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+        }
+        if (replayer.inject(header, payload)) {
+            records++;
+        } else {
+            skipped++;
+        }
+    }
+    replayer.drain();
+
+    double seconds = (gnssTraceNowNs() - startNs) / 1e9;
+    printf("replayed %u records (%u skipped) in %.3f s, %.0f records/s%s\n",
+           records, skipped, seconds, records / seconds, fast ? ", as fast as possible" : "");
+    replayer.printStats();
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef GNSS_TRACE_H
+#define GNSS_TRACE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <vector>
+#include <unordered_map>
+#include <gps_extended.h>
+#include <LocationAPI.h>
+
+/* A GNSS trace is a GnssTraceFileHeader followed by records, each of them a
+   GnssTraceRecordHeader and length bytes of payload. Payloads are the HAL
+   structs as laid out in memory, so a trace only replays on a build with the
+   same struct layout; the header carries enough to reject the others. */
+#define GNSS_TRACE_MAGIC   0x43525447 /* "GTRC" */
+#define GNSS_TRACE_VERSION 1
+
+typedef enum {
+    GNSS_TRACE_POSITION = 1,      // GnssTracePosition
+    GNSS_TRACE_SV,                // GnssSv[]
+    GNSS_TRACE_NMEA,              // NMEA sentence, not NUL terminated
+    GNSS_TRACE_MEASUREMENTS,      // GnssTraceMeasurements, GnssMeasurementsData[]
+    GNSS_TRACE_ADD_CLIENT,        // GnssTraceClient
+    GNSS_TRACE_REMOVE_CLIENT,     // GnssTraceClient
+    GNSS_TRACE_START_TRACKING,    // GnssTraceTracking
+    GNSS_TRACE_UPDATE_TRACKING,   // GnssTraceTracking
+    GNSS_TRACE_STOP_TRACKING,     // GnssTraceTracking
+    GNSS_TRACE_UPDATE_CONFIG,     // GnssConfig, assistance server host name
+    GNSS_TRACE_DELETE_AIDING_DATA // GnssAidingData
+} GnssTraceRecordType;
+
+typedef struct {
+    uint32_t magic;               // GNSS_TRACE_MAGIC
+    uint16_t version;             // GNSS_TRACE_VERSION
+    uint16_t pointerSize;         // sizeof(void*) of the recording build
+    uint32_t positionSize;        // sizeof(GnssTracePosition)
+    uint32_t measurementSize;     // sizeof(GnssMeasurementsData)
+} GnssTraceFileHeader;
+
+typedef struct {
+    uint64_t timestampNs;         // CLOCK_MONOTONIC time the event entered the adapter
+    uint32_t length;              // payload length in bytes
+    uint16_t type;                // GnssTraceRecordType
+    uint16_t reserved;
+} GnssTraceRecordHeader;
+
+typedef struct {
+    UlpLocation ulpLocation;      // rawData is not recorded
+    GpsLocationExtended locationExtended;
+    uint32_t status;              // enum loc_sess_status
+    LocPosTechMask techMask;
+} GnssTracePosition;
+
+typedef struct {
+    int32_t msInWeek;
+    GnssMeasurementsClock clock;
+} GnssTraceMeasurements;
+
+typedef enum {
+    GNSS_TRACE_CB_TRACKING      = (1<<0),
+    GNSS_TRACE_CB_LOCATION_INFO = (1<<1),
+    GNSS_TRACE_CB_SV            = (1<<2),
+    GNSS_TRACE_CB_NMEA          = (1<<3),
+    GNSS_TRACE_CB_MEASUREMENTS  = (1<<4)
+} GnssTraceCallbackBits;
+
+typedef struct {
+    uint32_t clientId;            // clients are numbered in the order they are first seen
+    uint32_t callbacksMask;       // bitwise OR of GnssTraceCallbackBits
+} GnssTraceClient;
+
+typedef struct {
+    uint32_t clientId;
+    uint32_t sessionId;
+    LocationOptions options;
+} GnssTraceTracking;
+
+// Records the events and commands entering GnssAdapter into a trace file.
+// Calls come from the LocApi thread and the client threads alike.
+class GnssTraceRecorder {
+    FILE* mFile;
+    pthread_mutex_t mMutex;
+    uint64_t mFlushNs;
+    uint32_t mNextClientId;
+    std::unordered_map<const LocationAPI*, uint32_t> mClientIds;
+
+    GnssTraceRecorder(FILE* file);
+    uint32_t getClientId(const LocationAPI* client);
+    void record(GnssTraceRecordType type, const void* data, size_t length,
+                const void* data2 = nullptr, size_t length2 = 0);
+public:
+    // returns NULL unless GNSS_TRACE_FILE is set in gps.conf;
+    // tracing is never enabled on user builds
+    static GnssTraceRecorder* createFromConfig();
+    ~GnssTraceRecorder();
+
+    void recordPosition(const UlpLocation& ulpLocation,
+                        const GpsLocationExtended& locationExtended,
+                        enum loc_sess_status status, LocPosTechMask techMask);
+    void recordSv(const GnssSvNotification& svNotify);
+    void recordNmea(const char* nmea, size_t length);
+    void recordMeasurements(const GnssMeasurementsNotification& measurements,
+                            int msInWeek);
+    void recordAddClient(const LocationAPI* client, const LocationCallbacks& callbacks);
+    void recordRemoveClient(const LocationAPI* client);
+    void recordTracking(GnssTraceRecordType type, const LocationAPI* client,
+                        uint32_t sessionId, const LocationOptions* options);
+    void recordUpdateConfig(const GnssConfig& config);
+    void recordDeleteAidingData(const GnssAidingData& data);
+};
+
+// Reads back a trace written by GnssTraceRecorder.
+class GnssTraceReader {
+    FILE* mFile;
+public:
+    inline GnssTraceReader() : mFile(NULL) {}
+    inline ~GnssTraceReader() { close(); }
+    bool open(const char* path);
+    void close();
+    // false at the end of the trace or on a truncated record
+    bool next(GnssTraceRecordHeader& header, std::vector<uint8_t>& payload);
+};
+
+#endif //GNSS_TRACE_H
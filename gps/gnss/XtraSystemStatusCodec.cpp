@@ -0,0 +1,627 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <XtraSystemStatusCodec.h>
+
+/* the text form of each type, by XtraStatusMsgType */
+static const char* const sTextTypes[XTRA_STATUS_TYPE_MAX] = {
+    "",
+    "halinit",
+    "gpslock",
+    "connection",
+    "tac",
+    "mncmcc",
+    "xtrathrottle",
+    "respondStatus",
+    "ping",
+    "requestStatus",
+    "connectBackhaul",
+    "disconnectBackhaul"
+};
+
+static inline void putLE(uint8_t* p, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t getLE(const uint8_t* p, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = size; i-- > 0; ) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+// lays out the fields of a binary message, one after the other, after its header
+class XtraStatusWriter {
+    uint8_t* mBuf;
+    size_t mLen;
+    size_t mPos;
+    uint8_t mCount;
+    bool mFits;
+
+    // room for the next field of size bytes, or nullptr
+    uint8_t* reserve(size_t size) {
+        if (!mFits || size > UINT16_MAX || mLen - mPos < 2 + size || UINT8_MAX == mCount) {
+            mFits = false;
+            return nullptr;
+        }
+        putLE(mBuf + mPos, size, 2);
+        uint8_t* field = mBuf + mPos + 2;
+        mPos += 2 + size;
+        mCount++;
+        return field;
+    }
+public:
+    inline XtraStatusWriter(uint8_t buf[], size_t len) :
+            mBuf(buf), mLen(len), mPos(XTRA_STATUS_HEADER_LEN), mCount(0),
+            mFits(len >= XTRA_STATUS_HEADER_LEN) {}
+    inline void putInt(uint64_t value, size_t size) {
+        uint8_t* field = reserve(size);
+        if (nullptr != field) {
+            putLE(field, value, size);
+        }
+    }
+    inline void putBytes(const char* data, size_t size) {
+        uint8_t* field = reserve(size);
+        if (nullptr != field) {
+            memcpy(field, data, size);
+        }
+    }
+    // the header, once all the fields are in; returns the length, or 0
+    size_t finish(XtraStatusMsgType type) {
+        if (!mFits) {
+            return 0;
+        }
+        mBuf[0] = XTRA_STATUS_MARKER;
+        mBuf[1] = XTRA_STATUS_VERSION;
+        mBuf[2] = (uint8_t)type;
+        mBuf[3] = mCount;
+        return mPos;
+    }
+};
+
+// takes the fields of a binary message in turn; those not there leave the
+// values as they are, those of the wrong size make the message invalid
+class XtraStatusReader {
+    const uint8_t* mData;
+    size_t mLength;
+    size_t mPos;
+    uint8_t mLeft;
+    bool mValid;
+
+    bool next(const uint8_t*& field, size_t& size) {
+        if (!mValid || 0 == mLeft) {
+            return false;
+        }
+        if (mLength - mPos < 2 || mLength - mPos - 2 < getLE(mData + mPos, 2)) {
+            mValid = false;
+            return false;
+        }
+        size = getLE(mData + mPos, 2);
+        field = mData + mPos + 2;
+        mPos += 2 + size;
+        mLeft--;
+        return true;
+    }
+public:
+    inline XtraStatusReader(const uint8_t data[], size_t length) :
+            mData(data), mLength(length), mPos(XTRA_STATUS_HEADER_LEN),
+            mLeft(data[3]), mValid(true) {}
+    inline bool isValid() const { return mValid; }
+    template <typename T>
+    void getInt(T& value) {
+        const uint8_t* field;
+        size_t size;
+        if (next(field, size)) {
+            if (sizeof(T) == size) {
+                value = (T)getLE(field, size);
+            } else {
+                mValid = false;
+            }
+        }
+    }
+    void getBool(bool& value) {
+        uint8_t byte = value;
+        getInt(byte);
+        value = (0 != byte);
+    }
+    void getBytes(const char*& data, uint16_t& size) {
+        const uint8_t* field;
+        size_t fieldSize;
+        if (next(field, fieldSize)) {
+            data = (const char*)field;
+            size = fieldSize;
+        }
+    }
+};
+
+static size_t encodeBinary(const XtraStatusMsg& msg, uint8_t buf[], size_t len) {
+    XtraStatusWriter writer(buf, len);
+    switch (msg.type) {
+    case XTRA_STATUS_GPS_LOCK:
+        writer.putInt((uint32_t)msg.gpsLock, sizeof(uint32_t));
+        break;
+    case XTRA_STATUS_CONNECTION:
+        writer.putInt(msg.connections, sizeof(uint64_t));
+        break;
+    case XTRA_STATUS_TAC:
+        writer.putBytes(msg.tac, msg.tacLen);
+        break;
+    case XTRA_STATUS_MCCMNC:
+        writer.putBytes(msg.mccmnc, msg.mccmncLen);
+        break;
+    case XTRA_STATUS_XTRA_THROTTLE:
+        writer.putInt(msg.enabled, 1);
+        break;
+    case XTRA_STATUS_RESPOND_STATUS:
+        writer.putInt((uint32_t)msg.gpsLock, sizeof(uint32_t));
+        writer.putInt(msg.connections, sizeof(uint64_t));
+        writer.putBytes(msg.tac, msg.tacLen);
+        writer.putBytes(msg.mccmnc, msg.mccmncLen);
+        writer.putInt(msg.connectivityStatusKnown, 1);
+        break;
+    case XTRA_STATUS_REQUEST_STATUS:
+        writer.putInt((uint32_t)msg.xtraStatusUpdated, sizeof(uint32_t));
+        break;
+    default:
+        break;
+    }
+    return writer.finish(msg.type);
+}
+
+static bool decodeBinary(const uint8_t data[], size_t length, XtraStatusMsg& msg) {
+    if (0 == data[1] || 0 == data[2] || data[2] >= XTRA_STATUS_TYPE_MAX) {
+        return false;
+    }
+    msg = XtraStatusMsg((XtraStatusMsgType)data[2]);
+    XtraStatusReader reader(data, length);
+    switch (msg.type) {
+    case XTRA_STATUS_GPS_LOCK:
+        reader.getInt(msg.gpsLock);
+        break;
+    case XTRA_STATUS_CONNECTION:
+        reader.getInt(msg.connections);
+        break;
+    case XTRA_STATUS_TAC:
+        reader.getBytes(msg.tac, msg.tacLen);
+        break;
+    case XTRA_STATUS_MCCMNC:
+        reader.getBytes(msg.mccmnc, msg.mccmncLen);
+        break;
+    case XTRA_STATUS_XTRA_THROTTLE:
+        reader.getBool(msg.enabled);
+        break;
+    case XTRA_STATUS_RESPOND_STATUS:
+        reader.getInt(msg.gpsLock);
+        reader.getInt(msg.connections);
+        reader.getBytes(msg.tac, msg.tacLen);
+        reader.getBytes(msg.mccmnc, msg.mccmncLen);
+        reader.getBool(msg.connectivityStatusKnown);
+        break;
+    case XTRA_STATUS_REQUEST_STATUS:
+        reader.getInt(msg.xtraStatusUpdated);
+        break;
+    default:
+        break;
+    }
+    return reader.isValid();
+}
+
+// appends to buf what snprintf() would, keeping count of the length in pos,
+// which goes past len if it does not fit
+#define XTRA_STATUS_PRINT(buf, len, pos, ...) \
+    (pos) += snprintf((char*)(buf) + (((pos) < (len)) ? (pos) : 0), \
+                      ((pos) < (len)) ? (len) - (pos) : 0, __VA_ARGS__)
+
+static size_t encodeText(const XtraStatusMsg& msg, uint8_t buf[], size_t len) {
+    size_t pos = 0;
+    XTRA_STATUS_PRINT(buf, len, pos, "%s", sTextTypes[msg.type]);
+    switch (msg.type) {
+    case XTRA_STATUS_GPS_LOCK:
+        XTRA_STATUS_PRINT(buf, len, pos, " %u", (uint32_t)msg.gpsLock);
+        break;
+    case XTRA_STATUS_CONNECTION:
+        XTRA_STATUS_PRINT(buf, len, pos, " %" PRIu64, msg.connections);
+        break;
+    case XTRA_STATUS_TAC:
+        XTRA_STATUS_PRINT(buf, len, pos, " %.*s", (int)msg.tacLen, msg.tac);
+        break;
+    case XTRA_STATUS_MCCMNC:
+        XTRA_STATUS_PRINT(buf, len, pos, " %.*s", (int)msg.mccmncLen, msg.mccmnc);
+        break;
+    case XTRA_STATUS_XTRA_THROTTLE:
+        XTRA_STATUS_PRINT(buf, len, pos, " %d", msg.enabled ? 1 : 0);
+        break;
+    case XTRA_STATUS_RESPOND_STATUS:
+        // a line each, the lock left empty if not known
+        XTRA_STATUS_PRINT(buf, len, pos, "\n");
+        if (-1 != msg.gpsLock) {
+            XTRA_STATUS_PRINT(buf, len, pos, "%d", msg.gpsLock);
+        }
+        XTRA_STATUS_PRINT(buf, len, pos, "\n%" PRIu64 "\n%.*s\n%.*s\n%d", msg.connections,
+                          (int)msg.tacLen, msg.tac, (int)msg.mccmncLen, msg.mccmnc,
+                          msg.connectivityStatusKnown ? 1 : 0);
+        break;
+    case XTRA_STATUS_REQUEST_STATUS:
+        XTRA_STATUS_PRINT(buf, len, pos, " %d", msg.xtraStatusUpdated);
+        break;
+    default:
+        break;
+    }
+    // snprintf() wants room for a NUL, which is not sent
+    return (pos < len) ? pos : 0;
+}
+
+// takes a decimal number, with a '-' before it if signed, off the front of
+// [p, end); returns false if there is none
+template <typename T>
+static bool parseNumber(const char*& p, const char* end, T& value) {
+    bool negative = (p < end && '-' == *p && (T)-1 < 0);
+    const char* digits = negative ? p + 1 : p;
+    uint64_t number = 0;
+    const char* q = digits;
+    for (; q < end && *q >= '0' && *q <= '9'; q++) {
+        number = number * 10 + (*q - '0');
+    }
+    if (q == digits) {
+        return false;
+    }
+    value = negative ? (T)(0 - number) : (T)number;
+    p = q;
+    return true;
+}
+
+// takes the '\n' off the front of [p, end); returns false if there is none
+static inline bool skipNewline(const char*& p, const char* end) {
+    return p < end && '\n' == *p++;
+}
+
+// takes a line off the front of [p, end)
+static void parseLine(const char*& p, const char* end, const char*& line, uint16_t& lineLen) {
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    if (nullptr == eol) {
+        eol = end;
+    }
+    line = p;
+    lineLen = (eol - p > UINT16_MAX) ? UINT16_MAX : eol - p;
+    p = (eol < end) ? eol + 1 : end;
+}
+
+// As XtraSystemStatusObserver matched the text before there was a codec:
+// up to the first NUL, by the prefix of its first word, with anything else
+// up to the next white space ignored, as sscanf("%*s") would, so that, e.g.,
+// "requestStatus\r\n" and "ping\0" still do.
+static bool decodeText(const uint8_t data[], size_t length, XtraStatusMsg& msg) {
+    const char* p = (const char*)data;
+    const char* end = (const char*)memchr(p, '\0', length);
+    if (nullptr == end) {
+        end = p + length;
+    }
+    int type = XTRA_STATUS_TYPE_MAX;
+    size_t wordLen = 0;
+    while (--type > XTRA_STATUS_UNKNOWN && !((wordLen = strlen(sTextTypes[type])) <=
+            (size_t)(end - p) && 0 == memcmp(sTextTypes[type], p, wordLen))) {}
+    if (XTRA_STATUS_UNKNOWN == type) {
+        return false;
+    }
+    msg = XtraStatusMsg((XtraStatusMsgType)type);
+    p += wordLen;
+    while (p < end && !isspace((unsigned char)*p)) {
+        p++;
+    }
+    if (XTRA_STATUS_RESPOND_STATUS == msg.type) {
+        // its lines start right after the word, the first one may be empty
+        if (p < end) {
+            p++;
+        }
+    } else {
+        while (p < end && isspace((unsigned char)*p)) {
+            p++;
+        }
+    }
+    uint32_t number = 0;
+    switch (msg.type) {
+    case XTRA_STATUS_GPS_LOCK:
+        if (!parseNumber(p, end, number)) {
+            return false;
+        }
+        msg.gpsLock = number;
+        break;
+    case XTRA_STATUS_CONNECTION:
+        return parseNumber(p, end, msg.connections);
+    case XTRA_STATUS_TAC:
+        msg.tac = p;
+        msg.tacLen = (end - p > UINT16_MAX) ? UINT16_MAX : end - p;
+        break;
+    case XTRA_STATUS_MCCMNC:
+        msg.mccmnc = p;
+        msg.mccmncLen = (end - p > UINT16_MAX) ? UINT16_MAX : end - p;
+        break;
+    case XTRA_STATUS_XTRA_THROTTLE:
+        if (!parseNumber(p, end, number)) {
+            return false;
+        }
+        msg.enabled = (0 != number);
+        break;
+    case XTRA_STATUS_RESPOND_STATUS:
+        if ((p < end && '\n' != *p && !parseNumber(p, end, msg.gpsLock)) ||
+                !skipNewline(p, end) || !parseNumber(p, end, msg.connections) ||
+                !skipNewline(p, end)) {
+            return false;
+        }
+        parseLine(p, end, msg.tac, msg.tacLen);
+        parseLine(p, end, msg.mccmnc, msg.mccmncLen);
+        if (!parseNumber(p, end, number)) {
+            return false;
+        }
+        msg.connectivityStatusKnown = (0 != number);
+        break;
+    case XTRA_STATUS_REQUEST_STATUS:
+        // with no number, as if 0
+        parseNumber(p, end, msg.xtraStatusUpdated);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+size_t XtraStatusCodec::encode(const XtraStatusMsg& msg, bool binary,
+                               uint8_t buf[], size_t len) {
+    if (msg.type <= XTRA_STATUS_UNKNOWN || msg.type >= XTRA_STATUS_TYPE_MAX) {
+        return 0;
+    }
+    return binary ? encodeBinary(msg, buf, len) : encodeText(msg, buf, len);
+}
+
+bool XtraStatusCodec::decode(const uint8_t data[], size_t length, XtraStatusMsg& msg) {
+    if (0 == length) {
+        return false;
+    }
+    return isBinary(data, length) ? decodeBinary(data, length, msg) :
+            decodeText(data, length, msg);
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+#include <time.h>
+#include <sstream>
+#include <string>
+
+static uint64_t getNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool sameMsg(const XtraStatusMsg& a, const XtraStatusMsg& b) {
+    return a.type == b.type && a.gpsLock == b.gpsLock && a.connections == b.connections &&
+            a.tacLen == b.tacLen && 0 == memcmp(a.tac, b.tac, a.tacLen) &&
+            a.mccmncLen == b.mccmncLen && 0 == memcmp(a.mccmnc, b.mccmnc, a.mccmncLen) &&
+            a.enabled == b.enabled && a.connectivityStatusKnown == b.connectivityStatusKnown &&
+            a.xtraStatusUpdated == b.xtraStatusUpdated;
+}
+
+// the text as XtraSystemStatusObserver built it before there was a codec
+static std::string encodeWithStream(const XtraStatusMsg& msg) {
+    std::stringstream ss;
+    std::string tac(msg.tac, msg.tacLen);
+    std::string mccmnc(msg.mccmnc, msg.mccmncLen);
+    switch (msg.type) {
+    case XTRA_STATUS_GPS_LOCK:
+        ss << "gpslock" << " " << (uint32_t)msg.gpsLock;
+        break;
+    case XTRA_STATUS_CONNECTION:
+        ss << "connection" << " " << msg.connections;
+        break;
+    case XTRA_STATUS_TAC:
+        ss << "tac" << " " << tac.c_str();
+        break;
+    case XTRA_STATUS_MCCMNC:
+        ss << "mncmcc" << " " << mccmnc.c_str();
+        break;
+    case XTRA_STATUS_XTRA_THROTTLE:
+        ss << "xtrathrottle" << " " << (msg.enabled ? 1 : 0);
+        break;
+    case XTRA_STATUS_RESPOND_STATUS:
+        ss << "respondStatus" << std::endl;
+        (msg.gpsLock == -1 ? ss : ss << msg.gpsLock) << std::endl << msg.connections
+                << std::endl << tac << std::endl << mccmnc << std::endl
+                << msg.connectivityStatusKnown;
+        break;
+    default:
+        break;
+    }
+    return ss.str();
+}
+
+// on linux command line:
+// build: make check, for xtra_status_codec_test; or, as the codec depends
+//        on nothing else, g++ -D__LOC_DEBUG__ -std=c++11 -O2 -I.
+//        -o xtra_status_codec_test XtraSystemStatusCodec.cpp
+// run: ./xtra_status_codec_test [number of rounds, 1000000 by default]
+int main(int argc, char** argv) {
+    uint32_t rounds = (argc > 1) ? atoi(argv[1]) : 1000000;
+    const char tac[] = "tac=4660";
+    const char mccmnc[] = "310260";
+    XtraStatusMsg msgs[8];
+    msgs[0].type = XTRA_STATUS_GPS_LOCK;
+    msgs[0].gpsLock = 3;
+    msgs[1].type = XTRA_STATUS_CONNECTION;
+    msgs[1].connections = 0x100000003ULL;
+    msgs[2].type = XTRA_STATUS_TAC;
+    msgs[2].tac = tac;
+    msgs[2].tacLen = sizeof(tac) - 1;
+    msgs[3].type = XTRA_STATUS_MCCMNC;
+    msgs[3].mccmnc = mccmnc;
+    msgs[3].mccmncLen = sizeof(mccmnc) - 1;
+    msgs[4].type = XTRA_STATUS_XTRA_THROTTLE;
+    msgs[4].enabled = true;
+    msgs[5] = msgs[2];
+    msgs[5].type = XTRA_STATUS_RESPOND_STATUS;
+    msgs[5].gpsLock = 1;
+    msgs[5].connections = 5;
+    msgs[5].mccmnc = mccmnc;
+    msgs[5].mccmncLen = sizeof(mccmnc) - 1;
+    msgs[5].connectivityStatusKnown = true;
+    msgs[6] = msgs[5];
+    msgs[6].gpsLock = -1;
+    msgs[7].type = XTRA_STATUS_REQUEST_STATUS;
+    msgs[7].xtraStatusUpdated = 1;
+    const size_t nMsgs = sizeof(msgs) / sizeof(msgs[0]);
+    // the first 7 are those that went as text before
+    const size_t nStreamed = 7;
+
+    uint8_t buf[XTRA_STATUS_MSG_MAX_LEN];
+    int failures = 0;
+    for (size_t i = 0; i < nMsgs; i++) {
+        for (int binary = 0; binary < 2; binary++) {
+            XtraStatusMsg decoded;
+            size_t len = XtraStatusCodec::encode(msgs[i], binary, buf, sizeof(buf));
+            if (0 == len || !XtraStatusCodec::decode(buf, len, decoded) ||
+                    !sameMsg(msgs[i], decoded)) {
+                printf("round trip of type %d %s FAILED\n", msgs[i].type,
+                       binary ? "binary" : "text");
+                failures++;
+            } else if (binary && XtraStatusCodec::decode(buf, len - 1, decoded) &&
+                       len > XTRA_STATUS_HEADER_LEN) {
+                printf("type %d binary cut short decoded FAILED\n", msgs[i].type);
+                failures++;
+            }
+            if (!binary && i < nStreamed &&
+                    encodeWithStream(msgs[i]) != std::string((char*)buf, len)) {
+                printf("type %d text differs from before: %.*s FAILED\n",
+                       msgs[i].type, (int)len, buf);
+                failures++;
+            }
+        }
+    }
+    // a later version, with a field appended, and an earlier one, without
+    // the last field
+    XtraStatusMsg decoded;
+    size_t len = XtraStatusCodec::encode(msgs[5], true, buf, sizeof(buf));
+    buf[1] = XTRA_STATUS_VERSION + 1;
+    buf[3]++;
+    memcpy(buf + len, "\x02\x00zz", 4);
+    if (!XtraStatusCodec::decode(buf, len + 4, decoded) || !sameMsg(msgs[5], decoded)) {
+        printf("later version FAILED\n");
+        failures++;
+    }
+    buf[3] -= 2;
+    if (!XtraStatusCodec::decode(buf, len - 3, decoded) || decoded.connectivityStatusKnown) {
+        printf("earlier version FAILED\n");
+        failures++;
+    }
+    // as the daemon may send them, with the type and xtraStatusUpdated
+    // they decode to; sizeof() keeps the NUL at the end of each
+    const struct {
+        const char text[24];
+        XtraStatusMsgType type;
+        int32_t xtraStatusUpdated;
+    } texts[] = {
+        { "ping", XTRA_STATUS_PING, 0 },
+        { "pingpong", XTRA_STATUS_PING, 0 },
+        { "requestStatus", XTRA_STATUS_REQUEST_STATUS, 0 },
+        { "requestStatus 1", XTRA_STATUS_REQUEST_STATUS, 1 },
+        { "requestStatus\r\n", XTRA_STATUS_REQUEST_STATUS, 0 },
+        { "requestStatus 1\r\n", XTRA_STATUS_REQUEST_STATUS, 1 },
+        { "requestStatus\t-1", XTRA_STATUS_REQUEST_STATUS, -1 },
+        { "connectBackhaul\n", XTRA_STATUS_CONNECT_BACKHAUL, 0 },
+        { "disconnectBackhaul", XTRA_STATUS_DISCONNECT_BACKHAUL, 0 }
+    };
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        size_t lens[] = { strlen(texts[i].text), strlen(texts[i].text) + 1 };
+        for (size_t l = 0; l < 2; l++) {
+            if (!XtraStatusCodec::decode((const uint8_t*)texts[i].text, lens[l], decoded) ||
+                    texts[i].type != decoded.type ||
+                    texts[i].xtraStatusUpdated != decoded.xtraStatusUpdated) {
+                printf("\"%s\" of %zu bytes FAILED\n", texts[i].text, lens[l]);
+                failures++;
+            }
+        }
+    }
+    if (XtraStatusCodec::decode((const uint8_t*)"pin", 3, decoded) ||
+            XtraStatusCodec::decode((const uint8_t*)"\0ping", 5, decoded) ||
+            XtraStatusCodec::decode((const uint8_t*)"gpslock x", 9, decoded)) {
+        printf("bad text decoded FAILED\n");
+        failures++;
+    }
+    printf("%s\n", failures ? "self test FAILED" : "self test passed");
+
+    // the updates XtraSystemStatusObserver sends, and a status response
+    uint64_t sum = 0;
+    uint64_t startNs = getNowNs();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < nStreamed; i++) {
+            sum += encodeWithStream(msgs[i]).length();
+        }
+    }
+    uint64_t streamNs = getNowNs() - startNs;
+    uint64_t encodeNs[2];
+    uint64_t decodeNs[2];
+    size_t bytes[2] = { 0, 0 };
+    for (int binary = 0; binary < 2; binary++) {
+        startNs = getNowNs();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < nStreamed; i++) {
+                sum += XtraStatusCodec::encode(msgs[i], binary, buf, sizeof(buf));
+            }
+        }
+        encodeNs[binary] = getNowNs() - startNs;
+        uint8_t encoded[nStreamed][XTRA_STATUS_MSG_MAX_LEN];
+        size_t lens[nStreamed];
+        for (size_t i = 0; i < nStreamed; i++) {
+            lens[i] = XtraStatusCodec::encode(msgs[i], binary, encoded[i], sizeof(encoded[i]));
+            bytes[binary] += lens[i];
+        }
+        startNs = getNowNs();
+        for (uint32_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < nStreamed; i++) {
+                sum += XtraStatusCodec::decode(encoded[i], lens[i], decoded);
+                sum += decoded.connections;
+            }
+        }
+        decodeNs[binary] = getNowNs() - startNs;
+    }
+    double n = (double)rounds * nStreamed;
+    printf("%u rounds of %zu msgs, ns/msg: stringstream encode %.1f; "
+           "text encode %.1f decode %.1f, %zu bytes; binary encode %.1f decode %.1f, "
+           "%zu bytes (%" PRIu64 ")\n", rounds, nStreamed, streamNs / n,
+           encodeNs[0] / n, decodeNs[0] / n, bytes[0], encodeNs[1] / n, decodeNs[1] / n,
+           bytes[1], sum % 10);
+    return failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef XTRA_SYSTEM_STATUS_CODEC_H
+#define XTRA_SYSTEM_STATUS_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The messages between XtraSystemStatusObserver and the xtra daemon, in either
+   of two forms. The text form is the original one, e.g. "gpslock 1", which
+   a daemon, or a person debugging with a socket tool, may keep using. The
+   binary form is a 4 byte header, XTRA_STATUS_MARKER, version, type and field
+   count, followed by the fields of the type in the order listed below, each of
+   them a 16 bit length and that many bytes. Integers are fixed size and little
+   endian, strings have no NUL. A text message never starts with the marker.
+   Later versions only ever append fields to a type, so a decoder reads the
+   fields it knows of, leaves those missing at their defaults, and skips the
+   rest. */
+#define XTRA_STATUS_MARKER      0x00
+#define XTRA_STATUS_VERSION     1
+#define XTRA_STATUS_HEADER_LEN  4
+/* long enough for any message of ours with its strings of up to
+   XTRA_STATUS_STRING_MAX_LEN bytes each */
+#define XTRA_STATUS_STRING_MAX_LEN 128
+#define XTRA_STATUS_MSG_MAX_LEN    512
+
+typedef enum {
+    XTRA_STATUS_UNKNOWN = 0,
+    /* from the HAL */
+    XTRA_STATUS_HAL_INIT,            /* none */
+    XTRA_STATUS_GPS_LOCK,            /* gpsLock, 4 bytes */
+    XTRA_STATUS_CONNECTION,          /* connections, 8 bytes */
+    XTRA_STATUS_TAC,                 /* tac */
+    XTRA_STATUS_MCCMNC,              /* mccmnc */
+    XTRA_STATUS_XTRA_THROTTLE,       /* enabled, 1 byte */
+    XTRA_STATUS_RESPOND_STATUS,      /* gpsLock, connections, tac, mccmnc,
+                                        connectivityStatusKnown */
+    /* from the daemon */
+    XTRA_STATUS_PING,                /* none */
+    XTRA_STATUS_REQUEST_STATUS,      /* xtraStatusUpdated, 4 bytes */
+    XTRA_STATUS_CONNECT_BACKHAUL,    /* none */
+    XTRA_STATUS_DISCONNECT_BACKHAUL, /* none */
+    XTRA_STATUS_TYPE_MAX
+} XtraStatusMsgType;
+
+/* A message decoded, or to be encoded. Only the fields of its type count;
+   strings point into the buffer decoded, or to the caller's data. */
+struct XtraStatusMsg {
+    XtraStatusMsgType type;
+    /* -1 if not known */
+    int32_t gpsLock;
+    uint64_t connections;
+    const char* tac;
+    uint16_t tacLen;
+    const char* mccmnc;
+    uint16_t mccmncLen;
+    bool enabled;
+    bool connectivityStatusKnown;
+    int32_t xtraStatusUpdated;
+
+    inline XtraStatusMsg(XtraStatusMsgType msgType = XTRA_STATUS_UNKNOWN) :
+            type(msgType), gpsLock(-1), connections(0), tac(""), tacLen(0),
+            mccmnc(""), mccmncLen(0), enabled(false),
+            connectivityStatusKnown(false), xtraStatusUpdated(0) {}
+};
+
+class XtraStatusCodec {
+public:
+    /* Encodes msg into buf of len bytes, in the binary form or else the text
+       one, and returns the length of the message; or 0 if it does not fit. */
+    static size_t encode(const XtraStatusMsg& msg, bool binary, uint8_t buf[], size_t len);
+
+    /* Decodes a message of either form, of length bytes, into msg; returns
+       false if it is none we know of. */
+    static bool decode(const uint8_t data[], size_t length, XtraStatusMsg& msg);
+
+    static inline bool isBinary(const uint8_t data[], size_t length) {
+        return length >= XTRA_STATUS_HEADER_LEN && XTRA_STATUS_MARKER == data[0];
+    }
+};
+
+#endif /* XTRA_SYSTEM_STATUS_CODEC_H */
@@ -42,8 +42,8 @@
 #include <loc_nmea.h>
 #include <SystemStatus.h>
 #include <vector>
-#include <sstream>
 #include <XtraSystemStatusObserver.h>
+#include <XtraSystemStatusCodec.h>
 #include <LocAdapterBase.h>
 #include <DataItemId.h>
 #include <DataItemsFactoryProxy.h>
@@ -63,10 +63,9 @@ bool XtraSystemStatusObserver::updateLockStatus(uint32_t lock) {
         return true;
     }
 
-    stringstream ss;
-    ss <<  "gpslock";
-    ss << " " << lock;
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+    XtraStatusMsg msg(XTRA_STATUS_GPS_LOCK);
+    msg.gpsLock = lock;
+    return sendStatus(msg);
 }
 
 bool XtraSystemStatusObserver::updateConnections(uint64_t allConnections) {
@@ -77,10 +76,9 @@ bool XtraSystemStatusObserver::updateConnections(uint64_t allConnections) {
         return true;
     }
 
-    stringstream ss;
-    ss <<  "connection";
-    ss << " " << mConnections;
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+    XtraStatusMsg msg(XTRA_STATUS_CONNECTION);
+    msg.connections = mConnections;
+    return sendStatus(msg);
 }
 
 bool XtraSystemStatusObserver::updateTac(const string& tac) {
@@ -90,10 +88,10 @@ bool XtraSystemStatusObserver::updateTac(const string& tac) {
         return true;
     }
 
-    stringstream ss;
-    ss <<  "tac";
-    ss << " " << tac.c_str();
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+    XtraStatusMsg msg(XTRA_STATUS_TAC);
+    msg.tac = tac.c_str();
+    msg.tacLen = strnlen(msg.tac, XTRA_STATUS_STRING_MAX_LEN);
+    return sendStatus(msg);
 }
 
 bool XtraSystemStatusObserver::updateMccMnc(const string& mccmnc) {
@@ -103,10 +101,10 @@ bool XtraSystemStatusObserver::updateMccMnc(const string& mccmnc) {
         return true;
     }
 
-    stringstream ss;
-    ss <<  "mncmcc";
-    ss << " " << mccmnc.c_str();
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+    XtraStatusMsg msg(XTRA_STATUS_MCCMNC);
+    msg.mccmnc = mccmnc.c_str();
+    msg.mccmncLen = strnlen(msg.mccmnc, XTRA_STATUS_STRING_MAX_LEN);
+    return sendStatus(msg);
 }
 
 bool XtraSystemStatusObserver::updateXtraThrottle(const bool enabled) {
@@ -116,56 +114,93 @@ bool XtraSystemStatusObserver::updateXtraThrottle(const bool enabled) {
         return true;
     }
 
-    stringstream ss;
-    ss <<  "xtrathrottle";
-    ss << " " << (enabled ? 1 : 0);
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+    XtraStatusMsg msg(XTRA_STATUS_XTRA_THROTTLE);
+    msg.enabled = enabled;
+    return sendStatus(msg);
 }
 
-inline bool XtraSystemStatusObserver::onStatusRequested(int32_t xtraStatusUpdated) {
+inline bool XtraSystemStatusObserver::onStatusRequested(int32_t xtraStatusUpdated,
+                                                        bool binary) {
     mReqStatusReceived = true;
+    // answer, and update, the daemon in the form it asks in
+    mBinary = binary;
 
     if (xtraStatusUpdated) {
         return true;
     }
 
-    stringstream ss;
-
-    ss << "respondStatus" << endl;
-    (mGpsLock == -1 ? ss : ss << mGpsLock) << endl << mConnections << endl
-            << mTac << endl << mMccmnc << endl << mIsConnectivityStatusKnown;
+    XtraStatusMsg msg(XTRA_STATUS_RESPOND_STATUS);
+    msg.gpsLock = mGpsLock;
+    msg.connections = mConnections;
+    msg.tac = mTac.c_str();
+    msg.tacLen = strnlen(msg.tac, XTRA_STATUS_STRING_MAX_LEN);
+    msg.mccmnc = mMccmnc.c_str();
+    msg.mccmncLen = strnlen(msg.mccmnc, XTRA_STATUS_STRING_MAX_LEN);
+    msg.connectivityStatusKnown = mIsConnectivityStatusKnown;
+
+    uint8_t buf[XTRA_STATUS_MSG_MAX_LEN];
+    size_t length = XtraStatusCodec::encode(msg, mBinary, buf, sizeof(buf));
+    return (0 != length && mXtraSender.send(buf, length));
+}
 
-    return ( send(LOC_IPC_XTRA, ss.str()) );
+// sends status to the xtra daemon
+bool XtraSystemStatusObserver::sendStatus(const XtraStatusMsg& msg) {
+    uint8_t buf[XTRA_STATUS_MSG_MAX_LEN];
+    size_t length = XtraStatusCodec::encode(msg, mBinary, buf, sizeof(buf));
+    if (0 == length) {
+        LOC_LOGe("cannot encode status of type %d", msg.type);
+        return false;
+    }
+    return mXtraSender.send(buf, length);
 }
 
-void XtraSystemStatusObserver::onReceive(const std::string& data) {
-    if (!strncmp(data.c_str(), "ping", sizeof("ping") - 1)) {
+void XtraSystemStatusObserver::onReceiveData(const char data[], uint32_t length) {
+    XtraStatusMsg msg;
+    if (!XtraStatusCodec::decode((const uint8_t*)data, length, msg)) {
+        msg.type = XTRA_STATUS_UNKNOWN;
+    }
+    bool binary = XtraStatusCodec::isBinary((const uint8_t*)data, length);
+
+    switch (msg.type) {
+    case XTRA_STATUS_PING:
         LOC_LOGd("ping received");
+        break;
 
 #ifdef USE_GLIB
-    } else if (!strncmp(data.c_str(), "connectBackhaul", sizeof("connectBackhaul") - 1)) {
+    case XTRA_STATUS_CONNECT_BACKHAUL:
         mSystemStatusObsrvr->connectBackhaul();
+        break;
 
-    } else if (!strncmp(data.c_str(), "disconnectBackhaul", sizeof("disconnectBackhaul") - 1)) {
+    case XTRA_STATUS_DISCONNECT_BACKHAUL:
         mSystemStatusObsrvr->disconnectBackhaul();
+        break;
 #endif
 
-    } else if (!strncmp(data.c_str(), "requestStatus", sizeof("requestStatus") - 1)) {
-        int32_t xtraStatusUpdated = 0;
-        sscanf(data.c_str(), "%*s %d", &xtraStatusUpdated);
-
+    case XTRA_STATUS_REQUEST_STATUS:
+    {
         struct HandleStatusRequestMsg : public LocMsg {
             XtraSystemStatusObserver& mXSSO;
             int32_t mXtraStatusUpdated;
+            bool mBinary;
             inline HandleStatusRequestMsg(XtraSystemStatusObserver& xsso,
-                    int32_t xtraStatusUpdated) :
-                    mXSSO(xsso), mXtraStatusUpdated(xtraStatusUpdated) {}
-            inline void proc() const override { mXSSO.onStatusRequested(mXtraStatusUpdated); }
+                    int32_t xtraStatusUpdated, bool binary) :
+                    mXSSO(xsso), mXtraStatusUpdated(xtraStatusUpdated), mBinary(binary) {}
+            inline void proc() const override {
+                mXSSO.onStatusRequested(mXtraStatusUpdated, mBinary);
+            }
         };
-        mMsgTask->sendMsg(new (nothrow) HandleStatusRequestMsg(*this, xtraStatusUpdated));
+        mMsgTask->sendMsg(new (nothrow) HandleStatusRequestMsg(*this, msg.xtraStatusUpdated,
+                                                               binary));
+    }
+    break;
 
-    } else {
-        LOC_LOGw("unknown event: %s", data.c_str());
+    default:
+        if (binary) {
+            LOC_LOGw("unknown event of %u bytes, type %u", length, (uint8_t)data[2]);
+        } else {
+            LOC_LOGw("unknown event: %.*s", (int)length, data);
+        }
+        break;
     }
 }
 
@@ -39,6 +39,10 @@ using loc_core::IOsObserver;
 using loc_core::IDataItemObserver;
 using loc_core::IDataItemCore;
 using loc_util::LocIpc;
+using loc_util::LocIpcSender;
+using loc_util::LocIpcReactor;
+
+struct XtraStatusMsg;
 
 class XtraSystemStatusObserver : public IDataItemObserver, public LocIpc{
 public :
@@ -46,9 +50,10 @@ public :
     inline XtraSystemStatusObserver(IOsObserver* sysStatObs, const MsgTask* msgTask):
             mSystemStatusObsrvr(sysStatObs), mMsgTask(msgTask),
             mGpsLock(-1), mConnections(0), mXtraThrottle(true), mReqStatusReceived(false),
-            mDelayLocTimer(*this), mIsConnectivityStatusKnown (false) {
+            mDelayLocTimer(*this), mIsConnectivityStatusKnown (false),
+            mXtraSender(LOC_IPC_XTRA), mBinary(false) {
         subscribe(true);
-        startListeningNonBlocking(LOC_IPC_HAL);
+        startListeningNonBlocking(LOC_IPC_HAL, LocIpcReactor::getInstance());
         mDelayLocTimer.start(100 /*.1 sec*/,  false);
     }
     inline virtual ~XtraSystemStatusObserver() {
@@ -69,7 +74,7 @@ public :
     void subscribe(bool yes);
 
 protected:
-    void onReceive(const std::string& data) override;
+    void onReceiveData(const char data[], uint32_t length) override;
 
 private:
     IOsObserver*    mSystemStatusObsrvr;
@@ -81,17 +86,22 @@ private:
     bool mXtraThrottle;
     bool mReqStatusReceived;
     bool mIsConnectivityStatusKnown;
+    // connected once, for all the updates to the xtra daemon
+    LocIpcSender mXtraSender;
+    // binary messages to the daemon rather than text, once it asks in binary
+    bool mBinary;
 
     class DelayLocTimer : public LocTimer {
         XtraSystemStatusObserver& mXSSO;
     public:
         DelayLocTimer(XtraSystemStatusObserver& xsso) : mXSSO(xsso) {}
         void timeOutCallback() override {
-            mXSSO.send(LOC_IPC_XTRA, "halinit");
+            mXSSO.mXtraSender.send("halinit");
         }
     } mDelayLocTimer;
 
-    bool onStatusRequested(int32_t xtraStatusUpdated);
+    bool onStatusRequested(int32_t xtraStatusUpdated, bool binary);
+    bool sendStatus(const XtraStatusMsg& msg);
 };
 
 #endif
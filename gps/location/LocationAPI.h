@@ -647,11 +647,46 @@ typedef struct {
     float                               serverPredictionAgeSeconds;
 } GnssDebugSatelliteInfo;
 
+typedef struct {
+    size_t size;                        // set to sizeof
+    uint32_t                            depth;      // msgs waiting now
+    uint32_t                            maxDepth;   // most msgs seen waiting
+    uint64_t                            total;      // msgs sent so far
+    uint64_t                            dropped;    // dropped for newer ones
+    uint64_t                            rejected;   // rejected for lack of room
+    uint64_t                            blocked;    // sends that waited for room
+} GnssDebugMsgLane;
+
+typedef struct {
+    size_t size;                        // set to sizeof
+    char                                name[32];
+    uint32_t                            count;
+    // upper bounds, in us, of the percentiles of the queue wait and the
+    // processing time of the msgs of the type
+    uint32_t                            waitP50Us;
+    uint32_t                            waitP99Us;
+    uint32_t                            waitMaxUs;
+    uint32_t                            procP50Us;
+    uint32_t                            procP99Us;
+    uint32_t                            procMaxUs;
+} GnssDebugMsgType;
+
+// the msg queue of the GNSS adapter
+typedef struct {
+    size_t size;                        // set to sizeof
+    uint64_t                            poolHits;   // msgs allocated from the pool
+    uint64_t                            poolMisses; // msgs allocated from the heap
+    GnssDebugMsgLane                    mControlLane;
+    GnssDebugMsgLane                    mTelemetryLane;
+    std::vector<GnssDebugMsgType>       mMsgTypes;
+} GnssDebugMsgTask;
+
 typedef struct {
     size_t size;                        // set to sizeof
     GnssDebugLocation                   mLocation;
     GnssDebugTime                       mTime;
     std::vector<GnssDebugSatelliteInfo> mSatelliteInfo;
+    GnssDebugMsgTask                    mMsgTask;
 } GnssDebugReport;
 
 /* Provides the capabilities of the system
@@ -23,6 +23,7 @@ LOCAL_SRC_FILES += \
     LocHeap.cpp \
     LocTimer.cpp \
     LocThread.cpp \
+    LocExecutor.cpp \
     MsgTask.cpp \
     loc_misc_utils.cpp \
     loc_nmea.cpp \
@@ -0,0 +1,210 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_TAG "LocSvc_Executor"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <deque>
+#include <LocExecutor.h>
+#include <log_util.h>
+#include <loc_pla.h>
+
+struct LocExecutorQueue {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    std::deque<LocRunnable*> mRunnables;
+    // the worker of this queue waits on mCond
+    bool mSleeping;
+};
+
+class LocExecutorWorker : public LocRunnable {
+    LocExecutor* mExecutor;
+    uint32_t mIndex;
+public:
+    inline LocExecutorWorker(LocExecutor* executor, uint32_t index) :
+        mExecutor(executor), mIndex(index) {}
+    virtual bool run();
+    // make sure we do not run in background scheduling group, same as
+    // MsgTask threads
+    inline virtual void prerun() { set_sched_policy(gettid(), SP_FOREGROUND); }
+};
+
+bool LocExecutorWorker::run() {
+    LocRunnable* runnable = mExecutor->take(mIndex);
+    if (runnable->run()) {
+        // to the back of our own queue, so that a busy runnable takes turns
+        // with everything else queued here
+        mExecutor->push(mIndex, runnable);
+    }
+    return true;
+}
+
+/***************************LocExecutor methods***************************/
+
+static pthread_mutex_t sExecutorMutex = PTHREAD_MUTEX_INITIALIZER;
+static LocExecutor* sExecutor = NULL;
+
+LocExecutor::LocExecutor(uint32_t count) :
+    mQueues(new LocExecutorQueue[count]), mCount(count), mNext(0), mIdle(0) {
+    for (uint32_t i = 0; i < mCount; i++) {
+        pthread_mutex_init(&mQueues[i].mMutex, NULL);
+        pthread_cond_init(&mQueues[i].mCond, NULL);
+        mQueues[i].mSleeping = false;
+    }
+}
+
+LocExecutor::~LocExecutor() {
+    for (uint32_t i = 0; i < mCount; i++) {
+        pthread_mutex_destroy(&mQueues[i].mMutex);
+        pthread_cond_destroy(&mQueues[i].mCond);
+    }
+    delete[] mQueues;
+}
+
+bool LocExecutor::start(uint32_t threads) {
+    pthread_mutex_lock(&sExecutorMutex);
+    if (NULL == sExecutor) {
+        if (0 == threads) {
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            threads = (cores > 0) ? (uint32_t)cores : 1;
+        }
+
+        LocExecutor* executor = new LocExecutor(threads);
+        uint32_t started = 0;
+        for (uint32_t i = 0; i < threads; i++) {
+            // thread names take up to 15 chars
+            char name[16];
+            snprintf(name, sizeof(name), "LocExec%u", i & 0xffff);
+            LocExecutorWorker* worker = new LocExecutorWorker(executor, i);
+            // the workers live as long as the process, hence detached
+            // and never stopped
+            LocThread* thread = new LocThread();
+            if (thread->start(name, worker, false)) {
+                started++;
+            } else {
+                delete worker;
+            }
+            // a detached thread keeps running after its LocThread is gone
+            delete thread;
+        }
+
+        if (started > 0) {
+            LOC_LOGD("%s: started %u of %u workers", __func__, started, threads);
+            __atomic_store_n(&sExecutor, executor, __ATOMIC_RELEASE);
+        } else {
+            LOC_LOGE("%s: failed to start any worker", __func__);
+            delete executor;
+        }
+    }
+    pthread_mutex_unlock(&sExecutorMutex);
+
+    return (NULL != sExecutor);
+}
+
+LocExecutor* LocExecutor::getInstance() {
+    return __atomic_load_n(&sExecutor, __ATOMIC_ACQUIRE);
+}
+
+void LocExecutor::schedule(LocRunnable* runnable) {
+    if (runnable) {
+        push(__atomic_fetch_add(&mNext, 1, __ATOMIC_RELAXED) % mCount, runnable);
+    }
+}
+
+void LocExecutor::push(uint32_t index, LocRunnable* runnable) {
+    LocExecutorQueue& queue = mQueues[index];
+    pthread_mutex_lock(&queue.mMutex);
+    queue.mRunnables.push_back(runnable);
+    bool sleeping = queue.mSleeping;
+    if (sleeping) {
+        pthread_cond_signal(&queue.mCond);
+    }
+    pthread_mutex_unlock(&queue.mMutex);
+
+    // the worker of the queue is busy; let an idle one steal the runnable
+    if (!sleeping && __atomic_load_n(&mIdle, __ATOMIC_ACQUIRE) > 0) {
+        wakeIdle(index);
+    }
+}
+
+void LocExecutor::wakeIdle(uint32_t index) {
+    for (uint32_t i = 1; i < mCount; i++) {
+        LocExecutorQueue& queue = mQueues[(index + i) % mCount];
+        pthread_mutex_lock(&queue.mMutex);
+        bool sleeping = queue.mSleeping;
+        if (sleeping) {
+            pthread_cond_signal(&queue.mCond);
+        }
+        pthread_mutex_unlock(&queue.mMutex);
+        if (sleeping) {
+            break;
+        }
+    }
+}
+
+// Takes from the front of our own queue, else steals from the back of
+// another worker's queue; sleeps when there is nothing to take. Work pushed
+// to a busy worker while we go to sleep may wait for that worker rather
+// than be stolen, but work pushed to our own queue always wakes us up, so
+// nothing is ever left behind.
+LocRunnable* LocExecutor::take(uint32_t index) {
+    for (;;) {
+        LocRunnable* runnable = NULL;
+        for (uint32_t i = 0; NULL == runnable && i < mCount; i++) {
+            LocExecutorQueue& queue = mQueues[(index + i) % mCount];
+            pthread_mutex_lock(&queue.mMutex);
+            if (!queue.mRunnables.empty()) {
+                if (0 == i) {
+                    runnable = queue.mRunnables.front();
+                    queue.mRunnables.pop_front();
+                } else {
+                    runnable = queue.mRunnables.back();
+                    queue.mRunnables.pop_back();
+                }
+            }
+            pthread_mutex_unlock(&queue.mMutex);
+        }
+        if (NULL != runnable) {
+            return runnable;
+        }
+
+        LocExecutorQueue& queue = mQueues[index];
+        pthread_mutex_lock(&queue.mMutex);
+        // woken up either for our own queue or to steal, so the scan above
+        // is redone either way
+        if (queue.mRunnables.empty()) {
+            queue.mSleeping = true;
+            __atomic_fetch_add(&mIdle, 1, __ATOMIC_ACQ_REL);
+            pthread_cond_wait(&queue.mCond, &queue.mMutex);
+            __atomic_fetch_sub(&mIdle, 1, __ATOMIC_ACQ_REL);
+            queue.mSleeping = false;
+        }
+        pthread_mutex_unlock(&queue.mMutex);
+    }
+}
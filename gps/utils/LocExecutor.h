@@ -0,0 +1,69 @@
+/* Copyright (c) 2018, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_EXECUTOR__
+#define __LOC_EXECUTOR__
+
+#include <stdint.h>
+#include <LocThread.h>
+
+// opaque classes to provide the worker queues and threads.
+struct LocExecutorQueue;
+class LocExecutorWorker;
+
+// A process wide pool of worker threads that runs LocRunnable objs which
+// do not block, e.g. the strands of the MsgTasks created to run on it. Each
+// worker has a queue, and a lock, of its own; a worker with an empty queue
+// steals from the others before it goes to sleep.
+class LocExecutor {
+    LocExecutorQueue* mQueues;
+    uint32_t mCount;
+    uint32_t mNext;
+    // number of workers asleep
+    uint32_t mIdle;
+    friend class LocExecutorWorker;
+    LocExecutor(uint32_t count);
+    ~LocExecutor();
+    void push(uint32_t index, LocRunnable* runnable);
+    void wakeIdle(uint32_t index);
+    LocRunnable* take(uint32_t index);
+public:
+    // Starts the executor with the given number of worker threads; 0 for
+    // one per online core. Returns true if the executor is running.
+    static bool start(uint32_t threads = 0);
+    // returns NULL until start() has succeeded
+    static LocExecutor* getInstance();
+    // Runs runnable->run() once on one of the workers. If run() returns
+    // true, runnable is scheduled again behind the work already queued on
+    // that worker; if false, the executor forgets about it. runnable must
+    // not be scheduled again while it is queued or running, and it is never
+    // deleted by the executor.
+    void schedule(LocRunnable* runnable);
+};
+
+#endif //__LOC_EXECUTOR__
@@ -28,250 +28,99 @@
  */
 #include <LocHeap.h>
 
-class LocHeapNode {
-    friend class LocHeap;
-
-    // size of of the subtree, excluding self, 1 if no subtree
-    int mSize;
-    LocHeapNode* mLeft;
-    LocHeapNode* mRight;
-    LocRankable* mData;
-public:
-    inline LocHeapNode(LocRankable& data) :
-        mSize(1), mLeft(NULL), mRight(NULL), mData(&data) {}
-    ~LocHeapNode();
-
-    // this only swaps the data of the two nodes, so no
-    // detach / re-attached is necessary
-    void swap(LocHeapNode& node);
-
-    LocRankable* detachData();
-
-    // push a node into the tree stucture, keeping sorted by rank
-    void push(LocHeapNode& node);
-
-    // pop the head node out of the tree stucture. keeping sorted by rank
-    static LocHeapNode* pop(LocHeapNode*& top);
-
-    // remove a specific node from the tree
-    // returns the pointer to the node removed, which would be either the
-    //         same as input (if successfully removed); or NULL (if failed).
-    static LocHeapNode* remove(LocHeapNode*& top, LocRankable& data);
-
-    // convenience method to compare data ranking
-    inline bool outRanks(LocHeapNode& node) { return mData->outRanks(*node.mData); }
-    inline bool outRanks(LocRankable& data) { return mData->outRanks(data); }
-
-    // checks if mSize is correct, AND this node is the highest ranking
-    // of the entire subtree
-    bool checkNodes();
-
-    inline int getSize() { return mSize; }
-};
-
-inline
-LocHeapNode::~LocHeapNode() {
-    if (mLeft) {
-        delete mLeft;
-        mLeft = NULL;
-    }
-    if (mRight) {
-        delete mRight;
-        mRight = NULL;
-    }
-    if (mData) {
-        mData = NULL;
-    }
-}
-
-inline
-void LocHeapNode::swap(LocHeapNode& node) {
-    LocRankable* tmpData = node.mData;
-    node.mData = mData;
-    mData = tmpData;
-}
-
-inline
-LocRankable* LocHeapNode::detachData()  {
-    LocRankable* data = mData;
-    mData = NULL;
-    return data;
-}
-
-// push keeps the tree sorted by rank, it also tries to balance the
-// tree by adding the new node to the smaller of the subtrees.
-// The pointer to the tree and internal links never change. If the
-// mData of tree top ranks lower than that of the incoming node,
-// mData will be swapped with that of the incoming node to ensure
-// ranking, no restructuring the container nodes.
-void LocHeapNode::push(LocHeapNode& node) {
-    // ensure the current node ranks higher than in the incoming one
-    if (node.outRanks(*this)) {
-        swap(node);
-    }
-
-    // now drop the new node (ensured lower than *this) into a subtree
-    if (NULL == mLeft) {
-        mLeft = &node;
-    } else if (NULL == mRight) {
-        mRight = &node;
-    } else if (mLeft->mSize <= mRight->mSize) {
-        mLeft->push(node);
-    } else {
-        mRight->push(node);
-    }
-    mSize++;
-}
-
-// pop keeps the tree sorted by rank, but it does not try to balance
-// the tree. It recursively swaps with the higher ranked top of the
-// subtrees.
-// The return is a popped out node from leaf level, that has the data
-// swapped all the way down from the top. The pinter to the tree and
-// internal links will not be changed or restructured, except for the
-// node that is popped out.
-// If the return pointer == this, this the last node in the tree.
-LocHeapNode* LocHeapNode::pop(LocHeapNode*& top) {
-    // we know the top has the highest ranking at this point, else
-    // the tree is broken. This top will be popped out.  But we need
-    // a node from the left or right child, whichever ranks higher,
-    // to replace the current top. This then will need to be done
-    // recursively to the leaf level. So we swap the mData of the
-    // current top node all the way down to the leaf level.
-    LocHeapNode* poppedNode = top;
-    // top is losing a node in its subtree
-    top->mSize--;
-    if (top->mLeft || top->mRight) {
-        // if mLeft is NULL, mRight for sure is NOT NULL, take that;
-        // else if mRight is NULL, mLeft for sure is NOT, take that;
-        // else we take the address of whatever has higher ranking mData
-        LocHeapNode*& subTop = (NULL == top->mLeft) ? top->mRight :
-            ((NULL == top->mRight) ? top->mLeft :
-             (top->mLeft->outRanks(*(top->mRight)) ? top->mLeft : top->mRight));
-        // swap mData, the tree top gets updated with the new data.
-        top->swap(*subTop);
-        // pop out from the subtree
-        poppedNode = pop(subTop);
-    } else {
-        // if the top has only single node
-        // detach the poppedNode from the tree
-        // subTop is the reference of ether mLeft or mRight
-        // NOT a local stack pointer. so it MUST be NULL'ed here.
-        top = NULL;
-    }
-
-    return poppedNode;
-}
-
-// navigating through the tree and find the node that hass the input
-// data. Since this is a heap, we do recursive linear search.
-// returns the pointer to the node removed, which would be either the
-//         same as input (if successfully removed); or NULL (if failed).
-LocHeapNode* LocHeapNode::remove(LocHeapNode*& top, LocRankable& data) {
-    LocHeapNode* removedNode = NULL;
-    // this is the node, by address
-    if (&data == (LocRankable*)(top->mData)) {
-        // pop this node out
-        removedNode = pop(top);
-    } else if (!data.outRanks(*top->mData)) {
-        // subtrees might have this node
-        if (top->mLeft) {
-            removedNode = remove(top->mLeft, data);
-        }
-        // if we did not find in mLeft, and mRight is not empty
-        if (!removedNode && top->mRight) {
-            removedNode = remove(top->mRight, data);
-        }
-
-        // top lost a node in its subtree
-        if (removedNode) {
-            top->mSize--;
+// the node in slot index is moved up, with the lower ranking parents
+// moved down a level each, until its parent outranks it
+void LocHeap::siftUp(uint32_t index) {
+    LocRankable* node = mNodes[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / LOC_HEAP_ARITY;
+        if (!node->outRanks(*mNodes[parent])) {
+            break;
         }
+        place(mNodes[parent], index);
+        index = parent;
     }
-
-    return removedNode;
+    place(node, index);
 }
 
-// checks if mSize is correct, AND this node is the highest ranking
-// of the entire subtree
-bool LocHeapNode::checkNodes() {
-    // size of the current subtree
-    int totalSize = mSize;
-    if (mLeft) {
-        // check the consistency of left subtree
-        if (mLeft->outRanks(*this) || !mLeft->checkNodes()) {
-            return false;
+// the node in slot index is moved down, with the highest ranking child
+// moved up a level each time, until it outranks all of its children
+void LocHeap::siftDown(uint32_t index) {
+    LocRankable* node = mNodes[index];
+    uint32_t size = mNodes.size();
+    for (;;) {
+        uint32_t child = index * LOC_HEAP_ARITY + 1;
+        if (child >= size) {
+            break;
         }
-        // subtract the size of left subtree (with subtree head)
-        totalSize -= mLeft->mSize;
-    }
-
-    if (mRight) {
-        // check the consistency of right subtree
-        if (mRight->outRanks(*this) || !mRight->checkNodes()) {
-            return false;
+        uint32_t last = (size - child > LOC_HEAP_ARITY) ? child + LOC_HEAP_ARITY : size;
+        uint32_t top = child;
+        for (child++; child < last; child++) {
+            if (mNodes[child]->outRanks(*mNodes[top])) {
+                top = child;
+            }
         }
-        // subtract the size of right subtree (with subtree head)
-        totalSize -= mRight->mSize;
-    }
-
-    // for the tree nodes to consistent, totalSize must be 1 now
-    return totalSize == 1;
-}
-
-LocHeap::~LocHeap() {
-    if (mTree) {
-        delete mTree;
+        if (!mNodes[top]->outRanks(*node)) {
+            break;
+        }
+        place(mNodes[top], index);
+        index = top;
     }
+    place(node, index);
 }
 
 void LocHeap::push(LocRankable& node) {
-    LocHeapNode* heapNode = new LocHeapNode(node);
-    if (!mTree) {
-        mTree = heapNode;
-    } else {
-        mTree->push(*heapNode);
-    }
-}
-
-LocRankable* LocHeap::peek() {
-    LocRankable* top = NULL;
-    if (mTree) {
-        top = mTree->mData;
-    }
-    return top;
+    mNodes.push_back(&node);
+    siftUp(mNodes.size() - 1);
 }
 
 LocRankable* LocHeap::pop() {
     LocRankable* locNode = NULL;
-    if (mTree) {
-        // mTree may become NULL after this call
-        LocHeapNode* heapNode = LocHeapNode::pop(mTree);
-        locNode = heapNode->detachData();
-        delete heapNode;
+    if (!mNodes.empty()) {
+        locNode = mNodes[0];
+        LocRankable* last = mNodes.back();
+        mNodes.pop_back();
+        if (!mNodes.empty()) {
+            // the last leaf fills the hole at the top and sinks to its level
+            place(last, 0);
+            siftDown(0);
+        }
     }
     return locNode;
 }
 
 LocRankable* LocHeap::remove(LocRankable& rankable) {
     LocRankable* locNode = NULL;
-    if (mTree) {
-        // mTree may become NULL after this call
-        LocHeapNode* heapNode = LocHeapNode::remove(mTree, rankable);
-        if (heapNode) {
-            locNode = heapNode->detachData();
-            delete heapNode;
+    uint32_t index = rankable.mHeapIndex;
+    // the slot is only trustworthy if it holds this very node
+    if (index < mNodes.size() && &rankable == mNodes[index]) {
+        locNode = &rankable;
+        LocRankable* last = mNodes.back();
+        mNodes.pop_back();
+        if (index < mNodes.size()) {
+            // the last leaf fills the hole, and may need to go either way
+            place(last, index);
+            siftUp(index);
+            siftDown(last->mHeapIndex);
         }
     }
     return locNode;
 }
 
 #ifdef __LOC_UNIT_TEST__
+// checks that every node is where it thinks it is, AND that no node
+// outranks its parent
 bool LocHeap::checkTree() {
-    return ((NULL == mTree) || mTree->checkNodes());
+    for (uint32_t i = 0; i < mNodes.size(); i++) {
+        if (mNodes[i]->mHeapIndex != i ||
+            (i > 0 && mNodes[i]->outRanks(*mNodes[(i - 1) / LOC_HEAP_ARITY]))) {
+            return false;
+        }
+    }
+    return true;
 }
 uint32_t LocHeap::getTreeSize() {
-    return (NULL == mTree) ? 0 : mTree->getSize();
+    return mNodes.size();
 }
 #endif
 
@@ -280,15 +129,21 @@ uint32_t LocHeap::getTreeSize() {
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <algorithm>
 
 class LocHeapDebug : public LocHeap {
 public:
     bool checkTree() {
-        return ((NULL == mTree) || mTree->checkNodes());
+        for (uint32_t i = 1; i < mNodes.size(); i++) {
+            if (mNodes[i]->outRanks(*mNodes[(i - 1) / LOC_HEAP_ARITY])) {
+                return false;
+            }
+        }
+        return true;
     }
 
     uint32_t getTreeSize() {
-        return (NULL == mTree) ? 0 : (mTree->getSize());
+        return mNodes.size();
     }
 };
 
@@ -311,26 +166,50 @@ int main(int argc, char** argv) {
     int checks = tries >> 3;
     LocHeapDebug heap;
     int treeSize = 0;
+    std::vector<LocRankable*> nodes;
+    LocHeapDebugData outsider(0);
 
     for (int i = 0; i < tries; i++) {
         if (i % checks == 0 && !heap.checkTree()) {
             printf("tree check failed before %dth op\n", i);
         }
         int r = rand();
+        const char* op = "push";
 
-        if (r & 1) {
-            LocHeapDebugData* data = new LocHeapDebugData(r >> 1);
+        if (r % 4 < 2) {
+            LocHeapDebugData* data = new LocHeapDebugData(r >> 2);
             heap.push(dynamic_cast<LocRankable&>(*data));
+            nodes.push_back(data);
             treeSize++;
-        } else {
+        } else if (r % 4 == 2) {
+            op = "pop";
             LocRankable* rankable = heap.pop();
             if (rankable) {
+                if (heap.peek() && heap.peek()->outRanks(*rankable)) {
+                    printf("popped node is outranked by the new top\n");
+                }
+                nodes.erase(std::find(nodes.begin(), nodes.end(), rankable));
                 delete rankable;
             }
             treeSize ? treeSize-- : 0;
+        } else {
+            op = "remove";
+            if (NULL != heap.remove(outsider)) {
+                printf("removed a node that is not in the heap\n");
+            }
+            if (!nodes.empty()) {
+                size_t n = (r >> 2) % nodes.size();
+                LocRankable* rankable = nodes[n];
+                if (rankable != heap.remove(*rankable)) {
+                    printf("failed to remove a node in the heap\n");
+                }
+                nodes.erase(nodes.begin() + n);
+                delete rankable;
+                treeSize--;
+            }
         }
 
-        printf("%s: %d == %d\n", (r&1)?"push":"pop", treeSize, heap.getTreeSize());
+        printf("%s: %d == %d\n", op, treeSize, heap.getTreeSize());
         if (treeSize != heap.getTreeSize()) {
             printf("!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
             tries = i+1;
@@ -30,11 +30,18 @@
 #define __LOC_HEAP__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <vector>
 
 // abstract class to be implemented by client to provide a rankable class
 class LocRankable {
+    friend class LocHeap;
+    // slot of this obj in the array of the heap that holds it, so that
+    // the heap can remove it without searching
+    uint32_t mHeapIndex;
 public:
+    inline LocRankable() : mHeapIndex(0) {}
     virtual inline ~LocRankable() {}
 
     // method to rank objects of such type for sorting purposes.
@@ -48,23 +55,31 @@ public:
     inline bool outRanks(LocRankable& rankable) { return ranks(rankable) > 0; }
 };
 
-// opaque class to provide service implementation.
-class LocHeapNode;
+// a d-ary heap laid out in an array. It is sorted only vertically, i.e.
+// parent always ranks higher than children, if they exist. Ranking algorithm
+// is implemented in Rankable. The children of the node in slot i are in slots
+// LOC_HEAP_ARITY * i + 1 onwards, so the nodes of a level sit next to each
+// other in memory, and every node knows its slot, so that push, pop and
+// remove are all O(log n) with no allocation per node.
+#define LOC_HEAP_ARITY 4
 
-// a heap whose left and right children are not sorted. It is sorted only vertically,
-// i.e. parent always ranks higher than children, if they exist. Ranking algorithm is
-// implemented in Rankable. The reason that there is no sort between children is to
-// help beter balance the tree with lower cost. When a node is pushed to the tree,
-// it is guaranteed that the subtree that is smaller gets to have the new node.
 class LocHeap {
 protected:
-    LocHeapNode* mTree;
+    std::vector<LocRankable*> mNodes;
+
+    // move the node in slot index up or down until it is in rank order
+    void siftUp(uint32_t index);
+    void siftDown(uint32_t index);
+    inline void place(LocRankable* node, uint32_t index) {
+        mNodes[index] = node;
+        node->mHeapIndex = index;
+    }
 public:
-    inline LocHeap() : mTree(NULL) {}
-    ~LocHeap();
+    inline LocHeap() : mNodes() {}
+    // the nodes are owned by the client
+    inline ~LocHeap() {}
 
-    // push keeps the tree sorted by rank, it also tries to balance the
-    // tree by adding the new node to the smaller of the subtrees.
+    // push keeps the heap sorted by rank.
     // node is reference to an obj that is managed by client, that client
     //      creates and destroyes. The destroy should happen after the
     //      node is popped out from the heap.
@@ -74,17 +89,16 @@ public:
     // There is no change the tree structure with this operation
     // Returns NULL if the tree is empty, otherwise pointer to the node data of
     //         the tree top.
-    LocRankable* peek();
+    inline LocRankable* peek() { return mNodes.empty() ? NULL : mNodes[0]; }
 
-    // pop keeps the tree sorted by rank, but it does not try to balance
-    // the tree.
+    // pop keeps the heap sorted by rank.
     // Return - pointer to the node popped out, or NULL if heap is already empty
     LocRankable* pop();
 
-    // navigating through the tree and find the node that ranks the same
-    // as the input data, then remove it from the tree. Rank is implemented
-    // by rankable obj.
-    // returns the pointer to the node removed; or NULL (if failed).
+    // remove the input node from the heap, looking it up by the slot it
+    // remembers.
+    // returns the pointer to the node removed; or NULL (if it is not in
+    //         this heap).
     LocRankable* remove(LocRankable& rankable);
 
 #ifdef __LOC_UNIT_TEST__
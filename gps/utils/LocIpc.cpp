@@ -29,7 +29,18 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <time.h>
+#include <vector>
 #include <log_util.h>
 #include "LocIpc.h"
 
@@ -43,6 +54,302 @@ namespace loc_util {
 #define LOC_MSG_BUF_LEN 8192
 #define LOC_MSG_HEAD "$MSGLEN$"
 #define LOC_MSG_ABORT "LocIpcMsg::ABORT"
+// datagrams received, or sent, with one call at most
+#define LOC_MSG_BATCH 16
+// long messages reassembled at once, from as many senders, at most
+#define LOC_MSG_LONG_MAX 32
+// a ring offered, with its memfd and eventfd; and taken into use, with its id
+#define LOC_MSG_RING "LocIpcMsg::RING"
+#define LOC_MSG_RING_ON "LocIpcMsg::RINGON"
+
+#define LOC_RING_MAGIC 0x4c6f6352
+#define LOC_RING_WRAP 0xffffffff
+// in the flags of a record, a part of a message continued in the next one
+#define LOC_RING_MORE 0x1
+// how long a sender waits for its ring to be taken, or to have room
+#define LOC_RING_WAIT_NS 1000000000ULL
+
+#ifndef MSG_WAITFORONE
+#define MSG_WAITFORONE 0x10000
+#endif
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+static uint64_t getMonotonicNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Start of the memfd of a LocIpcRing, followed by the ring itself; the
+// producer's and the consumer's fields are on cache lines of their own.
+struct LocIpcRingHeader {
+    uint32_t magic;
+    // of the ring, a power of 2
+    uint32_t size;
+    // to match the LOC_MSG_RING_ON message to the ring
+    uint64_t id;
+    // set by the consumer upon taking the ring, and reset when done with it
+    uint32_t attached;
+    // set by the producer when done with the ring
+    uint32_t closed;
+    // bytes written, by the producer
+    alignas(64) uint64_t head;
+    // bytes consumed, by the consumer
+    alignas(64) uint64_t tail;
+    // set by the consumer before it sleeps on the eventfd
+    uint32_t waiting;
+};
+
+// Single producer single consumer ring of messages in a memfd, between a
+// LocIpcSender and a LocIpc listener. Each message is a record of an 8 byte
+// header, of which the first 4 hold the length and the next 4 the flags,
+// then the message, padded to 8 bytes; one that would run past the end of
+// the ring is preceded by a LOC_RING_WRAP length and starts over at its
+// beginning. A message longer than a record may be goes in parts, all but
+// the last flagged LOC_RING_MORE, for the consumer to put back together.
+// The consumer must not trust the producer with the bounds of the records,
+// see read().
+class LocIpcRing {
+    LocIpcRingHeader* mHeader;
+    char* mData;
+    size_t mMapLen;
+    int mMemFd;
+    int mEventFd;
+    bool mConsumer;
+    bool mOn;
+    // the parts so far of a message, of the consumer
+    std::vector<char> mParts;
+    inline LocIpcRing(LocIpcRingHeader* header, size_t mapLen, int memFd, int eventFd,
+                      bool consumer) :
+            mHeader(header), mData((char*)(header + 1)), mMapLen(mapLen),
+            mMemFd(memFd), mEventFd(eventFd), mConsumer(consumer), mOn(false) {}
+    static inline uint64_t getRecordLen(uint32_t length) {
+        return 8 + (((uint64_t)length + 7) & ~7ULL);
+    }
+public:
+    static LocIpcRing* create(uint32_t size);
+    static LocIpcRing* attach(int memFd, int eventFd);
+    ~LocIpcRing();
+
+    // producer
+    bool offer(int fd);
+    // 1 if the message, or the part of one if more, is written, 0 if there
+    // is no room for it yet, and -1 if it is longer than getMaxPartLen()
+    int write(const uint8_t data[], uint32_t length, bool more);
+    // of a record, half the ring
+    inline uint32_t getMaxPartLen() { return mHeader->size / 2 - 8; }
+    inline bool isAttached() {
+        return __atomic_load_n(&mHeader->attached, __ATOMIC_ACQUIRE);
+    }
+    inline bool isEmpty() {
+        return __atomic_load_n(&mHeader->tail, __ATOMIC_ACQUIRE) == mHeader->head;
+    }
+    inline uint64_t getId() { return mHeader->id; }
+
+    // consumer
+    inline bool isOn() { return mOn; }
+    inline bool isClosed() { return __atomic_load_n(&mHeader->closed, __ATOMIC_ACQUIRE); }
+    inline void setOn() { mOn = true; }
+    inline int getEventFd() { return mEventFd; }
+    // delivers the messages in the ring now to ipc, and returns false once
+    // the producer is done with the ring, or has broken it
+    bool read(LocIpc& ipc);
+    // true if the ring is empty, and the producer to signal the eventfd
+    // upon its next message
+    bool prepareToSleep();
+};
+
+LocIpcRing* LocIpcRing::create(uint32_t size) {
+    uint32_t ringSize = 4096;
+    while (ringSize < size && ringSize < 0x40000000) {
+        ringSize <<= 1;
+    }
+    size_t mapLen = sizeof(LocIpcRingHeader) + ringSize;
+#ifdef __NR_memfd_create
+    int memFd = syscall(__NR_memfd_create, "LocIpcRing", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    int memFd = -1;
+    errno = ENOSYS;
+#endif
+    if (memFd < 0) {
+        LOC_LOGw("memfd_create failed, no ring. reason:%s", strerror(errno));
+        return nullptr;
+    }
+    void* map = MAP_FAILED;
+    int eventFd = -1;
+    if (0 == ftruncate(memFd, mapLen)) {
+#ifdef F_ADD_SEALS
+        // so that the consumer cannot be made to fault on a shrunk memfd
+        (void)fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+        map = mmap(nullptr, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+        eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+    if (MAP_FAILED == map || eventFd < 0) {
+        LOC_LOGw("ring setup failed, no ring. reason:%s", strerror(errno));
+        if (MAP_FAILED != map) {
+            munmap(map, mapLen);
+        }
+        if (eventFd >= 0) {
+            ::close(eventFd);
+        }
+        ::close(memFd);
+        return nullptr;
+    }
+    static uint32_t sCount = 0;
+    LocIpcRingHeader* header = (LocIpcRingHeader*)map;
+    header->magic = LOC_RING_MAGIC;
+    header->size = ringSize;
+    header->id = ((uint64_t)getpid() << 32) | __atomic_add_fetch(&sCount, 1, __ATOMIC_RELAXED);
+    return new LocIpcRing(header, mapLen, memFd, eventFd, false);
+}
+
+LocIpcRing* LocIpcRing::attach(int memFd, int eventFd) {
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (0 == fstat(memFd, &st) && st.st_size > (off_t)sizeof(LocIpcRingHeader)
+#ifdef F_GET_SEALS
+            && (fcntl(memFd, F_GET_SEALS) & F_SEAL_SHRINK)
+#endif
+            ) {
+        map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    }
+    LocIpcRingHeader* header = (LocIpcRingHeader*)map;
+    if (MAP_FAILED == map || LOC_RING_MAGIC != header->magic || 0 == header->size ||
+            (header->size & (header->size - 1)) ||
+            sizeof(LocIpcRingHeader) + header->size != (size_t)st.st_size) {
+        LOC_LOGe("ring refused");
+        if (MAP_FAILED != map) {
+            munmap(map, st.st_size);
+        }
+        ::close(memFd);
+        ::close(eventFd);
+        return nullptr;
+    }
+    __atomic_store_n(&header->attached, 1, __ATOMIC_RELEASE);
+    return new LocIpcRing(header, st.st_size, memFd, eventFd, true);
+}
+
+LocIpcRing::~LocIpcRing() {
+    if (mConsumer) {
+        __atomic_store_n(&mHeader->attached, 0, __ATOMIC_RELEASE);
+    } else {
+        // wakes the consumer to let go of the ring
+        __atomic_store_n(&mHeader->closed, 1, __ATOMIC_SEQ_CST);
+        uint64_t one = 1;
+        (void)::write(mEventFd, &one, sizeof(one));
+    }
+    munmap(mHeader, mMapLen);
+    ::close(mMemFd);
+    ::close(mEventFd);
+}
+
+// sends the memfd and the eventfd over fd, connect()'ed to the consumer
+bool LocIpcRing::offer(int fd) {
+    char msg[] = LOC_MSG_RING;
+    struct iovec iov = { .iov_base = msg, .iov_len = sizeof(msg) - 1 };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buf;
+    hdr.msg_controllen = sizeof(control.buf);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = { mMemFd, mEventFd };
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    return (::sendmsg(fd, &hdr, 0) >= 0);
+}
+
+int LocIpcRing::write(const uint8_t data[], uint32_t length, bool more) {
+    const uint32_t size = mHeader->size;
+    uint64_t recordLen = getRecordLen(length);
+    if (recordLen > size / 2) {
+        return -1;
+    }
+    uint64_t head = mHeader->head;
+    uint32_t offset = head & (size - 1);
+    // records are 8 byte aligned, so there is always room for a wrap
+    uint32_t toEnd = size - offset;
+    uint64_t need = recordLen + ((toEnd < recordLen) ? toEnd : 0);
+    if (head + need - __atomic_load_n(&mHeader->tail, __ATOMIC_ACQUIRE) > size) {
+        return 0;
+    }
+    if (toEnd < recordLen) {
+        *(uint32_t*)(mData + offset) = LOC_RING_WRAP;
+        head += toEnd;
+        offset = 0;
+    }
+    *(uint32_t*)(mData + offset) = length;
+    *(uint32_t*)(mData + offset + 4) = more ? LOC_RING_MORE : 0;
+    memcpy(mData + offset + 8, data, length);
+    // seq_cst, against the consumer's prepareToSleep()
+    __atomic_store_n(&mHeader->head, head + recordLen, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&mHeader->waiting, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        (void)::write(mEventFd, &one, sizeof(one));
+    }
+    return 1;
+}
+
+bool LocIpcRing::read(LocIpc& ipc) {
+    const uint32_t size = mHeader->size;
+    __atomic_store_n(&mHeader->waiting, 0, __ATOMIC_RELAXED);
+    // no more than what is there now, so that the socket gets its turn
+    uint64_t head = __atomic_load_n(&mHeader->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = mHeader->tail;
+    if (head - tail > size) {
+        LOC_LOGe("ring broken, head %" PRIu64 " tail %" PRIu64, head, tail);
+        return false;
+    }
+    while (tail != head) {
+        uint32_t offset = tail & (size - 1);
+        uint32_t length = *(volatile uint32_t*)(mData + offset);
+        if (LOC_RING_WRAP == length) {
+            tail += size - offset;
+        } else if (getRecordLen(length) > size - offset ||
+                   getRecordLen(length) > head - tail) {
+            LOC_LOGe("ring broken, record of %u bytes at %u", length, offset);
+            return false;
+        } else {
+            const char* msg = mData + offset + 8;
+            bool more = (*(volatile uint32_t*)(mData + offset + 4) & LOC_RING_MORE);
+            if (more || !mParts.empty()) {
+                mParts.insert(mParts.end(), msg, msg + length);
+                if (!more) {
+                    ipc.onReceiveData(mParts.data(), mParts.size());
+                    mParts.clear();
+                }
+            } else {
+                ipc.onReceiveData(msg, length);
+            }
+            tail += getRecordLen(length);
+        }
+        __atomic_store_n(&mHeader->tail, tail, __ATOMIC_RELEASE);
+    }
+    return !(__atomic_load_n(&mHeader->closed, __ATOMIC_ACQUIRE) &&
+             __atomic_load_n(&mHeader->head, __ATOMIC_ACQUIRE) == tail);
+}
+
+bool LocIpcRing::prepareToSleep() {
+    __atomic_store_n(&mHeader->waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&mHeader->head, __ATOMIC_SEQ_CST) != mHeader->tail) {
+        __atomic_store_n(&mHeader->waiting, 0, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
 
 class LocIpcRunnable : public LocRunnable {
 friend LocIpc;
@@ -68,12 +375,131 @@ bool LocIpc::startListeningNonBlocking(const std::string& name) {
     return mThread.start(threadName.c_str(), mRunnable);
 }
 
-bool LocIpc::startListeningBlocking(const std::string& name) {
+// grows buf, if need be, to hold a message of length bytes plus a NUL
+static void reserveBuffer(std::vector<uint64_t>& buf, size_t& bufLen, size_t length) {
+    if (length > bufLen) {
+        buf.resize(length / sizeof(uint64_t) + 1);
+        bufLen = length;
+    }
+}
+
+// gets the fds, if any, of a ring offered in msg
+static void getRingFds(struct msghdr* msg, int ringFds[2]) {
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+    if (nullptr != cmsg && SOL_SOCKET == cmsg->cmsg_level &&
+            SCM_RIGHTS == cmsg->cmsg_type && CMSG_LEN(sizeof(int)) <= cmsg->cmsg_len) {
+        size_t nFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        memcpy(ringFds, CMSG_DATA(cmsg), ((nFds < 2) ? nFds : 2) * sizeof(int));
+    }
+}
+
+// Receives a datagram, or a seqpacket message, of up to length bytes into
+// data, with flags for recvmsg(), and returns its full length, per MSG_TRUNC, which is larger than
+// length if the message was cut short; or -1 upon failure. With ringFds,
+// also the two fds of a ring offered, if any, or else -1s; without, any
+// fds sent along are closed by the kernel.
+static ssize_t receiveData(int fd, char* data, size_t length, int flags = 0,
+                           int* ringFds = nullptr) {
+    struct iovec iov = { .iov_base = data, .iov_len = length };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nullptr != ringFds) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        ringFds[0] = ringFds[1] = -1;
+    }
+    ssize_t nBytes = ::recvmsg(fd, &msg, flags | MSG_TRUNC | MSG_CMSG_CLOEXEC);
+    if (nBytes > 0 && (msg.msg_flags & MSG_TRUNC)) {
+        LOC_LOGe("message of %zd bytes cut to %zu", nBytes, length);
+    }
+    if (nullptr != ringFds && nBytes >= 0) {
+        getRingFds(&msg, ringFds);
+    }
+    return nBytes;
+}
+
+// Takes in, or lets go of, a ring of a LocIpcSender as asked by msg, if one
+// of LOC_MSG_RING or LOC_MSG_RING_ON; and returns false for any other msg.
+static bool takeRing(const char* msg, size_t length, int ringFds[2],
+                     std::vector<LocIpcRing*>& rings) {
+    const size_t ringLen = sizeof(LOC_MSG_RING) - 1;
+    const size_t ringOnLen = sizeof(LOC_MSG_RING_ON) - 1;
+    uint64_t id = 0;
+    if (length == ringLen && 0 == memcmp(msg, LOC_MSG_RING, ringLen)) {
+        if (ringFds[0] >= 0 && ringFds[1] >= 0) {
+            LocIpcRing* ring = LocIpcRing::attach(ringFds[0], ringFds[1]);
+            ringFds[0] = ringFds[1] = -1;
+            if (nullptr != ring) {
+                rings.push_back(ring);
+            }
+        }
+    } else if (length == ringOnLen + sizeof(id) && 0 == memcmp(msg, LOC_MSG_RING_ON, ringOnLen)) {
+        memcpy(&id, msg + ringOnLen, sizeof(id));
+        for (size_t i = 0; i < rings.size(); i++) {
+            if (rings[i]->getId() == id) {
+                rings[i]->setOn();
+            }
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Delivers what is in the rings, and waits for more in them or on fd; returns
+// true once there is something on fd, and false if it failed.
+static bool waitWithRings(LocIpc& ipc, int fd, std::vector<LocIpcRing*>& rings) {
+    std::vector<struct pollfd> fds;
+    while (1) {
+        fds.resize(1);
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        bool idle = true;
+        for (size_t i = rings.size(); i-- > 0; ) {
+            LocIpcRing* ring = rings[i];
+            // rings not on yet are watched only for their producers to close
+            if ((ring->isOn()) ? !ring->read(ipc) : ring->isClosed()) {
+                delete ring;
+                rings.erase(rings.begin() + i);
+                continue;
+            } else if (ring->isOn() && !ring->prepareToSleep()) {
+                idle = false;
+            }
+            struct pollfd ringFd = { .fd = ring->getEventFd(), .events = POLLIN, .revents = 0 };
+            fds.push_back(ringFd);
+        }
+        if (::poll(fds.data(), fds.size(), idle ? -1 : 0) < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return false;
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            uint64_t count;
+            if (fds[i].revents & POLLIN) {
+                (void)::read(fds[i].fd, &count, sizeof(count));
+            }
+        }
+        if (fds[0].revents) {
+            return true;
+        }
+    }
+}
+
+// binds a socket of the kind asked for to name, and returns it; or -1
+int LocIpc::bindSocket(const std::string& name) {
 
-    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    int fd = socket(AF_UNIX, (0 == mSeqPacketLen) ? SOCK_DGRAM : SOCK_SEQPACKET, 0);
     if (fd < 0) {
         LOC_LOGe("create socket error. reason:%s", strerror(errno));
-        return false;
+        return -1;
     }
 
     if ((unlink(name.c_str()) < 0) && (errno != ENOENT)) {
@@ -88,7 +514,23 @@ bool LocIpc::startListeningBlocking(const std::string& name) {
     if (::bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         LOC_LOGe("bind socket error. reason:%s", strerror(errno));
         ::close(fd);
-        fd = -1;
+        return -1;
+    }
+
+    if (0 != mSeqPacketLen && ::listen(fd, SOMAXCONN) < 0) {
+        LOC_LOGe("listen socket error. reason:%s", strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+
+    mLongMsgs.clear();
+    return fd;
+}
+
+bool LocIpc::startListeningBlocking(const std::string& name) {
+
+    int fd = bindSocket(name);
+    if (fd < 0) {
         return false;
     }
 
@@ -97,54 +539,264 @@ bool LocIpc::startListeningBlocking(const std::string& name) {
     // inform that the socket is ready to receive message
     onListenerReady();
 
-    ssize_t nBytes = 0;
-    std::string msg = "";
-    std::string abort = LOC_MSG_ABORT;
+    if (0 == mSeqPacketLen) {
+        receiveDatagrams();
+    } else {
+        receiveSeqPackets();
+    }
+
+    if (mStopRequested) {
+        mStopRequested = false;
+        return true;
+    } else {
+        LOC_LOGe("cannot read socket. reason:%s", strerror(errno));
+        (void)::close(mIpcFd);
+        mIpcFd = -1;
+        return false;
+    }
+}
+
+bool LocIpc::startListeningNonBlocking(const std::string& name, LocIpcReactor& reactor) {
+    if (0 != mSeqPacketLen) {
+        LOC_LOGe("%s: no seqpacket socket with a reactor", name.c_str());
+        return false;
+    } else if (mShmRing) {
+        LOC_LOGw("%s: no rings taken with a reactor", name.c_str());
+    }
+
+    int fd = bindSocket(name);
+    if (fd < 0) {
+        return false;
+    }
+
+    mIpcFd = fd;
+    mStopRequested = false;
+
+    // inform that the socket is ready to receive message
+    onListenerReady();
+
+    if (!reactor.add(*this, name)) {
+        (void)::close(mIpcFd);
+        mIpcFd = -1;
+        unlink(name.c_str());
+        return false;
+    }
+    return true;
+}
+
+// returns upon an abort message, or a failure to receive
+void LocIpc::receiveDatagrams() {
+    // rings taken, see setShmRing()
+    std::vector<LocIpcRing*> rings;
+    // not mIpcFd, which stopListening() may set to -1 while rings are read,
+    // for poll() to skip; a closed fd, by contrast, wakes it up
+    const int fd = mIpcFd;
     while (1) {
-        msg.resize(LOC_MSG_BUF_LEN);
-        nBytes = ::recvfrom(mIpcFd, (void*)(msg.data()), msg.size(), 0, NULL, NULL);
-        if (nBytes < 0) {
+        if (!rings.empty() && !waitWithRings(*this, fd, rings)) {
             break;
-        } else if (nBytes == 0) {
-            continue;
         }
-
-        if (strncmp(msg.data(), abort.c_str(), abort.length()) == 0) {
-            LOC_LOGi("recvd abort msg.data %s", msg.data());
+        if (receiveDatagram(0, mShmRing ? &rings : nullptr) < 0) {
             break;
         }
+    }
 
-        if (strncmp(msg.data(), LOC_MSG_HEAD, sizeof(LOC_MSG_HEAD) - 1)) {
-            // short message
-            msg.resize(nBytes);
-            onReceive(msg);
-        } else {
-            // long message
-            size_t msgLen = 0;
-            sscanf(msg.data(), LOC_MSG_HEAD"%zu", &msgLen);
-            msg.resize(msgLen);
-            size_t msgLenReceived = 0;
-            while ((msgLenReceived < msgLen) && (nBytes > 0)) {
-                nBytes = recvfrom(mIpcFd, (void*)&(msg[msgLenReceived]),
-                        msg.size() - msgLenReceived, 0, NULL, NULL);
-                msgLenReceived += nBytes;
-            }
-            if (nBytes > 0) {
-                onReceive(msg);
-            } else {
-                break;
+    for (size_t i = 0; i < rings.size(); i++) {
+        delete rings[i];
+    }
+}
+
+// Receives datagrams, as many as there are up to LOC_MSG_BATCH, with flags
+// for recvmmsg(), and delivers them in order, or the long message they
+// complete; rings, if not nullptr, takes the rings offered. Returns 1 if any
+// datagram was received, 0 if there was none to receive without blocking,
+// and -1 upon an abort message, or a failure to receive.
+int LocIpc::receiveDatagram(int flags, std::vector<LocIpcRing*>* rings) {
+    // A slot per datagram, of LOC_MSG_BUF_LEN bytes and a spare 8 for a NUL,
+    // allocated once and reused; blocking, if at all, for the first only.
+    const size_t slotLen = LOC_MSG_BUF_LEN + sizeof(uint64_t);
+    if (mBatchBuf.empty()) {
+        mBatchBuf.resize(LOC_MSG_BATCH * slotLen / sizeof(uint64_t));
+    }
+    struct mmsghdr hdrs[LOC_MSG_BATCH];
+    struct iovec iovs[LOC_MSG_BATCH];
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+    } controls[LOC_MSG_BATCH];
+    // whom from, see LocIpcSender, to reassemble long messages by
+    struct sockaddr_un senders[LOC_MSG_BATCH];
+    memset(hdrs, 0, sizeof(hdrs));
+    for (int i = 0; i < LOC_MSG_BATCH; i++) {
+        iovs[i].iov_base = (char*)mBatchBuf.data() + i * slotLen;
+        iovs[i].iov_len = LOC_MSG_BUF_LEN;
+        hdrs[i].msg_hdr.msg_name = &senders[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+        hdrs[i].msg_hdr.msg_iov = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+        if (nullptr != rings) {
+            hdrs[i].msg_hdr.msg_control = controls[i].buf;
+            hdrs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+        }
+    }
+    int n = ::recvmmsg(mIpcFd, hdrs, LOC_MSG_BATCH,
+                       flags | MSG_WAITFORONE | MSG_TRUNC | MSG_CMSG_CLOEXEC, nullptr);
+    if (n < 0) {
+        return (EAGAIN == errno || EWOULDBLOCK == errno) ? 0 : -1;
+    }
+
+    int rtv = 1;
+    for (int i = 0; i < n; i++) {
+        int ringFds[2] = { -1, -1 };
+        if (nullptr != rings) {
+            getRingFds(&hdrs[i].msg_hdr, ringFds);
+        }
+        if (hdrs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            LOC_LOGe("message of %u bytes cut to %u", hdrs[i].msg_len, LOC_MSG_BUF_LEN);
+        }
+        // unnamed senders, if any, all go by the empty name
+        const size_t pathOffset = offsetof(struct sockaddr_un, sun_path);
+        socklen_t nameLen = hdrs[i].msg_hdr.msg_namelen;
+        nameLen = (nameLen > pathOffset && nameLen <= sizeof(senders[i])) ?
+                nameLen - pathOffset : 0;
+        // none delivered after an abort message, or once stopListening()
+        if (rtv > 0) {
+            rtv = mStopRequested ? -1 :
+                    deliverDatagram((char*)iovs[i].iov_base, hdrs[i].msg_len,
+                                    senders[i].sun_path, nameLen, ringFds, rings);
+        }
+        // not taken, if not to be
+        for (int j = 0; j < 2; j++) {
+            if (ringFds[j] >= 0) {
+                ::close(ringFds[j]);
             }
         }
     }
+    return rtv;
+}
 
-    if (mStopRequested) {
-        mStopRequested = false;
-        return true;
+// Delivers a datagram of nBytes at msg, which has room for a NUL after it,
+// from the sender of name, of nameLen bytes; or takes it as the next part of
+// the long message of that sender, or takes the ring it offers. Returns -1
+// if it is an abort message, else 1.
+int LocIpc::deliverDatagram(char* msg, size_t nBytes, const char* name, size_t nameLen,
+                            int ringFds[2], std::vector<LocIpcRing*>* rings) {
+    auto it = mLongMsgs.empty() ? mLongMsgs.end() :
+            mLongMsgs.find(std::string(name, nameLen));
+    if (mLongMsgs.end() != it) {
+        // a part of a long message
+        LongMsg& longMsg = it->second;
+        size_t partLen = (nBytes < LOC_MSG_BUF_LEN) ? nBytes : LOC_MSG_BUF_LEN;
+        if (partLen > longMsg.length - longMsg.received) {
+            partLen = longMsg.length - longMsg.received;
+        }
+        memcpy((char*)longMsg.buf.data() + longMsg.received, msg, partLen);
+        longMsg.received += partLen;
+        if (longMsg.received == longMsg.length) {
+            size_t length = longMsg.length;
+            // its buffer kept for the next long message to reuse
+            mBuf.swap(longMsg.buf);
+            mLongMsgs.erase(it);
+            onReceiveData((char*)mBuf.data(), length);
+        }
+        return 1;
+    } else if (nBytes == 0 || nBytes > LOC_MSG_BUF_LEN) {
+        return 1;
+    }
+
+    const size_t headLen = sizeof(LOC_MSG_HEAD) - 1;
+    const size_t abortLen = sizeof(LOC_MSG_ABORT) - 1;
+    std::vector<LocIpcRing*> noRings;
+    if (nBytes >= abortLen && 0 == memcmp(msg, LOC_MSG_ABORT, abortLen)) {
+        msg[nBytes] = '\0';
+        LOC_LOGi("recvd abort msg.data %s", msg);
+        return -1;
+    } else if (takeRing(msg, nBytes, ringFds, (nullptr != rings) ? *rings : noRings)) {
+        // a ring taken or dropped, nothing to deliver
+    } else if (nBytes < headLen || memcmp(msg, LOC_MSG_HEAD, headLen)) {
+        // short message
+        onReceiveData(msg, nBytes);
     } else {
-        LOC_LOGe("cannot read socket. reason:%s", strerror(errno));
-        (void)::close(mIpcFd);
-        mIpcFd = -1;
-        return false;
+        // long message, its parts to follow, from this sender only
+        size_t length = 0;
+        msg[nBytes] = '\0';
+        sscanf(msg, LOC_MSG_HEAD"%zu", &length);
+        if (length > 0) {
+            if (mLongMsgs.size() >= LOC_MSG_LONG_MAX) {
+                LOC_LOGw("%zu long messages under way, dropped", mLongMsgs.size());
+                mLongMsgs.clear();
+            }
+            // a head from a sender with a long message under way starts anew
+            LongMsg& longMsg = mLongMsgs[std::string(name, nameLen)];
+            if (longMsg.buf.empty()) {
+                longMsg.buf.swap(mBuf);
+            }
+            size_t bufLen = longMsg.buf.size() * sizeof(uint64_t);
+            reserveBuffer(longMsg.buf, bufLen, length);
+            longMsg.length = length;
+            longMsg.received = 0;
+        }
+    }
+    return 1;
+}
+
+// Accepts connections on the listening seqpacket socket and receives from all
+// of them, a whole message per receive; returns upon an abort message, or a
+// failure of the listening socket.
+void LocIpc::receiveSeqPackets() {
+    // the listening socket first, then one per connected sender
+    std::vector<struct pollfd> fds(1);
+    fds[0].fd = mIpcFd;
+    fds[0].events = POLLIN;
+    std::vector<uint64_t> buf;
+    size_t bufLen = 0;
+    reserveBuffer(buf, bufLen, mSeqPacketLen);
+    char* msg = (char*)buf.data();
+    const size_t abortLen = sizeof(LOC_MSG_ABORT) - 1;
+    // rings are not taken here, their offers are dropped
+    int noFds[2] = { -1, -1 };
+    std::vector<LocIpcRing*> noRings;
+    bool listening = true;
+    while (listening) {
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            break;
+        } else if (fds[0].revents & POLLIN) {
+            int fd = ::accept(mIpcFd, nullptr, nullptr);
+            if (fd >= 0) {
+                struct pollfd conn = { .fd = fd, .events = POLLIN, .revents = 0 };
+                fds.push_back(conn);
+            } else {
+                LOC_LOGw("accept socket error. reason:%s", strerror(errno));
+            }
+        }
+        // backwards, as hung up connections are taken out as we go
+        for (size_t i = fds.size() - 1; i > 0 && listening; i--) {
+            if (0 == fds[i].revents) {
+                continue;
+            }
+            ssize_t nBytes = receiveData(fds[i].fd, msg, bufLen);
+            if (nBytes < 0 || (0 == nBytes && (fds[i].revents & POLLHUP))) {
+                (void)::close(fds[i].fd);
+                fds.erase(fds.begin() + i);
+            } else if (nBytes == 0 || (size_t)nBytes > bufLen) {
+                continue;
+            } else if ((size_t)nBytes >= abortLen && 0 == memcmp(msg, LOC_MSG_ABORT, abortLen)) {
+                msg[nBytes] = '\0';
+                LOC_LOGi("recvd abort msg.data %s", msg);
+                listening = false;
+            } else if (!takeRing(msg, nBytes, noFds, noRings)) {
+                onReceiveData(msg, nBytes);
+            }
+        }
+    }
+
+    for (size_t i = 1; i < fds.size(); i++) {
+        (void)::close(fds[i].fd);
     }
 }
 
@@ -153,6 +805,10 @@ void LocIpc::stopListening() {
     const char *socketName = nullptr;
     mStopRequested = true;
 
+    if (nullptr != mReactor) {
+        mReactor->remove(*this);
+    }
+
     if (mRunnable) {
         std::string abort = LOC_MSG_ABORT;
         socketName = (reinterpret_cast<LocIpcRunnable *>(mRunnable))->mIpcName.c_str();
@@ -173,44 +829,151 @@ void LocIpc::stopListening() {
     }
 }
 
-bool LocIpc::send(const char name[], const std::string& data) {
-    return send(name, (const uint8_t*)data.c_str(), data.length());
+class LocIpcReactorRunnable : public LocRunnable {
+    LocIpcReactor& mReactor;
+public:
+    inline LocIpcReactorRunnable(LocIpcReactor& reactor) : mReactor(reactor) {}
+    bool run() override { return mReactor.run(); }
+};
+
+LocIpcReactor::LocIpcReactor() :
+        mEpollFd(epoll_create1(EPOLL_CLOEXEC)), mStopFd(eventfd(0, EFD_CLOEXEC)) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = mStopFd;
+    if (mEpollFd < 0 || mStopFd < 0 ||
+            epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mStopFd, &event) < 0 ||
+            !mThread.start("LocIpcReactor", new LocIpcReactorRunnable(*this))) {
+        LOC_LOGe("reactor not started. reason:%s", strerror(errno));
+    }
 }
 
-bool LocIpc::send(const char name[], const uint8_t data[], uint32_t length) {
+LocIpcReactor::~LocIpcReactor() {
+    uint64_t one = 1;
+    if (mStopFd >= 0) {
+        (void)::write(mStopFd, &one, sizeof(one));
+    }
+    mThread.stop();
+    while (!mListeners.empty()) {
+        remove(*mListeners.begin()->second.first);
+    }
+    if (mEpollFd >= 0) {
+        ::close(mEpollFd);
+    }
+    if (mStopFd >= 0) {
+        ::close(mStopFd);
+    }
+}
 
-    bool result = true;
-    int fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (fd < 0) {
-        LOC_LOGe("create socket error. reason:%s", strerror(errno));
+LocIpcReactor& LocIpcReactor::getInstance() {
+    // never deleted, as LocIpc may stop listening with it at exit
+    static LocIpcReactor* sReactor = new LocIpcReactor();
+    return *sReactor;
+}
+
+bool LocIpcReactor::add(LocIpc& ipc, const std::string& name) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = ipc.mIpcFd;
+    // non blocking, as the reactor must never wait on any one socket
+    int flags = fcntl(ipc.mIpcFd, F_GETFL);
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+    if (mEpollFd < 0 || flags < 0 || fcntl(ipc.mIpcFd, F_SETFL, flags | O_NONBLOCK) < 0 ||
+            epoll_ctl(mEpollFd, EPOLL_CTL_ADD, ipc.mIpcFd, &event) < 0) {
+        LOC_LOGe("%s: not added to reactor. reason:%s", name.c_str(), strerror(errno));
         return false;
     }
+    mListeners[ipc.mIpcFd] = std::make_pair(&ipc, name);
+    ipc.mReactor = this;
+    return true;
+}
 
-    struct sockaddr_un addr = { .sun_family = AF_UNIX };
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", name);
+void LocIpcReactor::remove(LocIpc& ipc) {
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+    auto it = mListeners.find(ipc.mIpcFd);
+    if (mListeners.end() != it && &ipc == it->second.first) {
+        (void)epoll_ctl(mEpollFd, EPOLL_CTL_DEL, ipc.mIpcFd, nullptr);
+        unlink(it->second.second.c_str());
+        mListeners.erase(it);
+    }
+    ipc.mReactor = nullptr;
+}
 
-    result = sendData(fd, addr, data, length);
+// waits for messages, and delivers them; false once the reactor is to stop
+bool LocIpcReactor::run() {
+    struct epoll_event events[16];
+    int n = epoll_wait(mEpollFd, events, sizeof(events) / sizeof(events[0]), -1);
+    if (n < 0) {
+        if (EINTR == errno) {
+            return true;
+        }
+        LOC_LOGe("epoll_wait error. reason:%s", strerror(errno));
+        return false;
+    }
+    std::lock_guard<std::recursive_mutex> lock(mMutex);
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if (fd == mStopFd) {
+            return false;
+        }
+        // a few datagrams per socket at a time, so that none starves the
+        // others; the LocIpc is looked up each time, as its onReceiveData() may
+        // have it, or another, stop listening
+        for (int count = 0; count < 16; count++) {
+            auto it = mListeners.find(fd);
+            if (mListeners.end() == it) {
+                break;
+            }
+            LocIpc* ipc = it->second.first;
+            int received = ipc->receiveDatagram(MSG_DONTWAIT, nullptr);
+            if (0 == received) {
+                break;
+            } else if (received < 0) {
+                // unless it stopped listening in onReceiveData()
+                it = mListeners.find(fd);
+                if (mListeners.end() != it && ipc == it->second.first) {
+                    LOC_LOGe("%s: cannot read socket, removed from reactor",
+                             it->second.second.c_str());
+                    remove(*ipc);
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
 
-    (void)::close(fd);
-    return result;
+bool LocIpc::send(const char name[], const std::string& data) {
+    return send(name, (const uint8_t*)data.c_str(), data.length());
+}
+
+bool LocIpc::send(const char name[], const uint8_t data[], uint32_t length) {
+    // a sender for the one message, which also finds out whether name is
+    // a datagram or a seqpacket socket
+    return LocIpcSender(name).send(data, length);
+}
+
+static inline ssize_t sendPart(int fd, const sockaddr_un* addr, const void* data, size_t length) {
+    return (nullptr == addr) ? ::send(fd, data, length, 0) :
+            ::sendto(fd, data, length, 0, (struct sockaddr*)addr, sizeof(*addr));
 }
 
 
-bool LocIpc::sendData(int fd, const sockaddr_un &addr, const uint8_t data[], uint32_t length) {
+bool LocIpc::sendData(int fd, const sockaddr_un* addr, const uint8_t data[], uint32_t length) {
 
     bool result = true;
 
     if (length <= LOC_MSG_BUF_LEN) {
-        if (::sendto(fd, data, length, 0,
-                (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        if (sendPart(fd, addr, data, length) < 0) {
             LOC_LOGe("cannot send to socket. reason:%s", strerror(errno));
             result = false;
         }
     } else {
         std::string head = LOC_MSG_HEAD;
         head.append(std::to_string(length));
-        if (::sendto(fd, head.c_str(), head.length(), 0,
-                (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        if (sendPart(fd, addr, head.c_str(), head.length()) < 0) {
             LOC_LOGe("cannot send to socket. reason:%s", strerror(errno));
             result = false;
         } else {
@@ -220,8 +983,7 @@ bool LocIpc::sendData(int fd, const sockaddr_un &addr, const uint8_t data[], uin
                 if (partLen > LOC_MSG_BUF_LEN) {
                     partLen = LOC_MSG_BUF_LEN;
                 }
-                ssize_t rv = ::sendto(fd, data + sentBytes, partLen, 0,
-                        (struct sockaddr*)&addr, sizeof(addr));
+                ssize_t rv = sendPart(fd, addr, data + sentBytes, partLen);
                 if (rv < 0) {
                     LOC_LOGe("cannot send to socket. reason:%s", strerror(errno));
                     result = false;
@@ -234,4 +996,932 @@ bool LocIpc::sendData(int fd, const sockaddr_un &addr, const uint8_t data[], uin
     return result;
 }
 
+// Binds a datagram socket to a name of the kernel's choosing, in the abstract
+// namespace, so that the listener can tell the parts of its long messages
+// from those of other senders.
+static void bindAnyName(int fd) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (::bind(fd, (struct sockaddr*)&addr, sizeof(addr.sun_family)) < 0) {
+        LOC_LOGw("autobind socket error. reason:%s", strerror(errno));
+    }
+}
+
+LocIpcSender::LocIpcSender(const char* destSocket) :
+        mSocket(::socket(AF_UNIX, SOCK_DGRAM, 0)), mType(SOCK_DGRAM), mConnected(false),
+        mRingSize(0), mRing(nullptr), mRingOn(false), mRingStartNs(0) {
+    memset(&mDestAddr, 0, sizeof(mDestAddr));
+    if (-1 == mSocket) {
+        LOC_LOGe("create socket error. reason:%s", strerror(errno));
+    } else if (nullptr != destSocket) {
+        bindAnyName(mSocket);
+        mDestAddr.sun_family = AF_UNIX;
+        snprintf(mDestAddr.sun_path, sizeof(mDestAddr.sun_path), "%s", destSocket);
+    }
+}
+
+LocIpcSender::~LocIpcSender() {
+    stopRing();
+    if (-1 != mSocket) {
+        ::close(mSocket);
+    }
+}
+
+// Connects to the destination, with a socket of the given type. A seqpacket
+// socket connects only once, so it takes a new one; as does a change of type.
+bool LocIpcSender::connectSocket(int type) {
+    if (type != mType || SOCK_SEQPACKET == type) {
+        int fd = ::socket(AF_UNIX, type, 0);
+        if (fd < 0) {
+            LOC_LOGe("create socket error. reason:%s", strerror(errno));
+            return false;
+        }
+        if (SOCK_DGRAM == type) {
+            bindAnyName(fd);
+        }
+        (void)::close(mSocket);
+        mSocket = fd;
+        mType = type;
+    }
+    return (0 == ::connect(mSocket, (struct sockaddr*)&mDestAddr, sizeof(mDestAddr)));
+}
+
+// Sends a message whole over the connected seqpacket socket, after growing
+// the socket's send buffer if the message does not fit into it.
+bool LocIpcSender::sendPacket(const uint8_t data[], uint32_t length) {
+    // MSG_NOSIGNAL, as a destination gone away is no reason for SIGPIPE
+    ssize_t rv = ::send(mSocket, data, length, MSG_NOSIGNAL);
+    if (rv < 0 && EMSGSIZE == errno) {
+        int sndBufLen = length;
+        if (0 == setsockopt(mSocket, SOL_SOCKET, SO_SNDBUF, &sndBufLen, sizeof(sndBufLen))) {
+            rv = ::send(mSocket, data, length, MSG_NOSIGNAL);
+        }
+    }
+    if (rv < 0) {
+        LOC_LOGe("cannot send to socket. reason:%s", strerror(errno));
+    }
+    return (rv >= 0);
+}
+
+void LocIpcSender::setShmRing(uint32_t size) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    stopRing();
+    mRingSize = size;
+    // offered upon the next connect
+    mConnected = false;
+}
+
+void LocIpcSender::startRing() {
+    stopRing();
+    if (0 != mRingSize && SOCK_DGRAM == mType) {
+        mRing = LocIpcRing::create(mRingSize);
+        if (nullptr != mRing && !mRing->offer(mSocket)) {
+            LOC_LOGw("cannot offer ring to %s. reason:%s", mDestAddr.sun_path, strerror(errno));
+            stopRing();
+        }
+        mRingStartNs = getMonotonicNs();
+    }
+}
+
+void LocIpcSender::stopRing() {
+    delete mRing;
+    mRing = nullptr;
+    mRingOn = false;
+}
+
+// Sends a message through the ring, once the destination has taken it; or
+// returns false for the message to go as a datagram.
+bool LocIpcSender::sendToRing(const uint8_t data[], uint32_t length) {
+    if (!mRing->isAttached()) {
+        // let go of by the destination, or not taken in time
+        if (mRingOn || getMonotonicNs() - mRingStartNs > LOC_RING_WAIT_NS) {
+            stopRing();
+        }
+        return false;
+    }
+    if (!mRingOn) {
+        // the destination reads the ring from this message on, so it gets
+        // all datagrams sent before the messages in the ring
+        uint8_t msg[sizeof(LOC_MSG_RING_ON) - 1 + sizeof(uint64_t)];
+        uint64_t id = mRing->getId();
+        memcpy(msg, LOC_MSG_RING_ON, sizeof(LOC_MSG_RING_ON) - 1);
+        memcpy(msg + sizeof(LOC_MSG_RING_ON) - 1, &id, sizeof(id));
+        if (!LocIpc::sendData(mSocket, nullptr, msg, sizeof(msg))) {
+            return false;
+        }
+        mRingOn = true;
+    }
+    // in parts, if too long for a record, rather than as a datagram that
+    // the messages in the ring after it could get ahead of
+    const uint32_t maxPartLen = mRing->getMaxPartLen();
+    uint32_t sent = 0;
+    uint64_t startNs = 0;
+    while (1) {
+        uint32_t partLen = (length - sent > maxPartLen) ? maxPartLen : length - sent;
+        bool more = (sent + partLen < length);
+        if (mRing->write(data + sent, partLen, more) > 0) {
+            if (!more) {
+                return true;
+            }
+            sent += partLen;
+            startNs = 0;
+            continue;
+        } else if (0 == startNs) {
+            startNs = getMonotonicNs();
+        } else if (!mRing->isAttached() || getMonotonicNs() - startNs > LOC_RING_WAIT_NS) {
+            LOC_LOGe("ring to %s stuck, back to datagrams", mDestAddr.sun_path);
+            stopRing();
+            return false;
+        }
+        usleep(100);
+    }
+}
+
+bool LocIpcSender::send(const uint8_t data[], uint32_t length) {
+    bool rtv = false;
+    if (-1 != mSocket && nullptr != data) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        rtv = sendOne(data, length);
+    }
+    return rtv;
+}
+
+bool LocIpcSender::sendBatch(const std::string data[], size_t count) {
+    bool rtv = (-1 != mSocket);
+    if (rtv) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        struct mmsghdr hdrs[LOC_MSG_BATCH];
+        struct iovec iovs[LOC_MSG_BATCH];
+        size_t i = 0;
+        while (i < count) {
+            // a run of messages that go in one datagram, or seqpacket message,
+            // each; not to a ring, nor before the first connect
+            uint32_t n = 0;
+            while (mConnected && nullptr == mRing && n < LOC_MSG_BATCH && i + n < count &&
+                   (SOCK_SEQPACKET == mType || data[i + n].length() <= LOC_MSG_BUF_LEN)) {
+                iovs[n].iov_base = (void*)data[i + n].data();
+                iovs[n].iov_len = data[i + n].length();
+                memset(&hdrs[n], 0, sizeof(hdrs[n]));
+                hdrs[n].msg_hdr.msg_iov = &iovs[n];
+                hdrs[n].msg_hdr.msg_iovlen = 1;
+                n++;
+            }
+            int sent = (n > 1) ? ::sendmmsg(mSocket, hdrs, n,
+                                            (SOCK_SEQPACKET == mType) ? MSG_NOSIGNAL : 0) : 0;
+            if (sent > 0) {
+                i += sent;
+            } else {
+                // one by one, to reconnect, or fragment, as need be
+                rtv = sendOne((const uint8_t*)data[i].data(), data[i].length()) && rtv;
+                i++;
+            }
+        }
+    }
+    return rtv;
+}
+
+// sends one message, with mMutex held
+bool LocIpcSender::sendOne(const uint8_t data[], uint32_t length) {
+    bool rtv = false;
+    if (nullptr != mRing && sendToRing(data, length)) {
+        return true;
+    }
+    // A destination that has gone, or has bound its socket anew, refuses
+    // whatever is sent over the old connection; in which case we connect
+    // to whoever is bound to the path now, and send once more. A socket of
+    // the other type than the destination is refused with EPROTOTYPE.
+    for (int tries = 0; !rtv && tries < 2; tries++) {
+        if (!mConnected || tries > 0) {
+            mConnected = connectSocket(mType) || (EPROTOTYPE == errno &&
+                    connectSocket((SOCK_DGRAM == mType) ? SOCK_SEQPACKET : SOCK_DGRAM));
+            if (!mConnected) {
+                LOC_LOGe("cannot connect to %s. reason:%s",
+                         mDestAddr.sun_path, strerror(errno));
+                break;
+            }
+            startRing();
+        }
+        rtv = (SOCK_SEQPACKET == mType) ? sendPacket(data, length) :
+                LocIpc::sendData(mSocket, nullptr, data, length);
+        if (!rtv && ECONNREFUSED != errno && ENOTCONN != errno &&
+                ECONNRESET != errno && EDESTADDRREQ != errno && EPIPE != errno) {
+            break;
+        }
+    }
+    return rtv;
+}
+
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <algorithm>
+
+using namespace loc_util;
+
+class LocIpcCounter : public LocIpc {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    bool mReady;
+    uint32_t mCount;
+    uint32_t mCorrupt;
+public:
+    inline LocIpcCounter() : mMutex(PTHREAD_MUTEX_INITIALIZER),
+            mCond(PTHREAD_COND_INITIALIZER), mReady(false), mCount(0), mCorrupt(0) {}
+    void onListenerReady() override {
+        pthread_mutex_lock(&mMutex);
+        mReady = true;
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    // msgs are filled with 'a' to 'z' over and over, see fill()
+    void onReceiveData(const char data[], uint32_t length) override {
+        bool corrupt = false;
+        for (uint32_t i = 0; i < length && !corrupt; i++) {
+            corrupt = (data[i] != (char)('a' + i % 26));
+        }
+        pthread_mutex_lock(&mMutex);
+        mCount++;
+        mCorrupt += corrupt;
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    void waitReady() {
+        pthread_mutex_lock(&mMutex);
+        while (!mReady) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    // true if count msgs in all arrived within a second of the last one
+    bool waitCount(uint32_t count) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+        pthread_mutex_lock(&mMutex);
+        while (mCount < count &&
+               0 == pthread_cond_timedwait(&mCond, &mMutex, &deadline));
+        bool arrived = (mCount >= count);
+        pthread_mutex_unlock(&mMutex);
+        return arrived;
+    }
+    inline uint32_t getCount() { return mCount; }
+    inline uint32_t getCorrupt() { return mCorrupt; }
+    static std::string fill(uint32_t size) {
+        std::string data(size, 'a');
+        for (uint32_t i = 0; i < size; i++) {
+            data[i] = 'a' + i % 26;
+        }
+        return data;
+    }
+};
+
+// counts msgs that carry a sequence number in their first 4 bytes, and
+// those that arrive out of order
+class LocIpcOrder : public LocIpc {
+public:
+    volatile uint32_t mCount;
+    uint32_t mOutOfOrder;
+    inline LocIpcOrder() : mCount(0), mOutOfOrder(0) {}
+    void onReceiveData(const char data[], uint32_t length) override {
+        uint32_t seq = 0;
+        memcpy(&seq, data, (length < sizeof(seq)) ? length : sizeof(seq));
+        mOutOfOrder += (seq != mCount);
+        mCount = mCount + 1;
+    }
+};
+
+// stops listening upon its first msg
+class LocIpcStopper : public LocIpc {
+public:
+    volatile uint32_t mCount;
+    inline LocIpcStopper() : mCount(0) {}
+    void onReceiveData(const char /*data*/[], uint32_t /*length*/) override {
+        mCount = mCount + 1;
+        stopListening();
+    }
+};
+
+static uint32_t getThreadCount() {
+    uint32_t count = 0;
+    DIR* dir = opendir("/proc/self/task");
+    if (nullptr != dir) {
+        while (nullptr != readdir(dir)) {
+            count++;
+        }
+        closedir(dir);
+    }
+    // less . and ..
+    return count - 2;
+}
+
+static uint64_t getContextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+static uint64_t getCpuUs() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static uint64_t getNowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// checks failed, for the exit status
+static uint32_t sFailed = 0;
+
+// sends count msgs of size bytes to counter, with a LocIpc::send() each if
+// sender is nullptr, and returns the msgs per second
+static double benchmark(const char* name, LocIpcCounter& counter, LocIpcSender* sender,
+                        uint32_t count, uint32_t size) {
+    std::string data = LocIpcCounter::fill(size);
+    uint32_t base = counter.getCount();
+    uint64_t startNs = getNowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        if (nullptr == sender) {
+            LocIpc::send(name, data);
+        } else {
+            sender->send(data);
+        }
+    }
+    if (!counter.waitCount(base + count)) {
+        printf("ERROR: %u of %u msgs arrived\n", counter.getCount() - base, count);
+        sFailed++;
+    }
+    return count * 1e9 / (getNowNs() - startNs);
+}
+
+// sends count msgs of size bytes to counter one at a time, each once the one
+// before has arrived, and returns the mean send to onReceive() latency in us;
+// p99 gets the 99th percentile
+static double latency(LocIpcCounter& counter, LocIpcSender& sender,
+                      uint32_t count, uint32_t size, double& p99) {
+    std::string data = LocIpcCounter::fill(size);
+    std::vector<uint64_t> samples(count);
+    uint64_t totalNs = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t base = counter.getCount();
+        uint64_t startNs = getNowNs();
+        sender.send(data);
+        if (!counter.waitCount(base + 1)) {
+            printf("ERROR: msg %u of %u bytes did not arrive\n", i, size);
+            sFailed++;
+        }
+        samples[i] = getNowNs() - startNs;
+        totalNs += samples[i];
+    }
+    std::sort(samples.begin(), samples.end());
+    p99 = samples[count * 99 / 100] / 1e3;
+    return totalNs / 1e3 / count;
+}
+
+// The head of a stress test msg, which is followed by bytes that depend on
+// all of it, see stressByte(); so that a msg that is cut short, or has parts
+// of another in it, shows, as do msgs lost or out of order, by seq.
+struct LocIpcStressHead {
+    uint32_t sender;
+    uint32_t seq;
+    uint64_t sentNs;
+    uint32_t length;
+};
+
+static inline char stressByte(const LocIpcStressHead& head, uint32_t i) {
+    return (char)(head.sender * 131 + head.seq * 31 + head.length + i);
+}
+
+// takes the msgs of any number of stress senders, and checks them
+class LocIpcStress : public LocIpc {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    bool mReady;
+    // by sender, the seq expected next
+    std::vector<uint32_t> mNextSeqs;
+    // one way, in ns, of the msgs that arrived whole
+    std::vector<uint64_t> mLatencies;
+public:
+    uint32_t mCount;
+    uint32_t mCorrupt;
+    uint32_t mLost;
+    uint32_t mOutOfOrder;
+    uint64_t mBytes;
+    inline LocIpcStress() : mMutex(PTHREAD_MUTEX_INITIALIZER),
+            mCond(PTHREAD_COND_INITIALIZER), mReady(false), mCount(0), mCorrupt(0),
+            mLost(0), mOutOfOrder(0), mBytes(0) {}
+    void onListenerReady() override {
+        pthread_mutex_lock(&mMutex);
+        mReady = true;
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    void onReceiveData(const char data[], uint32_t length) override {
+        uint64_t nowNs = getNowNs();
+        LocIpcStressHead head;
+        bool corrupt = (length < sizeof(head));
+        if (!corrupt) {
+            memcpy(&head, data, sizeof(head));
+            corrupt = (head.length != length || head.sender >= mNextSeqs.size());
+        }
+        for (uint32_t i = sizeof(head); i < length && !corrupt; i++) {
+            corrupt = (data[i] != stressByte(head, i));
+        }
+        pthread_mutex_lock(&mMutex);
+        mCount++;
+        if (corrupt) {
+            mCorrupt++;
+        } else {
+            uint32_t& nextSeq = mNextSeqs[head.sender];
+            if (head.seq < nextSeq) {
+                mOutOfOrder++;
+            } else {
+                mLost += head.seq - nextSeq;
+                nextSeq = head.seq + 1;
+            }
+            mLatencies.push_back(nowNs - head.sentNs);
+            mBytes += length;
+        }
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    void waitReady() {
+        pthread_mutex_lock(&mMutex);
+        while (!mReady) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    void reset(uint32_t nSenders) {
+        pthread_mutex_lock(&mMutex);
+        mNextSeqs.assign(nSenders, 0);
+        mLatencies.clear();
+        mCount = mCorrupt = mLost = mOutOfOrder = 0;
+        mBytes = 0;
+        pthread_mutex_unlock(&mMutex);
+    }
+    // true if count msgs in all arrived, none later than a second after the one before
+    bool waitCount(uint32_t count) {
+        pthread_mutex_lock(&mMutex);
+        bool progress = true;
+        while (mCount < count && progress) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            uint32_t before = mCount;
+            while (mCount == before &&
+                   0 == pthread_cond_timedwait(&mCond, &mMutex, &deadline));
+            progress = (mCount != before);
+        }
+        bool arrived = (mCount >= count);
+        pthread_mutex_unlock(&mMutex);
+        return arrived;
+    }
+    // the latency, in us, under which fraction of the msgs arrived
+    double getLatencyUs(double fraction) {
+        if (mLatencies.empty()) {
+            return 0;
+        }
+        size_t i = (size_t)(fraction * mLatencies.size());
+        i = (i < mLatencies.size()) ? i : mLatencies.size() - 1;
+        std::nth_element(mLatencies.begin(), mLatencies.begin() + i, mLatencies.end());
+        return mLatencies[i] / 1e3;
+    }
+};
+
+struct LocIpcStressSender {
+    pthread_t thread;
+    const char* name;
+    uint32_t id;
+    uint32_t count;
+    uint32_t size;
+    uint32_t failed;
+    static void* run(void* arg) {
+        LocIpcStressSender* self = (LocIpcStressSender*)arg;
+        LocIpcSender sender(self->name);
+        std::vector<char> data(self->size);
+        LocIpcStressHead head = { self->id, 0, 0, self->size };
+        for (uint32_t i = sizeof(head); i < self->size; i++) {
+            data[i] = stressByte(head, i);
+        }
+        for (uint32_t seq = 0; seq < self->count; seq++) {
+            // only the bytes that depend on seq change from msg to msg
+            for (uint32_t i = sizeof(head); seq > 0 && i < self->size; i++) {
+                data[i] += 31;
+            }
+            head.seq = seq;
+            head.sentNs = getNowNs();
+            memcpy(data.data(), &head, sizeof(head));
+            self->failed += !sender.send((const uint8_t*)data.data(), self->size);
+        }
+        return nullptr;
+    }
+};
+
+// nSenders threads, each with a LocIpcSender of its own, send count msgs of
+// size bytes in all, as fast as they can, to stress; returns the msgs per
+// second, and prints what arrived and how
+static double stressTest(const char* name, LocIpcStress& stress, uint32_t nSenders,
+                         uint32_t count, uint32_t size) {
+    std::vector<LocIpcStressSender> senders(nSenders);
+    count = count / nSenders * nSenders;
+    stress.reset(nSenders);
+    uint64_t startNs = getNowNs();
+    for (uint32_t i = 0; i < nSenders; i++) {
+        senders[i].name = name;
+        senders[i].id = i;
+        senders[i].count = count / nSenders;
+        senders[i].size = size;
+        senders[i].failed = 0;
+        pthread_create(&senders[i].thread, nullptr, LocIpcStressSender::run, &senders[i]);
+    }
+    uint32_t failed = 0;
+    for (uint32_t i = 0; i < nSenders; i++) {
+        pthread_join(senders[i].thread, nullptr);
+        failed += senders[i].failed;
+    }
+    stress.waitCount(count);
+    double elapsedS = (getNowNs() - startNs) / 1e9;
+    bool ok = (stress.mCount == count && 0 == stress.mCorrupt && 0 == stress.mLost &&
+               0 == stress.mOutOfOrder && 0 == failed);
+    printf("%u senders, %u msgs of %u bytes: %.0f msgs/s %.1f MB/s, latency us p50 %.1f "
+           "p99 %.1f p999 %.1f; %u arrived, %u corrupt, %u lost, %u out of order, "
+           "%u failed to send%s\n", nSenders, count, size, stress.mCount / elapsedS,
+           stress.mBytes / elapsedS / 1e6, stress.getLatencyUs(0.5), stress.getLatencyUs(0.99),
+           stress.getLatencyUs(0.999), stress.mCount, stress.mCorrupt, stress.mLost,
+           stress.mOutOfOrder, failed, ok ? "" : " FAILED");
+    sFailed += !ok;
+    return stress.mCount / elapsedS;
+}
+
+// starts a LocIpcCounter listening on name, with a seqpacket socket for
+// messages of up to seqPacketLen bytes if not 0, taking rings if shmRing
+static LocIpcCounter* startCounter(const char* name, uint32_t seqPacketLen = 0,
+                                   bool shmRing = false) {
+    LocIpcCounter* counter = new LocIpcCounter();
+    if (0 != seqPacketLen) {
+        counter->setSeqPacket(seqPacketLen);
+    }
+    counter->setShmRing(shmRing);
+    counter->startListeningNonBlocking(name);
+    counter->waitReady();
+    return counter;
+}
+
+static void stopCounter(LocIpcCounter* counter) {
+    if (counter->getCorrupt() > 0) {
+        printf("ERROR: %u msgs arrived corrupt\n", counter->getCorrupt());
+        sFailed++;
+    }
+    counter->stopListening();
+    delete counter;
+}
+
+static void checkArrived(const char* what, bool arrived) {
+    printf("%s %s\n", what, arrived ? "arrived" : "FAILED");
+    sFailed += !arrived;
+}
+
+// LocIpc::send(), with a socket per msg, vs a LocIpcSender
+static void testSend(uint32_t count) {
+    const char* name = "/tmp/loc_ipc_bench";
+    uint32_t sizes[] = { 64, 1024, 65536 };
+    LocIpcCounter* counter = startCounter(name);
+    LocIpcSender sender(name);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t n = (sizes[i] > 8192) ? count / 100 : count;
+        double perCall = benchmark(name, *counter, nullptr, n, sizes[i]);
+        double connected = benchmark(name, *counter, &sender, n, sizes[i]);
+        printf("%u msgs of %u bytes: LocIpc::send() %.0f msgs/s, LocIpcSender %.0f msgs/s\n",
+               n, sizes[i], perCall, connected);
+    }
+    stopCounter(counter);
+}
+
+// datagram vs seqpacket, for messages from 1 KB, in one datagram,
+// up to 256 KB, in 33 datagrams or one seqpacket message
+static void testSeqPacket(uint32_t count) {
+    const char* name = "/tmp/loc_ipc_bench";
+    const char* seqName = "/tmp/loc_ipc_bench_seq";
+    uint32_t seqSizes[] = { 1024, 16384, 262144 };
+    LocIpcCounter* counter = startCounter(name);
+    LocIpcCounter* seqCounter = startCounter(seqName, 262144);
+    LocIpcSender sender(name);
+    LocIpcSender seqSender(seqName);
+    for (size_t i = 0; i < sizeof(seqSizes) / sizeof(seqSizes[0]); i++) {
+        uint32_t n = count / (1 + seqSizes[i] / 1024);
+        double dgram = benchmark(name, *counter, &sender, n, seqSizes[i]);
+        double seq = benchmark(seqName, *seqCounter, &seqSender, n, seqSizes[i]);
+        printf("%u msgs of %u bytes: datagram %.0f msgs/s %.1f MB/s, "
+               "seqpacket %.0f msgs/s %.1f MB/s\n", n, seqSizes[i],
+               dgram, dgram * seqSizes[i] / 1e6, seq, seq * seqSizes[i] / 1e6);
+        n = 1000;
+        double dgramP99 = 0, seqP99 = 0;
+        double dgramUs = latency(*counter, sender, n, seqSizes[i], dgramP99);
+        double seqUs = latency(*seqCounter, seqSender, n, seqSizes[i], seqP99);
+        printf("%u msgs of %u bytes, one at a time: datagram %.1f us (p99 %.1f), "
+               "seqpacket %.1f us (p99 %.1f)\n", n, seqSizes[i],
+               dgramUs, dgramP99, seqUs, seqP99);
+    }
+    // longer than the seqpacket listener takes, so dropped
+    seqSender.send(LocIpcCounter::fill(262145));
+    uint32_t base = seqCounter->getCount();
+    bool sent = LocIpc::send(seqName, LocIpcCounter::fill(16));
+    checkArrived("LocIpc::send() to seqpacket", sent && seqCounter->waitCount(base + 1));
+    stopCounter(seqCounter);
+    stopCounter(counter);
+}
+
+// datagram vs shared memory ring, in msgs/s and cpu time per msg of both
+// sides together, the ring offered upon the first send
+static void testRing(uint32_t count) {
+    const char* name = "/tmp/loc_ipc_bench";
+    const char* ringName = "/tmp/loc_ipc_bench_ring";
+    uint32_t ringSizes[] = { 64, 1024, 16384 };
+    LocIpcCounter* counter = startCounter(name);
+    LocIpcCounter* ringCounter = startCounter(ringName, 0, true);
+    LocIpcSender sender(name);
+    LocIpcSender ringSender(ringName);
+    ringSender.setShmRing(1 << 20);
+    ringSender.send(LocIpcCounter::fill(16));
+    ringCounter->waitCount(1);
+    for (size_t i = 0; i < sizeof(ringSizes) / sizeof(ringSizes[0]); i++) {
+        uint32_t n = (ringSizes[i] > 8192) ? count / 10 : count;
+        uint64_t cpuUs = getCpuUs();
+        double dgram = benchmark(name, *counter, &sender, n, ringSizes[i]);
+        double dgramCpuUs = (double)(getCpuUs() - cpuUs) / n;
+        cpuUs = getCpuUs();
+        double ring = benchmark(ringName, *ringCounter, &ringSender, n, ringSizes[i]);
+        double ringCpuUs = (double)(getCpuUs() - cpuUs) / n;
+        printf("%u msgs of %u bytes: datagram %.0f msgs/s %.2f cpu us/msg, "
+               "ring %.0f msgs/s %.2f cpu us/msg\n", n, ringSizes[i],
+               dgram, dgramCpuUs, ring, ringCpuUs);
+    }
+    // longer than the ring, so in parts
+    uint32_t base = ringCounter->getCount();
+    bool sent = ringSender.send(LocIpcCounter::fill(600000));
+    checkArrived("send longer than the ring", sent && ringCounter->waitCount(base + 1));
+    stopCounter(ringCounter);
+    stopCounter(counter);
+}
+
+// in order across the switch from datagrams to the ring, and around
+// msgs longer than half the ring, every 1000th; and to a listener that
+// does not take the ring, as datagrams all along
+static void testRingOrder(uint32_t count) {
+    const char* ringName = "/tmp/loc_ipc_bench_ring";
+    for (int take = 1; take >= 0; take--) {
+        LocIpcOrder* order = new LocIpcOrder();
+        order->setShmRing(take);
+        order->startListeningNonBlocking(ringName);
+        usleep(100000);
+        LocIpcSender orderSender(ringName);
+        orderSender.setShmRing(65536);
+        std::string longMsg(200000, 'x');
+        for (uint32_t seq = 0; seq < count; seq++) {
+            if (seq % 1000 == 999) {
+                memcpy(&longMsg[0], &seq, sizeof(seq));
+                orderSender.send(longMsg);
+            } else {
+                orderSender.send((const uint8_t*)&seq, sizeof(seq));
+            }
+        }
+        for (int ms = 0; order->mCount < count && ms < 1000; ms++) {
+            usleep(1000);
+        }
+        printf("%u of %u msgs arrived %s ring, %u out of order\n", order->mCount, count,
+               take ? "with" : "without", order->mOutOfOrder);
+        sFailed += (order->mCount != count || order->mOutOfOrder > 0);
+        order->stopListening();
+        delete order;
+    }
+}
+
+// 8 listeners with a thread each, vs all with one reactor; msgs go round
+// robin to them, a burst of 8 at a time to each
+static void testListeners(uint32_t count) {
+    const uint32_t nListeners = 8;
+    for (int useReactor = 0; useReactor < 2; useReactor++) {
+        uint32_t threads = getThreadCount();
+        LocIpcReactor* reactor = useReactor ? new LocIpcReactor() : nullptr;
+        LocIpcCounter* counters[nListeners];
+        LocIpcSender* senders[nListeners];
+        std::string names[nListeners];
+        for (uint32_t i = 0; i < nListeners; i++) {
+            names[i] = std::string("/tmp/loc_ipc_bench_") + std::to_string(i);
+            counters[i] = new LocIpcCounter();
+            if (useReactor) {
+                counters[i]->startListeningNonBlocking(names[i], *reactor);
+            } else {
+                counters[i]->startListeningNonBlocking(names[i]);
+            }
+            counters[i]->waitReady();
+            senders[i] = new LocIpcSender(names[i].c_str());
+        }
+        threads = getThreadCount() - threads;
+        std::string data = LocIpcCounter::fill(64);
+        uint32_t n = count / nListeners / 8 * 8;
+        uint64_t switches = getContextSwitches();
+        uint64_t cpuUs = getCpuUs();
+        uint64_t startNs = getNowNs();
+        for (uint32_t j = 0; j < n; j += 8) {
+            for (uint32_t i = 0; i < nListeners; i++) {
+                for (uint32_t k = 0; k < 8; k++) {
+                    senders[i]->send(data);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < nListeners; i++) {
+            if (!counters[i]->waitCount(n)) {
+                printf("ERROR: %u of %u msgs arrived\n", counters[i]->getCount(), n);
+                sFailed++;
+            }
+        }
+        uint64_t elapsedNs = getNowNs() - startNs;
+        printf("%u listeners %s: %u threads, %u msgs of 64 bytes %.0f msgs/s, "
+               "%.2f cpu us/msg, %.3f context switches/msg\n", nListeners,
+               useReactor ? "with a reactor" : "with a thread each", threads, n * nListeners,
+               n * nListeners * 1e9 / elapsedNs,
+               (double)(getCpuUs() - cpuUs) / (n * nListeners),
+               (double)(getContextSwitches() - switches) / (n * nListeners));
+        for (uint32_t i = 0; i < nListeners; i++) {
+            stopCounter(counters[i]);
+            delete senders[i];
+        }
+        delete reactor;
+    }
+}
+
+// bursts of 4 msgs of 64 bytes, a send() each vs one sendBatch(); then in
+// order, by sendBatch(), with a long msg in every 10th batch, to a listener
+// with a thread of its own, and to one with a reactor
+static void testBatch(uint32_t count) {
+    const char* name = "/tmp/loc_ipc_bench";
+    const char* orderName = "/tmp/loc_ipc_bench_ring";
+    LocIpcCounter* counter = startCounter(name);
+    LocIpcSender sender(name);
+    std::vector<std::string> burst(4, LocIpcCounter::fill(64));
+    for (int batch = 0; batch < 2; batch++) {
+        uint32_t n = count / 4 * 4;
+        uint32_t base = counter->getCount();
+        uint64_t cpuUs = getCpuUs();
+        uint64_t startNs = getNowNs();
+        for (uint32_t j = 0; j < n; j += 4) {
+            if (batch) {
+                sender.sendBatch(burst);
+            } else {
+                for (uint32_t k = 0; k < 4; k++) {
+                    sender.send(burst[k]);
+                }
+            }
+        }
+        if (!counter->waitCount(base + n)) {
+            printf("ERROR: %u of %u msgs arrived\n", counter->getCount() - base, n);
+            sFailed++;
+        }
+        printf("%u msgs of 64 bytes in bursts of 4, %s: %.0f msgs/s, %.2f cpu us/msg\n", n,
+               batch ? "sendBatch()" : "send() each", n * 1e9 / (getNowNs() - startNs),
+               (double)(getCpuUs() - cpuUs) / n);
+    }
+    stopCounter(counter);
+
+    for (int useReactor = 0; useReactor < 2; useReactor++) {
+        LocIpcOrder* order = new LocIpcOrder();
+        if (useReactor) {
+            order->startListeningNonBlocking(orderName, LocIpcReactor::getInstance());
+        } else {
+            order->startListeningNonBlocking(orderName);
+            usleep(100000);
+        }
+        LocIpcSender orderSender(orderName);
+        std::vector<std::string> msgs(8);
+        uint32_t seq = 0;
+        for (uint32_t j = 0; j < 10000; j++) {
+            for (uint32_t k = 0; k < msgs.size(); k++, seq++) {
+                msgs[k].assign((0 == j % 10 && 3 == k) ? 20000 : 16, 'x');
+                memcpy(&msgs[k][0], &seq, sizeof(seq));
+            }
+            orderSender.sendBatch(msgs);
+        }
+        for (int ms = 0; order->mCount < seq && ms < 1000; ms++) {
+            usleep(1000);
+        }
+        printf("%u of %u batched msgs arrived %s, %u out of order\n", order->mCount, seq,
+               useReactor ? "with a reactor" : "with a thread", order->mOutOfOrder);
+        sFailed += (order->mCount != seq || order->mOutOfOrder > 0);
+        order->stopListening();
+        delete order;
+    }
+}
+
+// stopping from onReceiveData(), with a reactor; no more msgs after
+static void testStop(uint32_t /*count*/) {
+    const char* name = "/tmp/loc_ipc_bench_stop";
+    LocIpcStopper* stopper = new LocIpcStopper();
+    stopper->startListeningNonBlocking(name, LocIpcReactor::getInstance());
+    LocIpcSender stopperSender(name);
+    stopperSender.send(LocIpcCounter::fill(16));
+    stopperSender.send(LocIpcCounter::fill(16));
+    usleep(100000);
+    printf("stop in onReceiveData(): %u msgs arrived, of 2\n", stopper->mCount);
+    sFailed += (1 != stopper->mCount);
+    delete stopper;
 }
+
+// the listener binds its socket anew, the sender must follow it; and
+// anew as seqpacket, the sender must switch over
+static void testRebind(uint32_t /*count*/) {
+    const char* name = "/tmp/loc_ipc_bench";
+    LocIpcCounter* counter = startCounter(name);
+    LocIpcSender sender(name);
+    bool sent = sender.send(LocIpcCounter::fill(16));
+    checkArrived("send before rebind", sent && counter->waitCount(1));
+    stopCounter(counter);
+
+    counter = startCounter(name);
+    sent = sender.send(LocIpcCounter::fill(16));
+    checkArrived("send after rebind", sent && counter->waitCount(1));
+    stopCounter(counter);
+
+    counter = startCounter(name, 65536);
+    sent = sender.send(LocIpcCounter::fill(65536));
+    checkArrived("send after rebind as seqpacket", sent && counter->waitCount(1));
+    stopCounter(counter);
+}
+
+// senders all at once, with msgs on either side of LOC_MSG_BUF_LEN, so
+// that the parts of long msgs from different senders come in mixed
+static uint32_t sStressSenders = 4;
+static void testStress(uint32_t count) {
+    const char* stressName = "/tmp/loc_ipc_bench_stress";
+    uint32_t stressSizes[] = { 64, 4096, 8192, 8193, 16384, 65536, 262144 };
+    for (int seqPacket = 0; seqPacket < 2; seqPacket++) {
+        printf("stress, %s:\n", seqPacket ? "seqpacket" : "datagram");
+        LocIpcStress* stress = new LocIpcStress();
+        if (seqPacket) {
+            stress->setSeqPacket(262144);
+        }
+        stress->startListeningNonBlocking(stressName);
+        stress->waitReady();
+        for (size_t i = 0; i < sizeof(stressSizes) / sizeof(stressSizes[0]); i++) {
+            uint32_t n = count / (1 + stressSizes[i] / 1024);
+            stressTest(stressName, *stress, sStressSenders, (n < 100) ? 100 : n,
+                       stressSizes[i]);
+        }
+        stress->stopListening();
+        delete stress;
+    }
+}
+
+static const struct {
+    const char* name;
+    void (*run)(uint32_t count);
+} sTests[] = {
+    { "send", testSend },
+    { "seqpacket", testSeqPacket },
+    { "ring", testRing },
+    { "ringorder", testRingOrder },
+    { "listeners", testListeners },
+    { "batch", testBatch },
+    { "stop", testStop },
+    { "rebind", testRebind },
+    { "stress", testStress },
+};
+
+// For Linux command line testing:
+// build: make check, for loc_ipc_test, linked with libgps_utils
+// run: ./loc_ipc_test [all|send|seqpacket|ring|ringorder|listeners|batch|stop|rebind|stress]
+//                     [number of msgs, 100000 by default]
+//                     [number of stress senders, 4 by default]
+// exits with 1 if any check failed
+int main(int argc, char** argv) {
+    const char* test = (argc > 1) ? argv[1] : "all";
+    uint32_t count = (argc > 2) ? atoi(argv[2]) : 100000;
+    if (argc > 3) {
+        sStressSenders = atoi(argv[3]);
+    }
+    bool found = false;
+    for (size_t i = 0; i < sizeof(sTests) / sizeof(sTests[0]); i++) {
+        if (0 == strcmp(test, "all") || 0 == strcmp(test, sTests[i].name)) {
+            printf("== %s\n", sTests[i].name);
+            sTests[i].run(count);
+            found = true;
+        }
+    }
+    if (!found) {
+        printf("no test %s\n", test);
+        return 2;
+    }
+    return (sFailed > 0) ? 1 : 0;
+}
+
+#endif
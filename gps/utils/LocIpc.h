@@ -31,7 +31,9 @@
 #define __LOC_SOCKET__
 
 #include <string>
-#include <memory>
+#include <map>
+#include <mutex>
+#include <vector>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -40,11 +42,16 @@
 namespace loc_util {
 
 class LocIpcSender;
+class LocIpcRing;
+class LocIpcReactor;
 
 class LocIpc {
 friend LocIpcSender;
+friend LocIpcRing;
+friend LocIpcReactor;
 public:
-    inline LocIpc() : mIpcFd(-1), mStopRequested(false), mRunnable(nullptr) {}
+    inline LocIpc() : mIpcFd(-1), mStopRequested(false), mSeqPacketLen(0),
+            mShmRing(false), mReactor(nullptr), mRunnable(nullptr) {}
     inline virtual ~LocIpc() { stopListening(); }
 
     // Listen for new messages in current thread. Calling this funciton will
@@ -62,9 +69,35 @@ public:
     // The function will return true on success, and false on failure.
     bool startListeningNonBlocking(const std::string& name);
 
+    // Listen for new messages on the thread of reactor, which it shares with
+    // all other LocIpc listening with it, rather than on a LocThread of its
+    // own. onReceive() is called on that thread, and so must not block for
+    // long. A datagram socket only: not with setSeqPacket(), and with no
+    // rings taken. The listening can be stopped by calling stopListening().
+    //
+    // Argument name is the path of the unix local socket to be be listened.
+    // The function will return true on success, and false on failure.
+    bool startListeningNonBlocking(const std::string& name, LocIpcReactor& reactor);
+
     // Stop listening to new messages.
     void stopListening();
 
+    // Listen on a SOCK_SEQPACKET socket instead of a datagram one, for
+    // messages of up to maxLength bytes, each of which then arrives whole,
+    // with one call on either side, instead of in parts of 8 KB. Longer
+    // messages are dropped. Senders need not know, LocIpcSender and send()
+    // find out what kind of socket they are sending to.
+    // Call this function before startListeningBlocking/NonBlocking().
+    inline void setSeqPacket(uint32_t maxLength) { mSeqPacketLen = maxLength; }
+
+    // Take the shared memory rings offered by LocIpcSenders, see
+    // LocIpcSender::setShmRing(), and receive their messages out of the
+    // rings rather than as datagrams; onReceiveData() then gets them in place,
+    // with no copy by the kernel. Listeners that do not take the rings
+    // leave their senders on datagrams, as do seqpacket listeners.
+    // Call this function before startListeningBlocking/NonBlocking().
+    inline void setShmRing(bool take) { mShmRing = take; }
+
     // Send out a message.
     // Call this function to send a message in argument data to socket in argument name.
     //
@@ -88,64 +121,158 @@ protected:
     // when the socket for LocIpc is ready to receive messages.
     inline virtual void onListenerReady() {}
 
+    // Same as onReceive(), but without copying the message out of the receive
+    // buffer, which is reused for the next message once this callback returns.
+    // data is not NUL terminated. The default implementation copies the message
+    // into a std::string, reused from message to message, for onReceive();
+    // override this one to receive messages without the copy.
+    inline virtual void onReceiveData(const char data[], uint32_t length) {
+        mMsg.assign(data, length);
+        onReceive(mMsg);
+    }
+
 private:
-    static bool sendData(int fd, const sockaddr_un& addr,
+    // addr is nullptr to send over fd connect()'ed already
+    static bool sendData(int fd, const sockaddr_un* addr,
             const uint8_t data[], uint32_t length);
+    int bindSocket(const std::string& name);
+    void receiveDatagrams();
+    int receiveDatagram(int flags, std::vector<LocIpcRing*>* rings);
+    int deliverDatagram(char* msg, size_t nBytes, const char* name, size_t nameLen,
+                        int ringFds[2], std::vector<LocIpcRing*>* rings);
+    void receiveSeqPackets();
 
     int mIpcFd;
     bool mStopRequested;
+    // 0 for a datagram socket, else the longest message on a seqpacket one
+    uint32_t mSeqPacketLen;
+    bool mShmRing;
+    // a long message being reassembled from its parts, in 8 byte words
+    struct LongMsg {
+        std::vector<uint64_t> buf;
+        size_t length;
+        size_t received;
+    };
+    // receive buffers, in the listening thread: one per datagram of a
+    // batch; the long messages under way, by the name of their senders,
+    // for parts of those of different senders may come mixed; and the
+    // buffer of the last long message, for the next to reuse
+    std::vector<uint64_t> mBatchBuf;
+    std::map<std::string, LongMsg> mLongMsgs;
+    std::vector<uint64_t> mBuf;
+    LocIpcReactor* mReactor;
+    // for the std::string onReceive(), in the listening thread
+    std::string mMsg;
     LocThread mThread;
     LocRunnable *mRunnable;
 };
 
+// One thread, for any number of LocIpc to listen on, each on its socket, with
+// epoll; see LocIpc::startListeningNonBlocking(name, reactor). A LocIpc may
+// stopListening() at any time, from its onReceive() too; once that returns,
+// no more onReceive() is under way or to come.
+class LocIpcReactor {
+friend LocIpc;
+friend class LocIpcReactorRunnable;
+public:
+    LocIpcReactor();
+    // LocIpc still listening with the reactor stop
+    ~LocIpcReactor();
+
+    // a reactor for the whole process to share, created upon the first call
+    static LocIpcReactor& getInstance();
+
+private:
+    bool add(LocIpc& ipc, const std::string& name);
+    void remove(LocIpc& ipc);
+    bool run();
+
+    int mEpollFd;
+    // an eventfd, to stop the thread
+    int mStopFd;
+    // by socket, the LocIpc listening on it and the socket's name
+    std::map<int, std::pair<LocIpc*, std::string>> mListeners;
+    // held while messages are delivered, so that a LocIpc that stops
+    // listening waits for its onReceive() to return
+    std::recursive_mutex mMutex;
+    LocThread mThread;
+};
+
 class LocIpcSender {
 public:
     // Constructor of LocIpcSender class
     //
     // Argument destSocket contains the full path name of destination socket.
     // This class hides generated fd and destination address object from user.
-    inline LocIpcSender(const char* destSocket):
-            LocIpcSender(std::make_shared<int>(::socket(AF_UNIX, SOCK_DGRAM, 0)), destSocket) {
-        if (-1 == *mSocket) {
-            mSocket = nullptr;
-        }
-    }
+    // The fd is connect()'ed to the destination socket on the first send, and
+    // stays connected for the lifetime of the object, so that each message
+    // costs neither an fd nor an address lookup. If the destination goes away
+    // or binds its socket anew, the next send reconnects. A destination that
+    // listens on a seqpacket socket, see LocIpc::setSeqPacket(), gets each
+    // message whole, in one send.
+    LocIpcSender(const char* destSocket);
 
     // Replicate a new LocIpcSender object with new destination socket.
     inline LocIpcSender* replicate(const char* destSocket) {
-        return (nullptr == mSocket) ? nullptr : new LocIpcSender(mSocket, destSocket);
-    }
-
-    inline ~LocIpcSender() {
-        if (nullptr != mSocket && mSocket.unique()) {
-            ::close(*mSocket);
+        LocIpcSender* sender = new LocIpcSender(destSocket);
+        if (-1 == sender->mSocket) {
+            delete sender;
+            sender = nullptr;
         }
+        return sender;
     }
 
+    ~LocIpcSender();
+
     // Send out a message.
     // Call this function to send a message
     //
     // Argument data and length contains the message to be sent out.
     // Return true when succeeded
-    inline bool send(const uint8_t data[], uint32_t length) {
-        bool rtv = false;
-        if (nullptr != mSocket && nullptr != data) {
-            rtv = LocIpc::sendData(*mSocket, mDestAddr, data, length);
-        }
-        return rtv;
+    bool send(const uint8_t data[], uint32_t length);
+    inline bool send(const std::string& data) {
+        return send((const uint8_t*)data.c_str(), data.length());
     }
 
+    // Send out messages, in order, with as few calls as can be: a burst of
+    // short messages takes one sendmmsg() per 16. Messages to a ring, and
+    // those too long for one datagram, go out one at a time.
+    // Return true when all succeeded
+    bool sendBatch(const std::string data[], size_t count);
+    inline bool sendBatch(const std::vector<std::string>& data) {
+        return sendBatch(data.data(), data.size());
+    }
+
+    // Offer the destination a shared memory ring of size bytes, rounded up
+    // to a power of 2, upon connecting to it. Once the destination takes the
+    // ring, see LocIpc::setShmRing(), messages go through it, those longer
+    // than half its size in parts, with an eventfd to wake the destination
+    // only when it sleeps; until then, or if it never does, they go as
+    // datagrams.
+    // 0, the default, offers no ring.
+    void setShmRing(uint32_t size);
+
 private:
-    std::shared_ptr<int> mSocket;
-    struct sockaddr_un mDestAddr;
+    bool sendOne(const uint8_t data[], uint32_t length);
+    bool connectSocket(int type);
+    bool sendPacket(const uint8_t data[], uint32_t length);
+    void startRing();
+    bool sendToRing(const uint8_t data[], uint32_t length);
+    void stopRing();
 
-    inline LocIpcSender(
-            const std::shared_ptr<int>& mySocket, const char* destSocket) : mSocket(mySocket) {
-        if ((nullptr != mSocket) && (-1 != *mSocket) && (nullptr != destSocket)) {
-            mDestAddr.sun_family = AF_UNIX;
-            snprintf(mDestAddr.sun_path, sizeof(mDestAddr.sun_path), "%s", destSocket);
-        }
-    }
+    int mSocket;
+    // SOCK_DGRAM or SOCK_SEQPACKET, whichever the destination is
+    int mType;
+    bool mConnected;
+    struct sockaddr_un mDestAddr;
+    uint32_t mRingSize;
+    // offered to the destination mRingStartNs ago, in use once mRingOn
+    LocIpcRing* mRing;
+    bool mRingOn;
+    uint64_t mRingStartNs;
+    // keeps the fragments of long messages from interleaving, and
+    // reconnects from racing with sends
+    std::mutex mMutex;
 };
 
 }
@@ -30,11 +30,15 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include <errno.h>
 #include <sys/timerfd.h>
 #include <sys/epoll.h>
+#include <vector>
+#include <algorithm>
 #include <log_util.h>
+#include <loc_cfg.h>
 #include <loc_timer.h>
 #include <LocTimer.h>
 #include <LocHeap.h>
@@ -49,8 +53,9 @@
 #endif
 
 /*
-There are implementations of 5 classes in this file:
-LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerPollTask, LocTimerWrapper
+There are implementations of 6 classes in this file:
+LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerWheel, LocTimerPollTask,
+LocTimerWrapper
 
 LocTimer - client front end, interface for client to start / stop timers, also
            to provide a callback.
@@ -58,7 +63,11 @@ LocTimerDelegate - an internal timer entity, which also is a LocRankable obj.
                    Its life cycle is different than that of LocTimer. It gets
                    created when LocTimer::start() is called, and gets deleted
                    when it expires or clients calls the hosting LocTimer obj's
-                   stop() method. When a LocTimerDelegate obj is ticking, it
+                   stop() method. A timer started with slack has a window from
+                   its earliest to its latest expiry, and the container places
+                   it by the latter. A periodic timer stays in the container
+                   across its expiries, moving on to its next deadline each
+                   time. When a LocTimerDelegate obj is ticking, it
                    stays in the corresponding LocTimerContainer. When expired
                    or stopped, the obj is removed from the container. Since it
                    is also a LocRankable obj, and LocTimerContainer also is a
@@ -67,11 +76,20 @@ LocTimerDelegate - an internal timer entity, which also is a LocRankable obj.
 LocTimerContainer - core of the timer service. It is a container (derived from
                     LocHeap) for LocTimerDelegate (implements LocRankable) objs.
                     There are 2 of such containers, one for sw timers (or Linux
-                    timers) one for hw timers (or Linux alarms). It adds one of
+                    timers) one for hw timers (or Linux alarms), and 2 more of
+                    them for the timers that opt into direct dispatch. It adds one of
                     each (those that expire the soonest) to kernel via services
-                    provided by LocTimerPollTask. All the heap management on the
+                    provided by LocTimerPollTask. On expiry, the timers whose
+                    windows have opened expire along with it, on the same wakeup.
+                    All the heap management on the
                     LocTimerDelegate objs are done in the MsgTask context, such
-                    that synchronization is ensured.
+                    that synchronization is ensured. A direct container does it
+                    under a mutex instead, and expires its timers right in the
+                    poll thread, which saves the hop through the MsgTask.
+LocTimerWheel - a hierarchical timing wheel that a LocTimerContainer uses in
+                place of its heap when TIMER_WHEEL is set in gps.conf. Timers
+                are hashed into slots of 1 ms ticks, so add and remove are O(1),
+                and the kernel timer only follows the nearest occupied slot.
 LocTimerPollTask - is a class that wraps timerfd and epoll POXIS APIs. It also
                    both implements LocRunnalbe with epoll_wait() in the run()
                    method. It is also a LocThread client, so as to loop the run
@@ -82,13 +100,14 @@ LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
 */
 
 class LocTimerPollTask;
+class LocTimerWheel;
 
 // This is a multi-functaional class that:
 // * extends the LocHeap class for the detection of head update upon add / remove
 //   events. When that happens, soonest time out changes, so timerfd needs update.
 // * contains the timers, and add / remove them into the heap
 // * provides and maps 2 of such containers, one for timers (or  mSwTimers), one
-//   for alarms (or mHwTimers);
+//   for alarms (or mHwTimers); and 2 more for those dispatched directly;
 // * provides a polling thread;
 // * provides a MsgTask thread for synchronized add / remove / timer client callback.
 class LocTimerContainer : public LocHeap {
@@ -98,26 +117,54 @@ class LocTimerContainer : public LocHeap {
     static LocTimerContainer* mSwTimers;
     // Container of alarms
     static LocTimerContainer* mHwTimers;
+    // Containers of timers / alarms dispatched directly
+    static LocTimerContainer* mSwDirectTimers;
+    static LocTimerContainer* mHwDirectTimers;
     // Msg task to provider msg Q, sender and reader.
     static MsgTask* mMsgTask;
     // Poll task to provide epoll call and threading to poll.
     static LocTimerPollTask* mPollTask;
     // timer / alarm fd
     int mDevFd;
+    // true if timers are managed under mDirectMutex and expired in the
+    // poll thread, rather than in the MsgTask context
+    const bool mDirect;
+    pthread_mutex_t mDirectMutex;
+    // -1 until read from TIMER_WHEEL in gps.conf
+    static int mUseWheel;
+    // replaces the heap, if TIMER_WHEEL is set
+    LocTimerWheel* mWheel;
+    // wheel tick the timer fd is armed for
+    uint64_t mArmedTick;
+    // number of timerfd_settime() calls, for benchmarking
+    uint32_t mSetTimeCount;
+    // wakeups saved by expiring timers of different ticks together
+    uint32_t mWakeupsSaved;
     // ctor
-    LocTimerContainer(bool wakeOnExpire);
+    LocTimerContainer(bool wakeOnExpire, bool direct);
     // dtor
     ~LocTimerContainer();
     static MsgTask* getMsgTaskLocked();
     static LocTimerPollTask* getPollTaskLocked();
-    // extend LocHeap and pop if the top outRanks input
-    LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
+    // extend LocHeap and pop if the window of the top has opened by now
+    LocTimerDelegate* popIfOpen(LocTimerDelegate& timerOfNow);
+    // counts the ticks, less the one that woke us up, of the timers expired
+    void countWakeupsSaved(std::vector<uint64_t>& ticks);
     // update the timer POSIX calls with updated soonest timer spec
     void updateSoonestTime(LocTimerDelegate* priorTop);
+    // update the timer POSIX calls with the nearest occupied wheel slot
+    void updateWheelTime();
+    void setTime(const struct itimerspec& delay);
+    // heap / wheel management, in the MsgTask context, or with
+    // mDirectMutex held for a direct container
+    void addTimer(LocTimerDelegate& timer);
+    void removeTimer(LocTimerDelegate& timer);
+    void expireTimers(std::vector<LocTimerDelegate*>& expired);
 
 public:
-    // factory method to control the creation of mSwTimers / mHwTimers
-    static LocTimerContainer* get(bool wakeOnExpire);
+    // factory method to control the creation of mSwTimers / mHwTimers,
+    // and their direct counterparts
+    static LocTimerContainer* get(bool wakeOnExpire, bool direct = false);
 
     LocTimerDelegate* getSoonestTimer();
     int getTimerFd();
@@ -127,6 +174,11 @@ public:
     void remove(LocTimerDelegate& timer);
     // handling of timer / alarm expiration
     void expire();
+    static uint32_t getWakeupsSaved(bool wakeOnExpire);
+#ifdef __LOC_DEBUG__
+    static inline void setUseWheel(bool useWheel) { mUseWheel = useWheel; }
+    inline uint32_t getSetTimeCount() { return mSetTimeCount; }
+#endif
 };
 
 // This class implements the polling thread that epolls imer / alarm fds.
@@ -178,19 +230,117 @@ class LocTimerDelegate : public LocRankable {
     friend class LocTimer;
     LocTimer* mClient;
     LocSharedLock* mLock;
+    // latest expiry, by which the container ranks the timer
     struct timespec mFutureTime;
+    // earliest expiry, the same as mFutureTime if started without slack
+    struct timespec mEarliestTime;
     LocTimerContainer* mContainer;
+    // MsgTask to call back the client in, if direct; NULL for the poll thread
+    MsgTask* mDispatchTask;
+    // true once a direct container has taken the timer out for expiry,
+    // until its dispatch is done
+    bool mExpiring;
+    // period in ns, 0 for a one shot timer
+    uint64_t mPeriodNs;
+    // expiries of a periodic timer missed since its last callback
+    uint32_t mOverruns;
+    // wheel slot links, mWheelPrev is NULL when not in a wheel
+    friend class LocTimerWheel;
+    LocTimerDelegate* mWheelNext;
+    LocTimerDelegate** mWheelPrev;
+    uint32_t mWheelSlot;
     // not a complete obj, just ctor for LocRankable comparisons
     inline LocTimerDelegate(struct timespec& delay)
-        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL) {}
+        : mClient(NULL), mLock(NULL), mFutureTime(delay), mEarliestTime(delay),
+          mContainer(NULL), mDispatchTask(NULL), mExpiring(false),
+          mPeriodNs(0), mOverruns(0),
+          mWheelNext(NULL), mWheelPrev(NULL), mWheelSlot(0) {}
     inline ~LocTimerDelegate() { if (mLock) { mLock->drop(); mLock = NULL; } }
 public:
-    LocTimerDelegate(LocTimer& client, struct timespec& futureTime, LocTimerContainer* container);
+    LocTimerDelegate(LocTimer& client, struct timespec& earliestTime,
+                     struct timespec& futureTime, LocTimerContainer* container,
+                     uint64_t periodNs = 0);
     void destroyLocked();
     // LocRankable virtual method
     virtual int ranks(LocRankable& rankable);
     void expire();
+    // direct dispatch of the expiry, to mDispatchTask or right here
+    void dispatch();
+    // expire() of a timer taken out of a direct container; also deletes it,
+    // unless it is periodic and still running
+    void expireDirect(bool callBack);
+    // moves a periodic timer on to its first deadline after nowNs, counting
+    // the deadlines it skips as overruns
+    void advancePeriod(uint64_t nowNs);
+    static inline uint64_t toNs(const struct timespec& time) {
+        return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+    }
     inline struct timespec getFutureTime() { return mFutureTime; }
+    // true if the window of this timer has opened by timerOfNow
+    inline bool isOpen(LocTimerDelegate& timerOfNow) {
+        return mEarliestTime.tv_sec < timerOfNow.mFutureTime.tv_sec ||
+               (mEarliestTime.tv_sec == timerOfNow.mFutureTime.tv_sec &&
+                mEarliestTime.tv_nsec <= timerOfNow.mFutureTime.tv_nsec);
+    }
+    // the 1 ms ticks of mFutureTime and mEarliestTime, rounded up so as not
+    // to expire early
+    static inline uint64_t getTick(const struct timespec& time) {
+        return (uint64_t)time.tv_sec * 1000 + (time.tv_nsec + 999999) / 1000000;
+    }
+    inline uint64_t getFutureTick() { return getTick(mFutureTime); }
+    inline uint64_t getEarliestTick() { return getTick(mEarliestTime); }
+};
+
+// Hierarchical timing wheel, after the classic kernel timer wheel. Level 0
+// has a slot per 1 ms tick for the next 256 ticks; each level above has 64
+// slots, each covering a whole turn of the level below, for 2^32 ticks in
+// all. A timer is hashed into the lowest level that covers its expiry, and
+// when the wheel enters the span of a higher level slot, that slot cascades
+// its timers down. Occupancy bitmaps find the next occupied slot, both to
+// skip empty ticks and to tell when the kernel timer needs to fire next.
+// All methods are to be called in the MsgTask context.
+#define LOC_TIMER_WHEEL_LEVELS     5
+#define LOC_TIMER_WHEEL_L0_BITS    8
+#define LOC_TIMER_WHEEL_LN_BITS    6
+#define LOC_TIMER_WHEEL_SLOTS      ((1 << LOC_TIMER_WHEEL_L0_BITS) + \
+                                    (LOC_TIMER_WHEEL_LEVELS - 1) * (1 << LOC_TIMER_WHEEL_LN_BITS))
+#define LOC_TIMER_WHEEL_NONE       UINT64_MAX
+
+class LocTimerWheel {
+    // next tick to process
+    uint64_t mBase;
+    uint32_t mCount;
+    // the largest slack of the timers added so far, in ticks
+    uint64_t mMaxSlack;
+    LocTimerDelegate* mSlots[LOC_TIMER_WHEEL_SLOTS];
+    uint64_t mOccupied[LOC_TIMER_WHEEL_SLOTS / 64];
+
+    static inline uint32_t getShift(uint32_t level) {
+        return level ? LOC_TIMER_WHEEL_L0_BITS + (level - 1) * LOC_TIMER_WHEEL_LN_BITS : 0;
+    }
+    static inline uint32_t getSize(uint32_t level) {
+        return level ? (1 << LOC_TIMER_WHEEL_LN_BITS) : (1 << LOC_TIMER_WHEEL_L0_BITS);
+    }
+    static inline uint32_t getOffset(uint32_t level) {
+        return level ? (1 << LOC_TIMER_WHEEL_L0_BITS) +
+                (level - 1) * (1 << LOC_TIMER_WHEEL_LN_BITS) : 0;
+    }
+    void link(LocTimerDelegate& timer);
+    void unlink(LocTimerDelegate& timer);
+    uint32_t cascade(uint32_t level);
+    uint32_t getDistance(uint32_t level, uint32_t from);
+public:
+    LocTimerWheel(uint64_t nowTick);
+    static uint64_t getNowTick();
+    void add(LocTimerDelegate& timer, uint64_t nowTick);
+    // returns false if the timer is not in the wheel, e.g. it has expired
+    bool remove(LocTimerDelegate& timer);
+    // takes the timers due by nowTick out of the wheel, and returns them
+    // chained by mWheelNext in the order of their expiry, followed by those
+    // in the level 0 slots ahead whose windows have opened by nowTick
+    LocTimerDelegate* advance(uint64_t nowTick);
+    // the tick the wheel next needs to advance to, LOC_TIMER_WHEEL_NONE if empty
+    uint64_t getNextTick();
 };
 
 /***************************LocTimerContainer methods***************************/
@@ -203,14 +353,18 @@ public:
 pthread_mutex_t LocTimerContainer::mMutex = PTHREAD_MUTEX_INITIALIZER;
 LocTimerContainer* LocTimerContainer::mSwTimers = NULL;
 LocTimerContainer* LocTimerContainer::mHwTimers = NULL;
+LocTimerContainer* LocTimerContainer::mSwDirectTimers = NULL;
+LocTimerContainer* LocTimerContainer::mHwDirectTimers = NULL;
 MsgTask* LocTimerContainer::mMsgTask = NULL;
 LocTimerPollTask* LocTimerContainer::mPollTask = NULL;
+int LocTimerContainer::mUseWheel = -1;
 
 // ctor - initialize timer heaps
 // A container for swTimer (timer) is created, when wakeOnExpire is true; or
 // HwTimer (alarm), when wakeOnExpire is false.
-LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
-    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)) {
+LocTimerContainer::LocTimerContainer(bool wakeOnExpire, bool direct) :
+    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)),
+    mDirect(direct), mDirectMutex(PTHREAD_MUTEX_INITIALIZER), mWheel(NULL), mArmedTick(LOC_TIMER_WHEEL_NONE), mSetTimeCount(0), mWakeupsSaved(0) {
 
     if ((-1 == mDevFd) && (errno == EINVAL)) {
         LOC_LOGW("%s: timerfd_create failure, fallback to CLOCK_MONOTONIC - %s",
@@ -222,6 +376,19 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
         // ensure we have the necessary resources created
         LocTimerContainer::getPollTaskLocked();
         LocTimerContainer::getMsgTaskLocked();
+
+        if (-1 == mUseWheel) {
+            uint32_t timerWheel = 0;
+            const loc_param_s_type gps_conf_param_table[] =
+            {
+                {"TIMER_WHEEL", &timerWheel, NULL, 'n'},
+            };
+            UTIL_READ_CONF(LOC_PATH_GPS_CONF, gps_conf_param_table);
+            mUseWheel = (0 != timerWheel);
+        }
+        if (mUseWheel) {
+            mWheel = new LocTimerWheel(LocTimerWheel::getNowTick());
+        }
     } else {
         LOC_LOGE("%s: timerfd_create failure - %s", __FUNCTION__, strerror(errno));
     }
@@ -231,18 +398,22 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
 // we do not ever destroy the static resources.
 inline
 LocTimerContainer::~LocTimerContainer() {
+    pthread_mutex_destroy(&mDirectMutex);
+    delete mWheel;
     close(mDevFd);
 }
 
-LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
+LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire, bool direct) {
     // get the reference of either mHwTimer or mSwTimers per wakeOnExpire
-    LocTimerContainer*& container = wakeOnExpire ? mHwTimers : mSwTimers;
+    LocTimerContainer*& container = direct ?
+            (wakeOnExpire ? mHwDirectTimers : mSwDirectTimers) :
+            (wakeOnExpire ? mHwTimers : mSwTimers);
     // it is cheap to check pointer first than locking mutext unconditionally
     if (!container) {
         pthread_mutex_lock(&mMutex);
         // let's check one more time to be safe
         if (!container) {
-            container = new LocTimerContainer(wakeOnExpire);
+            container = new LocTimerContainer(wakeOnExpire, direct);
             // timerfd_create failure
             if (-1 == container->getTimerFd()) {
                 delete container;
@@ -303,31 +474,162 @@ void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
             toSetTime = true;
         }
         if (toSetTime) {
-            timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+            setTime(delay);
+        }
+    }
+}
+
+void LocTimerContainer::updateWheelTime() {
+    uint64_t nextTick = mWheel->getNextTick();
+
+    // the kernel timer only changes with the nearest occupied slot
+    if (nextTick != mArmedTick) {
+        struct itimerspec delay;
+        memset(&delay, 0, sizeof(struct itimerspec));
+        if (LOC_TIMER_WHEEL_NONE == nextTick) {
+            // the wheel is empty now, we remove poll and disarm timer
+            mPollTask->removePoll(*this);
+        } else {
+            if (LOC_TIMER_WHEEL_NONE == mArmedTick) {
+                mPollTask->addPoll(*this);
+            }
+            delay.it_value.tv_sec = nextTick / 1000;
+            delay.it_value.tv_nsec = (nextTick % 1000) * 1000000;
+        }
+        setTime(delay);
+        mArmedTick = nextTick;
+    }
+}
+
+inline
+void LocTimerContainer::setTime(const struct itimerspec& delay) {
+    mSetTimeCount++;
+    timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+}
+
+// all the heap management is done in the MsgTask context, or for a direct
+// container, in the caller's context with mDirectMutex held.
+void LocTimerContainer::addTimer(LocTimerDelegate& timer) {
+    if (mWheel) {
+        mWheel->add(timer, LocTimerWheel::getNowTick());
+        updateWheelTime();
+        return;
+    }
+    LocTimerDelegate* priorTop = getSoonestTimer();
+    push((LocRankable&)timer);
+    updateSoonestTime(priorTop);
+}
+
+void LocTimerContainer::removeTimer(LocTimerDelegate& timer) {
+    if (mWheel) {
+        if (mWheel->remove(timer)) {
+            updateWheelTime();
+        }
+    } else {
+        LocTimerDelegate* priorTop = getSoonestTimer();
+
+        // update soonest timer only if timer is actually removed from
+        // the heap AND timer is not priorTop.
+        if (priorTop == LocHeap::remove((LocRankable&)timer)) {
+            // if passing in NULL, we tell updateSoonestTime to update
+            // kernel with the current top timer interval.
+            updateSoonestTime(NULL);
         }
     }
+    // all timers are deleted here, and only here; except those of a
+    // direct container already taken out for expiry, which the poll
+    // thread deletes once done with them.
+    if (!__atomic_load_n(&timer.mExpiring, __ATOMIC_ACQUIRE)) {
+        delete &timer;
+    }
+}
+
+// Upon expire, we check and continuously pop the heap until the top
+// node's window is in the future, and hand the popped timers back in
+// the order of their expiry.
+void LocTimerContainer::expireTimers(std::vector<LocTimerDelegate*>& expired) {
+    std::vector<uint64_t> ticks;
+    if (mWheel) {
+        LocTimerDelegate* timer = mWheel->advance(LocTimerWheel::getNowTick());
+        while (NULL != timer) {
+            LocTimerDelegate* next = timer->mWheelNext;
+            timer->mWheelNext = NULL;
+            expired.push_back(timer);
+            timer = next;
+        }
+    } else {
+        struct timespec now;
+        // get time spec of now
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        LocTimerDelegate timerOfNow(now);
+        // pop everything in the heap whose window has opened by now, i.e. has
+        // earliest time older than now. Like hrtimer, this stops at the first
+        // timer yet to open, in the order of the latest times.
+        for (LocTimerDelegate* timer = (LocTimerDelegate*)pop();
+             NULL != timer;
+             timer = popIfOpen(timerOfNow)) {
+            expired.push_back(timer);
+        }
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    size_t dispatched = 0;
+    for (size_t i = 0; i < expired.size(); i++) {
+        LocTimerDelegate* timer = expired[i];
+        ticks.push_back(timer->getEarliestTick());
+        // a periodic timer may expire again while its last dispatch to
+        // another MsgTask is yet to be done; that expiry is an overrun
+        bool inFlight = mDirect &&
+                __atomic_exchange_n(&timer->mExpiring, true, __ATOMIC_ACQ_REL);
+        if (0 != timer->mPeriodNs) {
+            if (inFlight) {
+                __atomic_add_fetch(&timer->mOverruns, 1, __ATOMIC_RELAXED);
+            }
+            // back in for its next deadline, without leaving the container
+            timer->advancePeriod(LocTimerDelegate::toNs(now));
+            if (mWheel) {
+                mWheel->add(*timer, LocTimerWheel::getNowTick());
+            } else {
+                push((LocRankable&)*timer);
+            }
+        }
+        if (!inFlight) {
+            expired[dispatched++] = timer;
+        }
+    }
+    expired.resize(dispatched);
+    countWakeupsSaved(ticks);
+
+    if (mWheel) {
+        // expire() below has disarmed the timer fd
+        mArmedTick = LOC_TIMER_WHEEL_NONE;
+        updateWheelTime();
+    } else {
+        updateSoonestTime(NULL);
+    }
 }
 
-// all the heap management is done in the MsgTask context.
 inline
 void LocTimerContainer::add(LocTimerDelegate& timer) {
     struct MsgTimerPush : public LocMsg {
         LocTimerContainer* mTimerContainer;
-        LocHeapNode* mTree;
         LocTimerDelegate* mTimer;
         inline MsgTimerPush(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
         inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-            mTimerContainer->push((LocRankable&)(*mTimer));
-            mTimerContainer->updateSoonestTime(priorTop);
+            mTimerContainer->addTimer(*mTimer);
         }
     };
 
-    mMsgTask->sendMsg(new MsgTimerPush(*this, timer));
+    if (mDirect) {
+        pthread_mutex_lock(&mDirectMutex);
+        addTimer(timer);
+        pthread_mutex_unlock(&mDirectMutex);
+    } else {
+        mMsgTask->sendMsg(new MsgTimerPush(*this, timer));
+    }
 }
 
-// all the heap management is done in the MsgTask context.
 void LocTimerContainer::remove(LocTimerDelegate& timer) {
     struct MsgTimerRemove : public LocMsg {
         LocTimerContainer* mTimerContainer;
@@ -335,70 +637,308 @@ void LocTimerContainer::remove(LocTimerDelegate& timer) {
         inline MsgTimerRemove(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
         inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-
-            // update soonest timer only if mTimer is actually removed from
-            // mTimerContainer AND mTimer is not priorTop.
-            if (priorTop == ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer)) {
-                // if passing in NULL, we tell updateSoonestTime to update
-                // kernel with the current top timer interval.
-                mTimerContainer->updateSoonestTime(NULL);
-            }
-            // all timers are deleted here, and only here.
-            delete mTimer;
+            mTimerContainer->removeTimer(*mTimer);
         }
     };
 
-    mMsgTask->sendMsg(new MsgTimerRemove(*this, timer));
+    if (mDirect) {
+        pthread_mutex_lock(&mDirectMutex);
+        removeTimer(timer);
+        pthread_mutex_unlock(&mDirectMutex);
+    } else {
+        mMsgTask->sendMsg(new MsgTimerRemove(*this, timer));
+    }
 }
 
-// all the heap management is done in the MsgTask context.
-// Upon expire, we check and continuously pop the heap until
-// the top node's timeout is in the future.
+// Called in the poll thread context. A direct container expires its timers
+// right here and dispatches their callbacks; the others go through MsgTask.
 void LocTimerContainer::expire() {
     struct MsgTimerExpire : public LocMsg {
         LocTimerContainer* mTimerContainer;
         inline MsgTimerExpire(LocTimerContainer& container) :
             LocMsg(), mTimerContainer(&container) {}
         inline virtual void proc() const {
-            struct timespec now;
-            // get time spec of now
-            clock_gettime(CLOCK_BOOTTIME, &now);
-            LocTimerDelegate timerOfNow(now);
-            // pop everything in the heap that outRanks now, i.e. has time older than now
-            // and then call expire() on that timer.
-            for (LocTimerDelegate* timer = (LocTimerDelegate*)mTimerContainer->pop();
-                 NULL != timer;
-                 timer = mTimerContainer->popIfOutRanks(timerOfNow)) {
-                // the timer delegate obj will be deleted before the return of this call
-                timer->expire();
+            std::vector<LocTimerDelegate*> expired;
+            mTimerContainer->expireTimers(expired);
+            for (size_t i = 0; i < expired.size(); i++) {
+                // expire() only queues the removal, so the timer delegate obj
+                // will be deleted after the return of this call
+                expired[i]->expire();
             }
-            mTimerContainer->updateSoonestTime(NULL);
         }
     };
 
+    if (mDirect) {
+        pthread_mutex_lock(&mDirectMutex);
+    }
     struct itimerspec delay;
     memset(&delay, 0, sizeof(struct itimerspec));
     timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
     mPollTask->removePoll(*this);
-    mMsgTask->sendMsg(new MsgTimerExpire(*this));
+
+    if (mDirect) {
+        std::vector<LocTimerDelegate*> expired;
+        expireTimers(expired);
+        pthread_mutex_unlock(&mDirectMutex);
+        for (size_t i = 0; i < expired.size(); i++) {
+            expired[i]->dispatch();
+        }
+    } else {
+        mMsgTask->sendMsg(new MsgTimerExpire(*this));
+    }
 }
 
-LocTimerDelegate* LocTimerContainer::popIfOutRanks(LocTimerDelegate& timer) {
+LocTimerDelegate* LocTimerContainer::popIfOpen(LocTimerDelegate& timerOfNow) {
     LocTimerDelegate* poppedNode = NULL;
-    if (mTree && !timer.outRanks(*peek())) {
+    LocTimerDelegate* top = getSoonestTimer();
+    if (top && top->isOpen(timerOfNow)) {
         poppedNode = (LocTimerDelegate*)(pop());
     }
 
     return poppedNode;
 }
 
+// Without slack, each of the distinct ticks would have taken a wakeup of its own.
+void LocTimerContainer::countWakeupsSaved(std::vector<uint64_t>& ticks) {
+    if (ticks.size() > 1) {
+        std::sort(ticks.begin(), ticks.end());
+        uint32_t distinct = std::unique(ticks.begin(), ticks.end()) - ticks.begin();
+        __atomic_add_fetch(&mWakeupsSaved, distinct - 1, __ATOMIC_RELAXED);
+    }
+}
+
+uint32_t LocTimerContainer::getWakeupsSaved(bool wakeOnExpire) {
+    // no need to create the containers just to find out they saved nothing
+    LocTimerContainer* containers[] = {
+        wakeOnExpire ? mHwTimers : mSwTimers,
+        wakeOnExpire ? mHwDirectTimers : mSwDirectTimers
+    };
+    uint32_t wakeupsSaved = 0;
+    for (size_t i = 0; i < sizeof(containers) / sizeof(containers[0]); i++) {
+        if (NULL != containers[i]) {
+            wakeupsSaved += __atomic_load_n(&containers[i]->mWakeupsSaved, __ATOMIC_RELAXED);
+        }
+    }
+    return wakeupsSaved;
+}
+
+
+/***************************LocTimerWheel methods***************************/
+
+LocTimerWheel::LocTimerWheel(uint64_t nowTick) :
+    mBase(nowTick), mCount(0), mMaxSlack(0) {
+    memset(mSlots, 0, sizeof(mSlots));
+    memset(mOccupied, 0, sizeof(mOccupied));
+}
+
+uint64_t LocTimerWheel::getNowTick() {
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// hashes the timer into the lowest level slot that covers its expiry
+void LocTimerWheel::link(LocTimerDelegate& timer) {
+    uint64_t expires = timer.getFutureTick();
+    if (expires < mBase) {
+        // overdue, goes to the slot processed next
+        expires = mBase;
+    } else if (expires - mBase >= (1ULL << getShift(LOC_TIMER_WHEEL_LEVELS))) {
+        // beyond the top level, parks at its far end and cascades from there
+        expires = mBase + (1ULL << getShift(LOC_TIMER_WHEEL_LEVELS)) - 1;
+    }
+
+    uint32_t level = 0;
+    while (level < LOC_TIMER_WHEEL_LEVELS - 1 &&
+           expires - mBase >= (1ULL << getShift(level + 1))) {
+        level++;
+    }
+    uint32_t slot = getOffset(level) +
+            ((expires >> getShift(level)) & (getSize(level) - 1));
+
+    timer.mWheelSlot = slot;
+    timer.mWheelNext = mSlots[slot];
+    if (NULL != timer.mWheelNext) {
+        timer.mWheelNext->mWheelPrev = &timer.mWheelNext;
+    }
+    timer.mWheelPrev = &mSlots[slot];
+    mSlots[slot] = &timer;
+    mOccupied[slot >> 6] |= 1ULL << (slot & 63);
+}
+
+void LocTimerWheel::unlink(LocTimerDelegate& timer) {
+    *timer.mWheelPrev = timer.mWheelNext;
+    if (NULL != timer.mWheelNext) {
+        timer.mWheelNext->mWheelPrev = timer.mWheelPrev;
+    }
+    if (NULL == mSlots[timer.mWheelSlot]) {
+        mOccupied[timer.mWheelSlot >> 6] &= ~(1ULL << (timer.mWheelSlot & 63));
+    }
+    timer.mWheelNext = NULL;
+    timer.mWheelPrev = NULL;
+}
+
+// moves the timers of the current slot of the level down the levels;
+// returns the index of the slot, the level above cascades too if it is 0
+uint32_t LocTimerWheel::cascade(uint32_t level) {
+    uint32_t index = (mBase >> getShift(level)) & (getSize(level) - 1);
+    uint32_t slot = getOffset(level) + index;
+    LocTimerDelegate* timer = mSlots[slot];
+
+    mSlots[slot] = NULL;
+    mOccupied[slot >> 6] &= ~(1ULL << (slot & 63));
+    while (NULL != timer) {
+        LocTimerDelegate* next = timer->mWheelNext;
+        link(*timer);
+        timer = next;
+    }
+    return index;
+}
+
+// circular distance from slot index from to the next occupied slot of the
+// level; the size of the level if all of its slots are empty
+uint32_t LocTimerWheel::getDistance(uint32_t level, uint32_t from) {
+    uint32_t size = getSize(level);
+    uint32_t offset = getOffset(level);
+    for (uint32_t distance = 0; distance < size; ) {
+        uint32_t bit = offset + ((from + distance) & (size - 1));
+        // bits up to the end of either the bitmap word or the level
+        uint32_t span = 64 - (bit & 63);
+        if (span > offset + size - bit) {
+            span = offset + size - bit;
+        }
+        uint64_t word = mOccupied[bit >> 6] >> (bit & 63);
+        if (span < 64) {
+            word &= (1ULL << span) - 1;
+        }
+        if (0 != word) {
+            return distance + __builtin_ctzll(word);
+        }
+        distance += span;
+    }
+    return size;
+}
+
+void LocTimerWheel::add(LocTimerDelegate& timer, uint64_t nowTick) {
+    if (0 == mCount) {
+        // nothing to process in between, so no need to catch up
+        mBase = nowTick;
+    }
+    if (timer.getFutureTick() - timer.getEarliestTick() > mMaxSlack) {
+        mMaxSlack = timer.getFutureTick() - timer.getEarliestTick();
+    }
+    link(timer);
+    mCount++;
+}
+
+bool LocTimerWheel::remove(LocTimerDelegate& timer) {
+    bool removed = false;
+    if (NULL != timer.mWheelPrev) {
+        unlink(timer);
+        mCount--;
+        removed = true;
+    }
+    return removed;
+}
+
+LocTimerDelegate* LocTimerWheel::advance(uint64_t nowTick) {
+    LocTimerDelegate* expired = NULL;
+    LocTimerDelegate** tail = &expired;
+    uint32_t l0Size = getSize(0);
+
+    while (mBase <= nowTick && mCount > 0) {
+        uint32_t index = mBase & (l0Size - 1);
+
+        // all the timers in the level 0 slot of the tick are due
+        while (NULL != mSlots[index]) {
+            LocTimerDelegate* timer = mSlots[index];
+            unlink(*timer);
+            mCount--;
+            *tail = timer;
+            tail = &timer->mWheelNext;
+        }
+
+        // skip the empty ticks, up to the next turn of level 0, and no further
+        // than nowTick + 1, or a shorter timer added next would fall behind
+        // mBase and be clamped to it, late
+        uint32_t step = 1 + getDistance(0, (index + 1) & (l0Size - 1));
+        if (step > l0Size - index) {
+            step = l0Size - index;
+        }
+        if (step > nowTick + 1 - mBase) {
+            step = nowTick + 1 - mBase;
+        }
+        mBase += step;
+
+        // entering a new turn, the slots above covering it cascade right
+        // away, so that getNextTick() need not look at them
+        if (0 == (mBase & (l0Size - 1))) {
+            for (uint32_t level = 1;
+                 level < LOC_TIMER_WHEEL_LEVELS && 0 == cascade(level);
+                 level++);
+        }
+    }
+    if (mBase <= nowTick) {
+        // the wheel is empty
+        mBase = nowTick + 1;
+    }
+
+    // the timers with slack whose windows have opened ride along. Only level 0
+    // is looked at, the timers in the levels above are yet to cascade into it.
+    uint64_t horizon = (mMaxSlack < l0Size) ? mMaxSlack : l0Size;
+    for (uint64_t ahead = 0; mCount > 0 && ahead < horizon; ahead++) {
+        uint32_t index = (mBase + ahead) & (l0Size - 1);
+        uint32_t distance = getDistance(0, index);
+        if (distance >= horizon - ahead) {
+            break;
+        }
+        ahead += distance;
+        index = (mBase + ahead) & (l0Size - 1);
+        for (LocTimerDelegate* timer = mSlots[index]; NULL != timer; ) {
+            LocTimerDelegate* next = timer->mWheelNext;
+            if (timer->getEarliestTick() <= nowTick) {
+                unlink(*timer);
+                mCount--;
+                *tail = timer;
+                tail = &timer->mWheelNext;
+            }
+            timer = next;
+        }
+    }
+    return expired;
+}
+
+uint64_t LocTimerWheel::getNextTick() {
+    uint64_t nextTick = LOC_TIMER_WHEEL_NONE;
+    if (mCount > 0) {
+        // the next occupied level 0 slot, which may be in its next turn
+        uint32_t distance = getDistance(0, mBase & (getSize(0) - 1));
+        if (distance < getSize(0)) {
+            nextTick = mBase + distance;
+        }
+        // the start of the span of the next occupied slot of each level
+        // above, when that slot cascades; the slots of the current spans
+        // have cascaded already
+        for (uint32_t level = 1; level < LOC_TIMER_WHEEL_LEVELS; level++) {
+            uint32_t shift = getShift(level);
+            uint32_t index = (mBase >> shift) & (getSize(level) - 1);
+            distance = getDistance(level, (index + 1) & (getSize(level) - 1));
+            if (distance < getSize(level)) {
+                uint64_t tick = ((mBase >> shift) + distance + 1) << shift;
+                if (tick < nextTick) {
+                    nextTick = tick;
+                }
+            }
+        }
+    }
+    return nextTick;
+}
 
 /***************************LocTimerPollTask methods***************************/
 
 inline
 LocTimerPollTask::LocTimerPollTask()
-    : mFd(epoll_create(2)), mThread(new LocThread()) {
+    : mFd(epoll_create(4)), mThread(new LocThread()) {
     // before a next call returens, a thread will be created. The run() method
     // could already be running in parallel. Also, since each of the objs
     // creates a thread, the container will make sure that there will be only
@@ -448,16 +988,16 @@ void LocTimerPollTask::removePoll(LocTimerContainer& timerContainer) {
 // The polling thread context will call this method. If run() method needs to
 // be repetitvely called, it must return true from the previous call.
 bool LocTimerPollTask::run() {
-    struct epoll_event ev[2];
+    struct epoll_event ev[4];
 
-    // we have max 2 descriptors to poll from
-    int fds = epoll_wait(mFd, ev, 2, -1);
+    // we have max 4 descriptors to poll from
+    int fds = epoll_wait(mFd, ev, 4, -1);
 
     // we pretty much want to continually poll until the fd is closed
     bool rerun = (fds > 0) || (errno == EINTR);
 
     if (fds > 0) {
-        // we may have 2 events
+        // we may have 4 events
         for (int i = 0; i < fds; i++) {
             // each fd has a context pointer associated with the right timer container
             LocTimerContainer* container = (LocTimerContainer*)(ev[i].data.ptr);
@@ -477,12 +1017,20 @@ bool LocTimerPollTask::run() {
 
 inline
 LocTimerDelegate::LocTimerDelegate(LocTimer& client,
+                                   struct timespec& earliestTime,
                                    struct timespec& futureTime,
-                                   LocTimerContainer* container)
+                                   LocTimerContainer* container,
+                                   uint64_t periodNs)
     : mClient(&client),
       mLock(mClient->mLock->share()),
       mFutureTime(futureTime),
-      mContainer(container) {
+      mEarliestTime(earliestTime),
+      mContainer(container),
+      mDispatchTask(client.mDispatchTask),
+      mExpiring(false),
+      mPeriodNs(periodNs),
+      mOverruns(0),
+      mWheelNext(NULL), mWheelPrev(NULL), mWheelSlot(0) {
     // adding the timer into the container
     mContainer->add(*this);
 }
@@ -524,6 +1072,23 @@ int LocTimerDelegate::ranks(LocRankable& rankable) {
 
 inline
 void LocTimerDelegate::expire() {
+    if (0 != mPeriodNs) {
+        // Not stopped, as it stays in the container for the next period. The
+        // callback is made with the client lock held, so that a stop() in
+        // another thread, and the client dtor behind it, waits for it to
+        // return. The callback may still stop or restart its own timer, as
+        // the lock is recursive; this obj is deleted only after we return,
+        // in this same MsgTask thread.
+        mLock->lock();
+        LocTimer* client = mClient;
+        if (client) {
+            client->mOverruns = __atomic_exchange_n(&mOverruns, 0, __ATOMIC_RELAXED);
+            client->timeOutCallback();
+        }
+        mLock->unlock();
+        return;
+    }
+
     // keeping a copy of client pointer to be safe
     // when timeOutCallback() is called at the end of this
     // method, *this* obj may be already deleted.
@@ -538,8 +1103,88 @@ void LocTimerDelegate::expire() {
 }
 
 
+void LocTimerDelegate::dispatch() {
+    struct MsgTimerDispatch : public LocMsg {
+        mutable LocTimerDelegate* mTimer;
+        inline MsgTimerDispatch(LocTimerDelegate& timer) :
+            LocMsg(), mTimer(&timer) {}
+        // dropped without being processed, e.g. mDispatchTask is full
+        inline ~MsgTimerDispatch() {
+            if (mTimer) {
+                mTimer->expireDirect(false);
+            }
+        }
+        inline virtual void proc() const {
+            LocTimerDelegate* timer = mTimer;
+            mTimer = NULL;
+            timer->expireDirect(true);
+        }
+    };
+
+    if (mDispatchTask) {
+        mDispatchTask->sendMsg(new MsgTimerDispatch(*this));
+    } else {
+        expireDirect(true);
+    }
+}
+
+// Does what expire() and the client's stop() do, with the client lock held
+// instead of calling stop(), as the container would otherwise delete this
+// obj while stop() still needs it.
+void LocTimerDelegate::expireDirect(bool callBack) {
+    bool deleteThis = true;
+    // a stop() in the callback below may delete this obj, but not the lock
+    LocSharedLock* lock = mLock->share();
+    lock->lock();
+    // NULL if the client has stopped the timer since its expiry
+    LocTimer* client = mClient;
+    if (client && this == client->mTimer) {
+        if (0 != mPeriodNs) {
+            // still in the container, for stop() to remove and delete
+            client->mOverruns = __atomic_exchange_n(&mOverruns, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&mExpiring, false, __ATOMIC_RELEASE);
+            deleteThis = false;
+            // with the client lock held, as in expire()
+            if (callBack) {
+                client->timeOutCallback();
+            }
+            client = NULL;
+        } else {
+            client->mTimer = NULL;
+            mClient = NULL;
+        }
+    } else {
+        client = NULL;
+    }
+    lock->unlock();
+    lock->drop();
+
+    if (deleteThis) {
+        delete this;
+    }
+    if (client && callBack) {
+        client->timeOutCallback();
+    }
+}
+
+// Drift free, as the next deadline follows from the last one, rather than
+// from when the last expiry got processed.
+void LocTimerDelegate::advancePeriod(uint64_t nowNs) {
+    uint64_t dueNs = toNs(mFutureTime) + mPeriodNs;
+    if (dueNs <= nowNs) {
+        uint64_t missed = (nowNs - dueNs) / mPeriodNs + 1;
+        __atomic_add_fetch(&mOverruns, (uint32_t)missed, __ATOMIC_RELAXED);
+        dueNs += missed * mPeriodNs;
+    }
+    mFutureTime.tv_sec = dueNs / 1000000000;
+    mFutureTime.tv_nsec = dueNs % 1000000000;
+    mEarliestTime = mFutureTime;
+}
+
+
 /***************************LocTimer methods***************************/
-LocTimer::LocTimer() : mTimer(NULL), mLock(new LocSharedLock()) {
+LocTimer::LocTimer() : mTimer(NULL), mLock(new LocSharedLock()),
+    mDirect(false), mDispatchTask(NULL), mOverruns(0) {
 }
 
 LocTimer::~LocTimer() {
@@ -551,23 +1196,61 @@ LocTimer::~LocTimer() {
 }
 
 bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
+    return start(timeOutInMs, 0, wakeOnExpire);
+}
+
+bool LocTimer::start(uint32_t timeOutInMs, uint32_t slackInMs, bool wakeOnExpire) {
     bool success = false;
     mLock->lock();
     if (!mTimer) {
+        struct timespec earliestTime;
+        clock_gettime(CLOCK_BOOTTIME, &earliestTime);
+        earliestTime.tv_sec += timeOutInMs / 1000;
+        earliestTime.tv_nsec += (timeOutInMs % 1000) * 1000000;
+        if (earliestTime.tv_nsec >= 1000000000) {
+            earliestTime.tv_sec += earliestTime.tv_nsec / 1000000000;
+            earliestTime.tv_nsec %= 1000000000;
+        }
+        struct timespec futureTime = earliestTime;
+        futureTime.tv_sec += slackInMs / 1000;
+        futureTime.tv_nsec += (slackInMs % 1000) * 1000000;
+        if (futureTime.tv_nsec >= 1000000000) {
+            futureTime.tv_sec += futureTime.tv_nsec / 1000000000;
+            futureTime.tv_nsec %= 1000000000;
+        }
+
+        LocTimerContainer* container;
+        container = LocTimerContainer::get(wakeOnExpire, mDirect);
+        if (NULL != container) {
+            mTimer = new LocTimerDelegate(*this, earliestTime, futureTime, container);
+            // if mTimer is non 0, success should be 0; or vice versa
+        }
+        success = (NULL != mTimer);
+    }
+    mLock->unlock();
+    return success;
+}
+
+bool LocTimer::startPeriodic(uint32_t periodMs, uint32_t phaseMs, bool wakeOnExpire) {
+    bool success = false;
+    mLock->lock();
+    if (!mTimer && periodMs > 0) {
+        uint32_t firstMs = (0 != phaseMs) ? phaseMs : periodMs;
         struct timespec futureTime;
         clock_gettime(CLOCK_BOOTTIME, &futureTime);
-        futureTime.tv_sec += timeOutInMs / 1000;
-        futureTime.tv_nsec += (timeOutInMs % 1000) * 1000000;
+        futureTime.tv_sec += firstMs / 1000;
+        futureTime.tv_nsec += (firstMs % 1000) * 1000000;
         if (futureTime.tv_nsec >= 1000000000) {
             futureTime.tv_sec += futureTime.tv_nsec / 1000000000;
             futureTime.tv_nsec %= 1000000000;
         }
 
+        mOverruns = 0;
         LocTimerContainer* container;
-        container = LocTimerContainer::get(wakeOnExpire);
+        container = LocTimerContainer::get(wakeOnExpire, mDirect);
         if (NULL != container) {
-            mTimer = new LocTimerDelegate(*this, futureTime, container);
-            // if mTimer is non 0, success should be 0; or vice versa
+            mTimer = new LocTimerDelegate(*this, futureTime, futureTime, container,
+                                          (uint64_t)periodMs * 1000000);
         }
         success = (NULL != mTimer);
     }
@@ -590,6 +1273,17 @@ bool LocTimer::stop() {
     return success;
 }
 
+void LocTimer::setDirectDispatch(bool direct, MsgTask* msgTask) {
+    mLock->lock();
+    mDirect = direct;
+    mDispatchTask = direct ? msgTask : NULL;
+    mLock->unlock();
+}
+
+uint32_t LocTimer::getWakeupsSaved(bool wakeOnExpire) {
+    return LocTimerContainer::getWakeupsSaved(wakeOnExpire);
+}
+
 /***************************LocTimerWrapper methods***************************/
 //////////////////////////////////////////////////////////////////////////
 // This section below wraps for the C style APIs
@@ -693,12 +1387,473 @@ public:
     }
 };
 
+static inline uint64_t getNowNs() {
+    struct timespec now = getNow();
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+class LocTimerBench : public LocTimer {
+public:
+    static pthread_mutex_t mMutex;
+    static pthread_cond_t mCond;
+    static uint32_t mFired;
+    static uint32_t mEarly;
+    static uint64_t mLateNsSum;
+    static uint64_t mLateNsMax;
+    uint64_t mDueNs;
+    inline LocTimerBench() : LocTimer(), mDueNs(0) {}
+    inline bool startBench(uint32_t timeOutInMs, uint32_t slackInMs = 0) {
+        mDueNs = getNowNs() + (uint64_t)timeOutInMs * 1000000;
+        return start(timeOutInMs, slackInMs, false);
+    }
+    inline virtual void timeOutCallback() {
+        uint64_t nowNs = getNowNs();
+        pthread_mutex_lock(&mMutex);
+        mFired++;
+        if (nowNs < mDueNs) {
+            mEarly++;
+        } else {
+            mLateNsSum += nowNs - mDueNs;
+            mLateNsMax = (nowNs - mDueNs > mLateNsMax) ? nowNs - mDueNs : mLateNsMax;
+        }
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    static void reset() {
+        pthread_mutex_lock(&mMutex);
+        mFired = mEarly = 0;
+        mLateNsSum = mLateNsMax = 0;
+        pthread_mutex_unlock(&mMutex);
+    }
+    static void waitFired(uint32_t count) {
+        pthread_mutex_lock(&mMutex);
+        while (mFired < count) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+pthread_mutex_t LocTimerBench::mMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t LocTimerBench::mCond = PTHREAD_COND_INITIALIZER;
+uint32_t LocTimerBench::mFired = 0;
+uint32_t LocTimerBench::mEarly = 0;
+uint64_t LocTimerBench::mLateNsSum = 0;
+uint64_t LocTimerBench::mLateNsMax = 0;
+
+// Churns count timers the way clients re-arm their timeouts, each round
+// stopping and restarting every timer with a random timeout of 1 to 60 s,
+// then lets them all expire over 2 s, with the given slack, to check the
+// callbacks are on time and count the wakeups the slack saves.
+static int benchmark(bool useWheel, int count, uint32_t slackInMs) {
+    const int rounds = 10;
+    LocTimerContainer::setUseWheel(useWheel);
+    LocTimerBench* timers = new LocTimerBench[count];
+    LocTimerBench sentinel;
+
+    uint64_t startNs = getNowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < count; i++) {
+            timers[i].stop();
+            timers[i].startBench(1000 + rand() % 60000);
+        }
+    }
+    // the timer thread has done all of the above once the sentinel fires
+    sentinel.startBench(1);
+    LocTimerBench::waitFired(1);
+    uint64_t churnNs = getNowNs() - startNs;
+    uint32_t setTimeCount = LocTimerContainer::get(false)->getSetTimeCount();
+
+    for (int i = 0; i < count; i++) {
+        timers[i].stop();
+    }
+    LocTimerBench::reset();
+    for (int i = 0; i < count; i++) {
+        timers[i].startBench(1 + rand() % 2000, slackInMs);
+    }
+    LocTimerBench::waitFired(count);
+
+    printf("%s: %d timers, %d start / stop in %.1f ms, %.0f ns per op, "
+           "%u timerfd_settime calls\n", useWheel ? "wheel" : "heap", count,
+           2 * rounds * count, churnNs / 1e6, (double)churnNs / (2 * rounds * count),
+           setTimeCount);
+    printf("%s: %u expired, %u early, late by %.3f ms on average, %.3f ms at most, "
+           "%u ms slack saved %u wakeups\n",
+           useWheel ? "wheel" : "heap", LocTimerBench::mFired, LocTimerBench::mEarly,
+           LocTimerBench::mLateNsSum / 1e6 / count, LocTimerBench::mLateNsMax / 1e6,
+           slackInMs, LocTimer::getWakeupsSaved(false));
+
+    delete[] timers;
+    return 0;
+}
+
+// Measures the jitter from the expiry of a timer to where its client gets
+// to act on it, in the client's own MsgTask: through the timer MsgTask and a
+// post to the client's (2 hops), directly from the poll thread and then a
+// post (1 hop), or directly into the client's MsgTask (1 hop).
+class LocTimerJitter : public LocTimer {
+public:
+    static MsgTask* mClientTask;
+    static pthread_mutex_t mMutex;
+    static pthread_cond_t mCond;
+    static std::vector<uint64_t> mLateNs;
+    uint64_t mDueNs;
+    bool mPost;
+    inline LocTimerJitter() : LocTimer(), mDueNs(0), mPost(true) {}
+    static void record(uint64_t dueNs) {
+        uint64_t nowNs = getNowNs();
+        pthread_mutex_lock(&mMutex);
+        mLateNs.push_back(nowNs > dueNs ? nowNs - dueNs : 0);
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    inline virtual void timeOutCallback() {
+        struct MsgJitter : public LocMsg {
+            uint64_t mDueNs;
+            inline MsgJitter(uint64_t dueNs) : LocMsg(), mDueNs(dueNs) {}
+            inline virtual void proc() const { record(mDueNs); }
+        };
+        if (mPost) {
+            mClientTask->sendMsg(new MsgJitter(mDueNs));
+        } else {
+            record(mDueNs);
+        }
+    }
+};
+
+MsgTask* LocTimerJitter::mClientTask = NULL;
+pthread_mutex_t LocTimerJitter::mMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t LocTimerJitter::mCond = PTHREAD_COND_INITIALIZER;
+std::vector<uint64_t> LocTimerJitter::mLateNs;
+
+static int jitter(int count) {
+    const char* modes[] = { "msgtask", "poll", "target" };
+    LocTimerJitter::mClientTask = new MsgTask("LocTimerJitter", false);
+    LocTimerJitter* timers = new LocTimerJitter[count];
+
+    for (int mode = 0; mode < 3; mode++) {
+        pthread_mutex_lock(&LocTimerJitter::mMutex);
+        LocTimerJitter::mLateNs.clear();
+        pthread_mutex_unlock(&LocTimerJitter::mMutex);
+        for (int i = 0; i < count; i++) {
+            timers[i].setDirectDispatch(mode > 0,
+                                        (2 == mode) ? LocTimerJitter::mClientTask : NULL);
+            timers[i].mPost = (mode < 2);
+            uint32_t timeOutInMs = 1 + rand() % 1000;
+            timers[i].mDueNs = getNowNs() + (uint64_t)timeOutInMs * 1000000;
+            timers[i].start(timeOutInMs, false);
+        }
+
+        pthread_mutex_lock(&LocTimerJitter::mMutex);
+        while (LocTimerJitter::mLateNs.size() < (size_t)count) {
+            pthread_cond_wait(&LocTimerJitter::mCond, &LocTimerJitter::mMutex);
+        }
+        std::vector<uint64_t>& late = LocTimerJitter::mLateNs;
+        std::sort(late.begin(), late.end());
+        uint64_t sum = 0;
+        for (size_t i = 0; i < late.size(); i++) {
+            sum += late[i];
+        }
+        printf("%-8s: %d timers, expiry to client in us: mean %.1f, p50 %.1f, "
+               "p99 %.1f, max %.1f\n", modes[mode], count, sum / 1e3 / count,
+               late[count / 2] / 1e3, late[count * 99 / 100] / 1e3, late[count - 1] / 1e3);
+        pthread_mutex_unlock(&LocTimerJitter::mMutex);
+    }
+
+    delete[] timers;
+    return 0;
+}
+
+// Compares the drift of a periodic timer with that of a one shot timer
+// re-armed from its callback, both with callbacks that take workMs, and
+// counts the overruns of callbacks that every so often take 2.5 periods.
+class LocTimerPeriodic : public LocTimer {
+public:
+    uint32_t mPeriodMs;
+    uint32_t mWorkMs;
+    bool mRearm;
+    uint32_t mCount;
+    uint32_t mTarget;
+    uint32_t mExpiries;
+    uint32_t mOverrunTotal;
+    uint64_t mLastNs;
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    inline LocTimerPeriodic(uint32_t periodMs, uint32_t workMs, bool rearm, uint32_t target) :
+        LocTimer(), mPeriodMs(periodMs), mWorkMs(workMs), mRearm(rearm), mCount(0),
+        mTarget(target), mExpiries(0), mOverrunTotal(0), mLastNs(0),
+        mMutex(PTHREAD_MUTEX_INITIALIZER), mCond(PTHREAD_COND_INITIALIZER) {}
+    inline virtual void timeOutCallback() {
+        uint64_t nowNs = getNowNs();
+        uint32_t overruns = getOverruns();
+        // a slow callback every 10th time, if not re-armed
+        usleep(1000 * ((!mRearm && 0 == (mCount + 1) % 10) ? mPeriodMs * 5 / 2 : mWorkMs));
+        pthread_mutex_lock(&mMutex);
+        mCount++;
+        mOverrunTotal += overruns;
+        mExpiries += 1 + overruns;
+        if (mExpiries >= mTarget) {
+            mLastNs = nowNs;
+            stop();
+            pthread_cond_signal(&mCond);
+        } else if (mRearm) {
+            start(mPeriodMs, false);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+    void wait() {
+        pthread_mutex_lock(&mMutex);
+        while (0 == mLastNs) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+static int periodic(uint32_t periodMs, uint32_t count) {
+    uint32_t workMs = periodMs / 4;
+
+    LocTimerPeriodic oneShot(periodMs, workMs, true, count);
+    uint64_t startNs = getNowNs();
+    oneShot.start(periodMs, false);
+    oneShot.wait();
+    printf("one shot: %u expiries of %u ms, with %u ms callbacks, drift %.3f ms\n",
+           count, periodMs, workMs, (oneShot.mLastNs - startNs) / 1e6 - (double)count * periodMs);
+
+    LocTimerPeriodic periodicTimer(periodMs, workMs, false, count);
+    startNs = getNowNs();
+    periodicTimer.startPeriodic(periodMs, 0, false);
+    periodicTimer.wait();
+    printf("periodic: %u expiries of %u ms, with %u ms callbacks, drift %.3f ms, "
+           "%u callbacks, %u overruns\n", periodicTimer.mExpiries, periodMs, workMs,
+           (periodicTimer.mLastNs - startNs) / 1e6 - (double)periodicTimer.mExpiries * periodMs,
+           periodicTimer.mCount, periodicTimer.mOverrunTotal);
+    return 0;
+}
+
+// The benchmark suite, with one JSON obj per line on stdout, to be tracked
+// across releases. Each line has "suite", "version", "backend" and "test",
+// plus the numbers of the test in ns, ops or counts.
+#define LOC_TIMER_SUITE_VERSION 1
+
+static void suiteLine(const char* backend, const char* test, const char* fields) {
+    printf("{\"suite\":\"loc_timer\",\"version\":%d,\"backend\":\"%s\","
+           "\"test\":\"%s\",%s}\n", LOC_TIMER_SUITE_VERSION, backend, test, fields);
+    fflush(stdout);
+}
+
+// percentiles of the sorted samples, as JSON fields
+static void suitePercentiles(std::vector<uint64_t>& samples, char* fields, size_t size) {
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    snprintf(fields, size, "\"samples\":%zu,\"mean_ns\":%llu,\"p50_ns\":%llu,"
+             "\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu", n,
+             (unsigned long long)(n ? sum / n : 0),
+             (unsigned long long)(n ? samples[n / 2] : 0),
+             (unsigned long long)(n ? samples[n * 9 / 10] : 0),
+             (unsigned long long)(n ? samples[n * 99 / 100] : 0),
+             (unsigned long long)(n ? samples[n * 999 / 1000] : 0),
+             (unsigned long long)(n ? samples[n - 1] : 0));
+}
+
+// push / pop and remove throughput of LocHeap alone, with the ranks() of
+// a 64 bit expiry like that of a timer
+class LocHeapBenchNode : public LocRankable {
+public:
+    uint64_t mKey;
+    inline LocHeapBenchNode() : LocRankable(), mKey(0) {}
+    inline virtual int ranks(LocRankable& rankable) {
+        uint64_t key = ((LocHeapBenchNode&)rankable).mKey;
+        return (key > mKey) ? 1 : ((key < mKey) ? -1 : 0);
+    }
+};
+
+static void suiteHeap(const char* backend, int count) {
+    LocHeapBenchNode* timers = new LocHeapBenchNode[count];
+    for (int i = 0; i < count; i++) {
+        timers[i].mKey = ((uint64_t)rand() << 31) ^ rand();
+    }
+    LocHeap heap;
+    uint64_t startNs = getNowNs();
+    for (int i = 0; i < count; i++) {
+        heap.push(timers[i]);
+    }
+    uint64_t pushNs = getNowNs() - startNs;
+    startNs = getNowNs();
+    while (NULL != heap.pop());
+    uint64_t popNs = getNowNs() - startNs;
+    for (int i = 0; i < count; i++) {
+        heap.push(timers[i]);
+    }
+    startNs = getNowNs();
+    for (int i = count - 1; i >= 0; i--) {
+        heap.remove(timers[(uint32_t)((uint64_t)i * 7919 % count)]);
+    }
+    uint64_t removeNs = getNowNs() - startNs;
+
+    char fields[256];
+    snprintf(fields, sizeof(fields), "\"timers\":%d,\"push_ns_per_op\":%.1f,"
+             "\"pop_ns_per_op\":%.1f,\"remove_ns_per_op\":%.1f", count,
+             (double)pushNs / count, (double)popNs / count, (double)removeNs / count);
+    suiteLine(backend, "heap", fields);
+    delete[] timers;
+}
+
+// start / stop throughput from threads threads, each churning its own
+// timers; the callers only queue msgs, so the time to drain them counts
+struct LocTimerSuiteThread {
+    pthread_t mThread;
+    LocTimerBench* mTimers;
+    int mCount;
+    int mRounds;
+    static void* run(void* arg) {
+        LocTimerSuiteThread* thread = (LocTimerSuiteThread*)arg;
+        for (int r = 0; r < thread->mRounds; r++) {
+            for (int i = 0; i < thread->mCount; i++) {
+                thread->mTimers[i].stop();
+                thread->mTimers[i].startBench(10000 + rand() % 60000);
+            }
+        }
+        return NULL;
+    }
+};
+
+static void suiteStartStop(const char* backend, int threads, int count, int rounds) {
+    std::vector<LocTimerSuiteThread> thread(threads);
+    LocTimerBench* timers = new LocTimerBench[threads * count];
+    LocTimerBench sentinel;
+    LocTimerBench::reset();
+
+    uint64_t startNs = getNowNs();
+    for (int t = 0; t < threads; t++) {
+        thread[t].mTimers = timers + t * count;
+        thread[t].mCount = count;
+        thread[t].mRounds = rounds;
+        pthread_create(&thread[t].mThread, NULL, LocTimerSuiteThread::run, &thread[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(thread[t].mThread, NULL);
+    }
+    uint64_t callNs = getNowNs() - startNs;
+    sentinel.startBench(1);
+    LocTimerBench::waitFired(1);
+    uint64_t totalNs = getNowNs() - startNs;
+
+    uint64_t ops = 2ULL * threads * count * rounds;
+    char fields[256];
+    snprintf(fields, sizeof(fields), "\"threads\":%d,\"timers\":%d,\"ops\":%llu,"
+             "\"call_ns_per_op\":%.1f,\"ns_per_op\":%.1f,\"ops_per_s\":%.0f",
+             threads, threads * count, (unsigned long long)ops, (double)callNs / ops,
+             (double)totalNs / ops, ops * 1e9 / totalNs);
+    suiteLine(backend, "start_stop", fields);
+    delete[] timers;
+}
+
+// expiry to callback jitter with concurrent timers pending at once, over
+// rounds of them, in the timer MsgTask
+static void suiteJitter(const char* backend, int concurrent, int rounds, uint32_t maxMs) {
+    LocTimerJitter* timers = new LocTimerJitter[concurrent];
+    std::vector<uint64_t> samples;
+
+    for (int r = 0; r < rounds; r++) {
+        pthread_mutex_lock(&LocTimerJitter::mMutex);
+        LocTimerJitter::mLateNs.clear();
+        pthread_mutex_unlock(&LocTimerJitter::mMutex);
+        for (int i = 0; i < concurrent; i++) {
+            timers[i].mPost = false;
+            uint32_t timeOutInMs = 1 + rand() % maxMs;
+            timers[i].mDueNs = getNowNs() + (uint64_t)timeOutInMs * 1000000;
+            timers[i].start(timeOutInMs, false);
+        }
+        pthread_mutex_lock(&LocTimerJitter::mMutex);
+        while (LocTimerJitter::mLateNs.size() < (size_t)concurrent) {
+            pthread_cond_wait(&LocTimerJitter::mCond, &LocTimerJitter::mMutex);
+        }
+        samples.insert(samples.end(), LocTimerJitter::mLateNs.begin(),
+                       LocTimerJitter::mLateNs.end());
+        pthread_mutex_unlock(&LocTimerJitter::mMutex);
+    }
+
+    char fields[384];
+    int len = snprintf(fields, sizeof(fields), "\"concurrent\":%d,", concurrent);
+    suitePercentiles(samples, fields + len, sizeof(fields) - len);
+    suiteLine(backend, "jitter", fields);
+    delete[] timers;
+}
+
+// lateness of a short timer started while a longer one is pending, after
+// another has just expired: the wheel must not have skipped past the ticks
+// of the short one looking for the next to expire
+static void suiteShortUnderLong(const char* backend, int rounds) {
+    LocTimerBench longTimer, expiring, shortTimer;
+    std::vector<uint64_t> samples;
+
+    for (int r = 0; r < rounds; r++) {
+        LocTimerBench::reset();
+        longTimer.startBench(300);
+        expiring.startBench(20);
+        LocTimerBench::waitFired(1);
+        shortTimer.startBench(10);
+        LocTimerBench::waitFired(2);
+        pthread_mutex_lock(&LocTimerBench::mMutex);
+        samples.push_back(LocTimerBench::mLateNsMax);
+        pthread_mutex_unlock(&LocTimerBench::mMutex);
+        longTimer.stop();
+    }
+
+    char fields[384];
+    int len = snprintf(fields, sizeof(fields), "\"long_ms\":300,\"short_ms\":10,");
+    suitePercentiles(samples, fields + len, sizeof(fields) - len);
+    suiteLine(backend, "short_under_long", fields);
+}
+
+static int suite(bool useWheel) {
+    const char* backend = useWheel ? "wheel" : "heap";
+    LocTimerContainer::setUseWheel(useWheel);
+    LocTimerJitter::mClientTask = new MsgTask("LocTimerSuite", false);
+
+    suiteHeap(backend, 1000);
+    suiteHeap(backend, 100000);
+    suiteStartStop(backend, 1, 10000, 10);
+    suiteJitter(backend, 1, 200, 5);
+    suiteJitter(backend, 100, 5, 500);
+    suiteJitter(backend, 10000, 1, 1000);
+    suiteShortUnderLong(backend, 20);
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        suiteStartStop(backend, threads, 1000, 20);
+    }
+    return 0;
+}
+
 // For Linux command line testing:
-// compilation:
-//     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../../../system/core/include -o LocHeap.o LocHeap.cpp
-//     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -std=c++0x -I. -I../../../../system/core/include -lpthread -o LocThread.o LocThread.cpp
-//     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../../../system/core/include -o LocTimer.o LocTimer.cpp
+// build: make check, for loc_timer_bench, linked with libgps_utils
+// suite: make bench, both backends into loc_timer_bench.json, or
+//            ./loc_timer_bench suite heap|wheel
+// benchmark: ./loc_timer_bench bench heap|wheel [number of timers, 10000 by default]
+//                                               [slack in ms, 0 by default]
+//            ./loc_timer_bench jitter [number of timers, 1000 by default]
+//            ./loc_timer_bench periodic [period in ms, 20 by default]
+//                                       [expiries, 100 by default]
+// test:      ./loc_timer_bench [number of timers]
 int main(int argc, char** argv) {
+    if (argc > 2 && 0 == strcmp(argv[1], "suite")) {
+        return suite(0 == strcmp(argv[2], "wheel"));
+    }
+    if (argc > 1 && 0 == strcmp(argv[1], "periodic")) {
+        return periodic((argc > 2) ? atoi(argv[2]) : 20, (argc > 3) ? atoi(argv[3]) : 100);
+    }
+    if (argc > 1 && 0 == strcmp(argv[1], "jitter")) {
+        return jitter((argc > 2) ? atoi(argv[2]) : 1000);
+    }
+    if (argc > 2 && 0 == strcmp(argv[1], "bench")) {
+        return benchmark(0 == strcmp(argv[2], "wheel"), (argc > 3) ? atoi(argv[3]) : 10000,
+                         (argc > 4) ? atoi(argv[4]) : 0);
+    }
+
     struct timespec timeOfStart=getNow();
     srand(time(NULL));
     int tries = atoi(argv[1]);
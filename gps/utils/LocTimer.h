@@ -36,6 +36,7 @@
 // opaque class to provide service implementation.
 class LocTimerDelegate;
 class LocSharedLock;
+class MsgTask;
 
 // LocTimer client must extend this class and implementthe callback.
 // start() / stop() methods are to arm / disarm timer.
@@ -43,6 +44,9 @@ class LocTimer
 {
     LocTimerDelegate* mTimer;
     LocSharedLock* mLock;
+    bool mDirect;
+    MsgTask* mDispatchTask;
+    uint32_t mOverruns;
     // don't really want mLock to be manipulated by clients, yet LocTimer
     // has to have a reference to the lock so that the delete of LocTimer
     // and LocTimerDelegate can work together on their share resources.
@@ -61,14 +65,49 @@ public:
     //               false on failure, e.g. timer is already running.
     bool start(uint32_t timeOutInMs, bool wakeOnExpire);
 
+    // slackInMs:    how much later than timeOutInMs the timer may expire,
+    //               so that timers whose windows overlap expire together
+    //               on a single wakeup. 0 expires at timeOutInMs.
+    // others:       same as above.
+    bool start(uint32_t timeOutInMs, uint32_t slackInMs, bool wakeOnExpire);
+
+    // periodMs:     period in ms. The timer expires every periodMs until
+    //               stop(), on deadlines a whole number of periods after
+    //               the first one, so the time the callbacks take does not
+    //               add up to drift. stop(), and so the dtor, waits for
+    //               a callback running in another thread to return, so it
+    //               must not be called with a lock the callback takes.
+    // phaseMs:      delay of the first expiry in ms; 0 for one period.
+    // others:       same as above.
+    bool startPeriodic(uint32_t periodMs, uint32_t phaseMs, bool wakeOnExpire);
+
+    // To be called in timeOutCallback() of a periodic timer: the number of
+    // expiries missed since the last callback, e.g. as the callback took
+    // longer than a period.
+    inline uint32_t getOverruns() { return mOverruns; }
+
     // return:       true on success;
     //               false on failure, e.g. timer is not running.
     bool stop();
 
+    // Takes effect from the next start() on.
+    // direct:       false to call timeOutCallback() in the timer MsgTask
+    //                        thread (default).
+    //               true to skip that hop and call it right in the thread
+    //                        polling the timer fds, if msgTask is NULL; or
+    //                        else in msgTask, which must outlive the timer.
+    //                        On the poll thread the callback holds up all
+    //                        the other timers, so it must not block.
+    void setDirectDispatch(bool direct, MsgTask* msgTask = NULL);
+
     //  LocTimer client Should implement this method.
     //  This method is used for timeout calling back to client. This method
     //  should be short enough (eg: send a message to your own thread).
     virtual void timeOutCallback() = 0;
+
+    // number of wakeups saved so far by expiring timers (wakeOnExpire
+    // false) or alarms (wakeOnExpire true) of different expiry together
+    static uint32_t getWakeupsSaved(bool wakeOnExpire);
 };
 
 #endif //__LOC_DELAY_H__
@@ -30,43 +30,611 @@
 #define LOG_TAG "LocSvc_MsgTask"
 
 #include <unistd.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include <MsgTask.h>
+#include <LocExecutor.h>
 #include <msg_q.h>
 #include <log_util.h>
 #include <loc_log.h>
 #include <loc_pla.h>
 
-static void LocMsgDestroy(void* msg) {
-    delete (LocMsg*)msg;
+// most messages MsgTask::run() takes off the queue at a time
+#define MSG_TASK_BATCH_SIZE 32
+
+static const void* LocMsgQCreate(uint32_t ringSize, uint32_t capacity,
+                                 MsgTask::OverflowPolicy overflowPolicy) {
+    void* q = NULL;
+    if (0 == ringSize) {
+        q = (void*)msg_q_init2();
+    } else if (eMSG_Q_SUCCESS != msg_q_init_ring(&q, ringSize)) {
+        LOC_LOGE("%s: failed to create ring of %u, fall back to list", __func__, ringSize);
+        q = (void*)msg_q_init2();
+    }
+    if (NULL != q && (0 != capacity || MsgTask::OVERFLOW_BLOCK != overflowPolicy)) {
+        msg_q_set_capacity(q, capacity,
+                           (MsgTask::OVERFLOW_DROP_OLDEST == overflowPolicy) ?
+                           eMSG_Q_OVERFLOW_DROP_OLDEST :
+                           (MsgTask::OVERFLOW_REJECT == overflowPolicy) ?
+                           eMSG_Q_OVERFLOW_REJECT : eMSG_Q_OVERFLOW_BLOCK);
+    }
+    return q;
 }
 
-MsgTask::MsgTask(LocThread::tCreate tCreator,
-                 const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(tCreator, threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
+/***************************LocMsgPool methods***************************/
+
+// Block sizes of the pool size classes, header included. They are picked to
+// fit the queue envelopes (<64) and the high rate report messages, e.g.
+// position (<1K), SV (~2K) and measurements (~10K). Anything bigger is always
+// allocated from the heap.
+static const size_t LOC_MSG_POOL_BLOCK_SIZES[] = { 64, 256, 1024, 4096, 16384 };
+#define LOC_MSG_POOL_CLASSES \
+    (sizeof(LOC_MSG_POOL_BLOCK_SIZES) / sizeof(LOC_MSG_POOL_BLOCK_SIZES[0]))
+// number of free blocks kept per size class; the rest go back to the heap
+#define LOC_MSG_POOL_MAX_FREE 16
+
+// header in front of every LocMsg obj
+union LocMsgHeader {
+    struct {
+        // NULL if the block does not belong to any pool
+        LocMsgPool* pool;
+        uint32_t sizeClass;
+    } info;
+    max_align_t align;
+};
+
+// Per MsgTask free lists of LocMsg sized blocks. Blocks are allocated in the
+// sender's thread and freed in the MsgTask thread, so each size class has
+// its own mutex. The pool is ref counted by the owning MsgTask and by every
+// block handed out, so that messages still in flight when the MsgTask goes
+// away can still be safely deleted.
+class LocMsgPool {
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+    struct SizeClass {
+        pthread_mutex_t mutex;
+        FreeBlock* freeList;
+        uint32_t freeCount;
+        uint64_t hits;
+        uint64_t misses;
+    };
+    SizeClass mClasses[LOC_MSG_POOL_CLASSES];
+    int32_t mRefs;
+    ~LocMsgPool();
+    inline void drop() {
+        if (1 == __atomic_fetch_sub(&mRefs, 1, __ATOMIC_ACQ_REL)) {
+            delete this;
+        }
+    }
+public:
+    LocMsgPool();
+    void* alloc(size_t size);
+    void free(LocMsgHeader* header);
+    // called by the owning MsgTask when it goes away
+    inline void release() { drop(); }
+    void getStats(LocMsgPoolStats& stats);
+};
+
+LocMsgPool::LocMsgPool() : mRefs(1) {
+    for (size_t i = 0; i < LOC_MSG_POOL_CLASSES; i++) {
+        pthread_mutex_init(&mClasses[i].mutex, NULL);
+        mClasses[i].freeList = NULL;
+        mClasses[i].freeCount = 0;
+        mClasses[i].hits = 0;
+        mClasses[i].misses = 0;
     }
 }
 
-MsgTask::MsgTask(const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
+LocMsgPool::~LocMsgPool() {
+    for (size_t i = 0; i < LOC_MSG_POOL_CLASSES; i++) {
+        while (mClasses[i].freeList) {
+            FreeBlock* block = mClasses[i].freeList;
+            mClasses[i].freeList = block->next;
+            ::operator delete(block);
+        }
+        pthread_mutex_destroy(&mClasses[i].mutex);
+    }
+}
+
+void* LocMsgPool::alloc(size_t size) {
+    size_t blockSize = size + sizeof(LocMsgHeader);
+    uint32_t i = 0;
+    while (i < LOC_MSG_POOL_CLASSES && LOC_MSG_POOL_BLOCK_SIZES[i] < blockSize) {
+        i++;
+    }
+
+    LocMsgHeader* header = NULL;
+    if (i < LOC_MSG_POOL_CLASSES) {
+        SizeClass& sizeClass = mClasses[i];
+        pthread_mutex_lock(&sizeClass.mutex);
+        if (sizeClass.freeList) {
+            header = (LocMsgHeader*)sizeClass.freeList;
+            sizeClass.freeList = sizeClass.freeList->next;
+            sizeClass.freeCount--;
+            sizeClass.hits++;
+        } else {
+            sizeClass.misses++;
+        }
+        pthread_mutex_unlock(&sizeClass.mutex);
+
+        if (NULL == header) {
+            header = (LocMsgHeader*)::operator new(LOC_MSG_POOL_BLOCK_SIZES[i],
+                                                   std::nothrow);
+        }
+        if (NULL != header) {
+            __atomic_fetch_add(&mRefs, 1, __ATOMIC_RELAXED);
+            header->info.pool = this;
+            header->info.sizeClass = i;
+        }
+    } else {
+        // too big for any size class; count as a miss of the biggest class
+        SizeClass& sizeClass = mClasses[LOC_MSG_POOL_CLASSES - 1];
+        pthread_mutex_lock(&sizeClass.mutex);
+        sizeClass.misses++;
+        pthread_mutex_unlock(&sizeClass.mutex);
+
+        header = (LocMsgHeader*)::operator new(blockSize, std::nothrow);
+        if (NULL != header) {
+            header->info.pool = NULL;
+            header->info.sizeClass = 0;
+        }
+    }
+
+    return (NULL == header) ? NULL : (void*)(header + 1);
+}
+
+void LocMsgPool::free(LocMsgHeader* header) {
+    SizeClass& sizeClass = mClasses[header->info.sizeClass];
+    FreeBlock* block = (FreeBlock*)header;
+
+    pthread_mutex_lock(&sizeClass.mutex);
+    if (sizeClass.freeCount < LOC_MSG_POOL_MAX_FREE) {
+        block->next = sizeClass.freeList;
+        sizeClass.freeList = block;
+        sizeClass.freeCount++;
+        block = NULL;
+    }
+    pthread_mutex_unlock(&sizeClass.mutex);
+
+    if (NULL != block) {
+        ::operator delete(block);
+    }
+    drop();
+}
+
+void LocMsgPool::getStats(LocMsgPoolStats& stats) {
+    stats.hits = 0;
+    stats.misses = 0;
+    for (size_t i = 0; i < LOC_MSG_POOL_CLASSES; i++) {
+        pthread_mutex_lock(&mClasses[i].mutex);
+        stats.hits += mClasses[i].hits;
+        stats.misses += mClasses[i].misses;
+        pthread_mutex_unlock(&mClasses[i].mutex);
+    }
+}
+
+// frees a block of LocMsgPool::alloc() or LocMsg::operator new
+static void LocMsgBlockFree(void* ptr) {
+    if (NULL != ptr) {
+        LocMsgHeader* header = (LocMsgHeader*)ptr - 1;
+        if (NULL != header->info.pool) {
+            header->info.pool->free(header);
+        } else {
+            ::operator delete(header);
+        }
+    }
+}
+
+// What MsgTask::sendMsg() puts in the msg_q for a msg. It keeps what MsgTask
+// needs to know of a queued msg out of the LocMsg obj, whose layout is shared
+// with code built against older versions of this header. Allocated from the
+// pool of mTask.
+struct LocMsgEnvelope {
+    const LocMsg* mMsg;
+    // the MsgTask the msg was sent to
+    const MsgTask* mTask;
+    // CLOCK_MONOTONIC time, in ns, MsgTask::sendMsg() was called
+    uint64_t mSendTimeNs;
+    // see MsgTask::sendMsg(); NULL if the msg is not to be coalesced
+    const void* mCoalesceKey;
+};
+
+/***************************LocMsg methods***************************/
+
+void* LocMsg::operator new(size_t size) {
+    LocMsgHeader* header = (LocMsgHeader*)::operator new(size + sizeof(LocMsgHeader));
+    header->info.pool = NULL;
+    header->info.sizeClass = 0;
+    return header + 1;
+}
+
+void* LocMsg::operator new(size_t size, const std::nothrow_t&) noexcept {
+    LocMsgHeader* header =
+        (LocMsgHeader*)::operator new(size + sizeof(LocMsgHeader), std::nothrow);
+    if (NULL == header) {
+        return NULL;
+    }
+    header->info.pool = NULL;
+    header->info.sizeClass = 0;
+    return header + 1;
+}
+
+void* LocMsg::operator new(size_t size, const MsgTask& msgTask) noexcept {
+    return msgTask.mPool->alloc(size);
+}
+
+void LocMsg::operator delete(void* ptr) {
+    LocMsgBlockFree(ptr);
+}
+
+void LocMsg::operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    LocMsg::operator delete(ptr);
+}
+
+void LocMsg::operator delete(void* ptr, const MsgTask&) {
+    LocMsg::operator delete(ptr);
+}
+
+/***************************LocMsgCoalescer methods***************************/
+
+// most coalesce keys that can have a msg queued at a time; msgs of any
+// further keys are queued as is
+#define LOC_MSG_COALESCE_SLOTS 8
+
+// Keeps track of the queued envelopes sent with a coalesce key. A msg sent
+// with the key of a queued envelope takes the place of the envelope's msg,
+// which is deleted; the msg goes into the msg_q only if its key has no
+// envelope queued. The envelope of a slot may be written by senders until
+// it is detached from its slot.
+class LocMsgCoalescer {
+    struct Slot {
+        // NULL for a free slot
+        const void* mKey;
+        LocMsgEnvelope* mQueued;
+    };
+    pthread_mutex_t mMutex;
+    Slot mSlots[LOC_MSG_COALESCE_SLOTS];
+public:
+    inline LocMsgCoalescer() {
+        pthread_mutex_init(&mMutex, NULL);
+        memset(mSlots, 0, sizeof(mSlots));
+    }
+    inline ~LocMsgCoalescer() { pthread_mutex_destroy(&mMutex); }
+    // returns true if the msg of env has replaced the msg of a queued
+    // envelope, in which case the caller frees env; false if env has to be
+    // queued by the caller.
+    bool replace(LocMsgEnvelope* env);
+    // env is out of the msg_q, processed or not, and must not be written by
+    // senders any more
+    void detach(LocMsgEnvelope* env);
+    // msgs sent with key from now on are queued after what is queued now
+    void close(const void* key);
+};
+
+bool LocMsgCoalescer::replace(LocMsgEnvelope* env) {
+    const LocMsg* superseded = NULL;
+    Slot* freeSlot = NULL;
+
+    pthread_mutex_lock(&mMutex);
+    for (uint32_t i = 0; i < LOC_MSG_COALESCE_SLOTS; i++) {
+        Slot& slot = mSlots[i];
+        if (slot.mKey == env->mCoalesceKey) {
+            superseded = slot.mQueued->mMsg;
+            slot.mQueued->mMsg = env->mMsg;
+            slot.mQueued->mSendTimeNs = env->mSendTimeNs;
+            break;
+        } else if (NULL == slot.mKey && NULL == freeSlot) {
+            freeSlot = &slot;
+        }
+    }
+    if (NULL == superseded && NULL != freeSlot) {
+        freeSlot->mKey = env->mCoalesceKey;
+        freeSlot->mQueued = env;
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    if (superseded) {
+        LOC_LOGV("%s: msg %p superseded by %p", __func__, superseded, env->mMsg);
+        delete superseded;
+    }
+    return NULL != superseded;
+}
+
+void LocMsgCoalescer::detach(LocMsgEnvelope* env) {
+    pthread_mutex_lock(&mMutex);
+    for (uint32_t i = 0; i < LOC_MSG_COALESCE_SLOTS; i++) {
+        if (mSlots[i].mQueued == env) {
+            mSlots[i].mKey = NULL;
+            mSlots[i].mQueued = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void LocMsgCoalescer::close(const void* key) {
+    pthread_mutex_lock(&mMutex);
+    for (uint32_t i = 0; i < LOC_MSG_COALESCE_SLOTS; i++) {
+        if (mSlots[i].mKey == key) {
+            mSlots[i].mKey = NULL;
+            mSlots[i].mQueued = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+/***************************LocMsgStats methods***************************/
+
+// Number of message types LocMsgStats keeps apart; msgs of any further
+// types are only counted.
+#define LOC_MSG_STATS_TYPES 64
+// Histogram bucket 0 counts durations under 1 us, bucket n durations of
+// [2^(n-1), 2^n) us; the last bucket takes everything longer.
+#define LOC_MSG_STATS_BUCKETS 24
+
+static inline uint64_t LocMsgNowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Names of the message types, by vtable address, for all MsgTasks; see
+// MsgTask::nameMsgType(). Slots are claimed, never freed.
+struct LocMsgTypeName {
+    // the vtable address of the message type; NULL for a free slot
+    const void* mKey;
+    const char* mName;
+};
+static LocMsgTypeName sLocMsgTypeNames[LOC_MSG_STATS_TYPES];
+
+static inline uint32_t LocMsgTypeHash(const void* key) {
+    return ((uintptr_t)key >> 4) % LOC_MSG_STATS_TYPES;
+}
+
+// returns NULL if the type of key has not been named
+static const char* LocMsgTypeNameFind(const void* key) {
+    uint32_t i = LocMsgTypeHash(key);
+    for (uint32_t probes = 0; probes < LOC_MSG_STATS_TYPES; probes++) {
+        const void* typeKey = __atomic_load_n(&sLocMsgTypeNames[i].mKey, __ATOMIC_ACQUIRE);
+        if (typeKey == key) {
+            return __atomic_load_n(&sLocMsgTypeNames[i].mName, __ATOMIC_ACQUIRE);
+        } else if (NULL == typeKey) {
+            break;
+        }
+        i = (i + 1) % LOC_MSG_STATS_TYPES;
     }
+    return NULL;
+}
+
+// Histograms of queue wait and proc() time, per message type. Only the
+// MsgTask thread records, so recording is a hash probe and two increments;
+// logging from another thread may read slightly stale counts.
+class LocMsgStats {
+    struct Type {
+        // the vtable address of the message type; NULL for a free slot
+        const void* mKey;
+        uint32_t mWait[LOC_MSG_STATS_BUCKETS];
+        uint32_t mService[LOC_MSG_STATS_BUCKETS];
+    };
+    Type mTypes[LOC_MSG_STATS_TYPES];
+    uint32_t mUntracked;
+    static inline uint32_t bucket(uint64_t ns) {
+        uint64_t us = ns / 1000;
+        uint32_t i = (0 == us) ? 0 : (64 - __builtin_clzll(us));
+        return (i < LOC_MSG_STATS_BUCKETS) ? i : (LOC_MSG_STATS_BUCKETS - 1);
+    }
+    static uint32_t percentile(const uint32_t* buckets, uint32_t count, uint32_t pct);
+public:
+    inline LocMsgStats() : mUntracked(0) { memset(mTypes, 0, sizeof(mTypes)); }
+    void record(const void* key, uint64_t waitNs, uint64_t serviceNs);
+    uint32_t get(LocMsgTypeStats* stats, uint32_t maxCount) const;
+    void log() const;
+};
+
+void LocMsgStats::record(const void* key, uint64_t waitNs, uint64_t serviceNs) {
+    uint32_t i = LocMsgTypeHash(key);
+    for (uint32_t probes = 0; probes < LOC_MSG_STATS_TYPES; probes++) {
+        Type& type = mTypes[i];
+        const void* typeKey = __atomic_load_n(&type.mKey, __ATOMIC_RELAXED);
+        if (NULL == typeKey) {
+            __atomic_store_n(&type.mKey, key, __ATOMIC_RELEASE);
+            typeKey = key;
+        }
+        if (typeKey == key) {
+            type.mWait[bucket(waitNs)]++;
+            type.mService[bucket(serviceNs)]++;
+            return;
+        }
+        i = (i + 1) % LOC_MSG_STATS_TYPES;
+    }
+    mUntracked++;
+}
+
+// upper bound, in us, of the bucket that holds the pct percentile
+uint32_t LocMsgStats::percentile(const uint32_t* buckets, uint32_t count, uint32_t pct) {
+    uint64_t rank = ((uint64_t)count * pct + 99) / 100;
+    uint64_t seen = 0;
+    uint32_t i = 0;
+    for (; i < LOC_MSG_STATS_BUCKETS - 1; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    return 1u << i;
+}
+
+uint32_t LocMsgStats::get(LocMsgTypeStats* stats, uint32_t maxCount) const {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < LOC_MSG_STATS_TYPES && n < maxCount; i++) {
+        const Type& type = mTypes[i];
+        const void* key = __atomic_load_n(&type.mKey, __ATOMIC_ACQUIRE);
+        if (NULL == key) {
+            continue;
+        }
+        uint32_t wait[LOC_MSG_STATS_BUCKETS];
+        uint32_t service[LOC_MSG_STATS_BUCKETS];
+        uint32_t count = 0;
+        for (uint32_t j = 0; j < LOC_MSG_STATS_BUCKETS; j++) {
+            wait[j] = type.mWait[j];
+            service[j] = type.mService[j];
+            count += wait[j];
+        }
+        LocMsgTypeStats& typeStats = stats[n++];
+        const char* typeName = LocMsgTypeNameFind(key);
+        if (NULL != typeName) {
+            strlcpy(typeStats.name, typeName, sizeof(typeStats.name));
+        } else {
+            snprintf(typeStats.name, sizeof(typeStats.name), "%p", key);
+        }
+        typeStats.count = count;
+        typeStats.waitP50Us = percentile(wait, count, 50);
+        typeStats.waitP99Us = percentile(wait, count, 99);
+        typeStats.waitMaxUs = percentile(wait, count, 100);
+        typeStats.procP50Us = percentile(service, count, 50);
+        typeStats.procP99Us = percentile(service, count, 99);
+        typeStats.procMaxUs = percentile(service, count, 100);
+    }
+    return n;
+}
+
+void LocMsgStats::log() const {
+    LocMsgTypeStats stats[LOC_MSG_STATS_TYPES];
+    uint32_t n = get(stats, LOC_MSG_STATS_TYPES);
+    for (uint32_t i = 0; i < n; i++) {
+        LOC_LOGD("%s: %s count %u wait(us) p50<%u p99<%u max<%u"
+                 " proc(us) p50<%u p99<%u max<%u", __func__, stats[i].name, stats[i].count,
+                 stats[i].waitP50Us, stats[i].waitP99Us, stats[i].waitMaxUs,
+                 stats[i].procP50Us, stats[i].procP99Us, stats[i].procMaxUs);
+    }
+    if (mUntracked > 0) {
+        LOC_LOGD("%s: %u msgs of untracked types", __func__, mUntracked);
+    }
+}
+
+/***************************LocMsgStrand methods***************************/
+
+// Runs the msgs of a MsgTask on the LocExecutor, in place of a thread of its
+// own. mPosts counts the sendMsg() and destroy() calls since the strand was
+// last idle. Only whoever moves it off 0 schedules the strand, so the strand
+// is queued or running on at most one worker at any time. The worker only
+// lets the strand go idle if nothing was posted while it ran, so that no
+// msg is left behind in the msg_q; msgs dropped by the msg_q do not upset
+// this, as mPosts is not a count of queued msgs.
+class LocMsgStrand : public LocRunnable {
+    MsgTask* mTask;
+    LocExecutor& mExecutor;
+    uint32_t mPosts;
+    bool mDestroyed;
+public:
+    inline LocMsgStrand(MsgTask* task, LocExecutor& executor) :
+        mTask(task), mExecutor(executor), mPosts(0), mDestroyed(false) {}
+    inline void schedule() { mExecutor.schedule(this); }
+    // returns true if the strand was idle, i.e. the caller must schedule it
+    inline bool post() {
+        return 0 == __atomic_fetch_add(&mPosts, 1, __ATOMIC_ACQ_REL);
+    }
+    inline uint32_t getPosts() { return __atomic_load_n(&mPosts, __ATOMIC_ACQUIRE); }
+    // returns true if the strand went idle, i.e. nothing was posted since
+    // getPosts() returned posts. The caller must not touch this obj after.
+    inline bool idle(uint32_t posts) {
+        return __atomic_compare_exchange_n(&mPosts, &posts, 0, false,
+                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+    inline void setDestroyed() { __atomic_store_n(&mDestroyed, true, __ATOMIC_RELEASE); }
+    inline bool isDestroyed() { return __atomic_load_n(&mDestroyed, __ATOMIC_ACQUIRE); }
+    // mTask may delete itself, and this obj with it, so nothing must be
+    // touched after runStrand() returns
+    inline virtual bool run() { return mTask->runStrand(); }
+};
+
+/***************************MsgTask methods***************************/
+
+MsgTask::MsgTask(LocThread::tCreate tCreator, const char* threadName, bool joinable) :
+    MsgTask(tCreator, threadName, joinable, 0) {
+}
+
+MsgTask::MsgTask(const char* threadName, bool joinable) :
+    MsgTask(threadName, joinable, 0) {
+}
+
+MsgTask::MsgTask(LocThread::tCreate tCreator, const char* threadName, bool joinable,
+                 uint32_t ringSize, uint32_t capacity, OverflowPolicy overflowPolicy) :
+    mQ(LocMsgQCreate(ringSize, capacity, overflowPolicy)), mThread(NULL), mPool(new LocMsgPool()),
+    mCoalescer(new LocMsgCoalescer()), mStats(new LocMsgStats()), mStrand(NULL) {
+    startThread(tCreator, threadName, joinable);
+}
+
+MsgTask::MsgTask(const char* threadName, bool joinable, uint32_t ringSize,
+                 uint32_t capacity, OverflowPolicy overflowPolicy) :
+    mQ(LocMsgQCreate(ringSize, capacity, overflowPolicy)), mThread(NULL), mPool(new LocMsgPool()),
+    mCoalescer(new LocMsgCoalescer()), mStats(new LocMsgStats()), mStrand(NULL) {
+    startThread(NULL, threadName, joinable);
+}
+
+MsgTask::MsgTask(LocExecutor& executor, uint32_t ringSize, uint32_t capacity,
+                 OverflowPolicy overflowPolicy) :
+    mQ(LocMsgQCreate(ringSize, capacity, overflowPolicy)), mThread(NULL), mPool(new LocMsgPool()),
+    mCoalescer(new LocMsgCoalescer()), mStats(new LocMsgStats()),
+    mStrand(new LocMsgStrand(this, executor)) {
 }
 
 MsgTask::~MsgTask() {
     msg_q_flush((void*)mQ);
     msg_q_destroy((void**)&mQ);
+    delete mCoalescer;
+    delete mStats;
+    delete mStrand;
+    mPool->release();
+}
+
+// dealloc function of the envelopes in the msg_q, for the ones it drops or
+// flushes
+void MsgTask::destroyMsg(void* envelope) {
+    LocMsgEnvelope* env = (LocMsgEnvelope*)envelope;
+    if (NULL != env->mCoalesceKey) {
+        env->mTask->mCoalescer->detach(env);
+    }
+    const LocMsg* msg = env->mMsg;
+    LocMsgBlockFree(env);
+    delete msg;
+}
+
+void MsgTask::startThread(LocThread::tCreate tCreator, const char* threadName,
+                          bool joinable) {
+    mThread = new LocThread();
+    if (!mThread->start(tCreator, threadName, this, joinable)) {
+        delete mThread;
+        mThread = NULL;
+    }
 }
 
 void MsgTask::destroy() {
-    LocThread* thread = mThread;
+    if (mStrand) {
+        mStrand->setDestroyed();
+        if (mStrand->post()) {
+            // the strand is idle and, with mPosts off 0, stays so
+            msg_q_unblock((void*)mQ);
+            delete this;
+        } else {
+            // the strand is queued or running; the worker deletes this obj
+            // once it finds the msg_q unblocked
+            msg_q_unblock((void*)mQ);
+        }
+        return;
+    }
+
+    // once unblocked, the thread may exit run() and delete this obj, so
+    // this obj must not be touched after msg_q_unblock() if thread exists.
+    // procBatch() reads mThread in the thread, hence the atomic.
+    LocThread* thread = __atomic_exchange_n(&mThread, (LocThread*)NULL, __ATOMIC_ACQ_REL);
     msg_q_unblock((void*)mQ);
     if (thread) {
-        mThread = NULL;
         delete thread;
     } else {
         delete this;
@@ -74,32 +642,271 @@ void MsgTask::destroy() {
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
+    sendMsg(msg, PRIORITY_CONTROL);
+}
+
+void MsgTask::sendMsg(const LocMsg* msg, Priority priority) const {
+    sendMsg(msg, priority, NULL);
+}
+
+void MsgTask::sendMsg(const LocMsg* msg, Priority priority, const void* coalesceKey) const {
     if (msg) {
-        msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+        LocMsgEnvelope* env = (LocMsgEnvelope*)mPool->alloc(sizeof(LocMsgEnvelope));
+        if (NULL == env) {
+            LOC_LOGE("%s: no memory to queue msg %p", __func__, msg);
+            delete msg;
+            return;
+        }
+        env->mMsg = msg;
+        env->mTask = this;
+        env->mSendTimeNs = LocMsgNowNs();
+        env->mCoalesceKey = coalesceKey;
+        if (NULL != coalesceKey && mCoalescer->replace(env)) {
+            LocMsgBlockFree(env);
+        } else {
+            msq_q_err_type result =
+                    msg_q_snd_prio((void*)mQ, env, destroyMsg,
+                                   (PRIORITY_TELEMETRY == priority) ?
+                                   eMSG_Q_LANE_TELEMETRY : eMSG_Q_LANE_CONTROL);
+            if (eMSG_Q_SUCCESS != result) {
+                // rejected, or the queue is being destroyed; either way
+                // the msg is still ours
+                LOC_LOGV("%s: msg %p not queued: %s", __func__, msg,
+                         loc_get_msg_q_status(result));
+                destroyMsg(env);
+            } else if (mStrand && mStrand->post()) {
+                mStrand->schedule();
+            }
+        }
     } else {
         LOC_LOGE("%s: msg is NULL", __func__);
     }
 }
 
+void MsgTask::closeCoalescing(const void* coalesceKey) const {
+    mCoalescer->close(coalesceKey);
+}
+
+void MsgTask::getPoolStats(LocMsgPoolStats& stats) const {
+    mPool->getStats(stats);
+}
+
+uint32_t MsgTask::getMsgTypeStats(LocMsgTypeStats* stats, uint32_t maxCount) const {
+    return mStats->get(stats, maxCount);
+}
+
+void MsgTask::logMsgStats() const {
+    mStats->log();
+}
+
+void MsgTask::nameMsgType(const LocMsg* msg, const char* name) {
+    if (NULL == msg) {
+        return;
+    }
+    const void* key = *(const void* const*)msg;
+    uint32_t i = LocMsgTypeHash(key);
+    for (uint32_t probes = 0; probes < LOC_MSG_STATS_TYPES; probes++) {
+        LocMsgTypeName& typeName = sLocMsgTypeNames[i];
+        const void* typeKey = __atomic_load_n(&typeName.mKey, __ATOMIC_ACQUIRE);
+        if (NULL == typeKey &&
+                __atomic_compare_exchange_n(&typeName.mKey, &typeKey, key, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            // LocMsgTypeNameFind() may see the slot before its name, and
+            // then just prints the vtable address
+            __atomic_store_n(&typeName.mName, name, __ATOMIC_RELEASE);
+            return;
+        }
+        // the common case: the type was named by an earlier send
+        if (typeKey == key) {
+            return;
+        }
+        i = (i + 1) % LOC_MSG_STATS_TYPES;
+    }
+}
+
+void MsgTask::getLaneStats(Priority priority, LocMsgLaneStats& stats) const {
+    msg_q_lane_stats laneStats = {};
+    msg_q_get_lane_stats((void*)mQ, (PRIORITY_TELEMETRY == priority) ?
+                         eMSG_Q_LANE_TELEMETRY : eMSG_Q_LANE_CONTROL, &laneStats);
+    stats.depth = laneStats.depth;
+    stats.maxDepth = laneStats.max_depth;
+    stats.total = laneStats.total;
+    stats.dropped = laneStats.dropped;
+    stats.rejected = laneStats.rejected;
+    stats.blocked = laneStats.blocked;
+}
+
 void MsgTask::prerun() {
     // make sure we do not run in background scheduling group
      set_sched_policy(gettid(), SP_FOREGROUND);
 }
 
 bool MsgTask::run() {
-    LocMsg* msg;
-    msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+    void* msgs[MSG_TASK_BATCH_SIZE];
+    uint32_t count = 0;
+    msq_q_err_type result = msg_q_rcv_batch((void*)mQ, msgs, MSG_TASK_BATCH_SIZE, &count);
     if (eMSG_Q_SUCCESS != result) {
         LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
                  loc_get_msg_q_status(result));
         return false;
     }
 
+    procBatch(msgs, count);
+
+    return true;
+}
+
+bool MsgTask::runStrand() {
+    void* msgs[MSG_TASK_BATCH_SIZE];
+    uint32_t count = 0;
+    uint32_t posts = mStrand->getPosts();
+    msq_q_err_type result = msg_q_try_rcv_batch((void*)mQ, msgs, MSG_TASK_BATCH_SIZE, &count);
+    if (eMSG_Q_SUCCESS != result) {
+        if (mStrand->isDestroyed()) {
+            // destroy() has left it to us to delete this obj
+            delete this;
+        } else {
+            LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
+                     loc_get_msg_q_status(result));
+        }
+        return false;
+    }
+
+    procBatch(msgs, count);
+
+    // One batch per turn, so that a busy strand does not hog the worker.
+    // Once destroyed, the strand keeps its turns until it finds the msg_q
+    // unblocked.
+    return (MSG_TASK_BATCH_SIZE == count || mStrand->isDestroyed() ||
+            !mStrand->idle(posts));
+}
+
+void MsgTask::procBatch(void** msgs, uint32_t count) const {
+    // one clock read per msg: the end of one proc() is the start of the next
+    uint64_t nowNs = LocMsgNowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        // Like msg_q_flush() would have, drop the rest of the batch rather
+        // than process it after destroy(), which NULLs mThread.
+        if ((NULL != mStrand) ? !mStrand->isDestroyed() :
+                (NULL != __atomic_load_n(&mThread, __ATOMIC_ACQUIRE))) {
+            procMsg(msgs[i], nowNs);
+        } else {
+            destroyMsg(msgs[i]);
+        }
+    }
+}
+
+void MsgTask::procMsg(void* envelope, uint64_t& nowNs) const {
+    LocMsgEnvelope* env = (LocMsgEnvelope*)envelope;
+    if (NULL != env->mCoalesceKey) {
+        mCoalescer->detach(env);
+    }
+    LocMsg* msg = (LocMsg*)env->mMsg;
+    uint64_t sendTimeNs = env->mSendTimeNs;
+    LocMsgBlockFree(env);
+
+    // without RTTI, the vtable address is what tells the message types apart
+    const void* type = *(const void* const*)msg;
+    uint64_t startNs = nowNs;
+
     msg->log();
     // there is where each individual msg handling is invoked
     msg->proc();
 
+    nowNs = LocMsgNowNs();
+    mStats->record(type, (startNs > sendTimeNs) ? (startNs - sendTimeNs) : 0,
+                   nowNs - startNs);
+
     delete msg;
+}
 
-    return true;
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+
+struct LocMsgBench : public LocMsg {
+    uint64_t* mSum;
+    uint32_t mValue;
+    inline LocMsgBench(uint64_t* sum, uint32_t value) : mSum(sum), mValue(value) {}
+    inline virtual void proc() const { *mSum += mValue; }
+};
+
+static void MsgQBenchDestroy(void* msg) {
+    delete (LocMsg*)msg;
+}
+
+struct MsgQBenchArgs {
+    void* mQ;
+    uint32_t mCount;
+};
+
+static void* MsgQBenchProducer(void* arg) {
+    MsgQBenchArgs* args = (MsgQBenchArgs*)arg;
+    static uint64_t sum = 0;
+    for (uint32_t i = 0; i < args->mCount; i++) {
+        msg_q_snd(args->mQ, new LocMsgBench(&sum, i), MsgQBenchDestroy);
+    }
+    return NULL;
+}
+
+static double MsgQBenchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// receives and processes count msgs from a producer thread, one msg_q_rcv()
+// per msg if batch is false, else as MsgTask::run() does; returns msgs/sec
+static double MsgQBench(bool ring, bool batch, uint32_t count) {
+    void* q = NULL;
+    if (ring) {
+        msg_q_init_ring(&q, 1024);
+    } else {
+        msg_q_init(&q);
+    }
+    MsgQBenchArgs args = { q, count };
+    pthread_t producer;
+    double start = MsgQBenchNow();
+    pthread_create(&producer, NULL, MsgQBenchProducer, &args);
+
+    uint32_t received = 0;
+    while (received < count) {
+        void* msgs[MSG_TASK_BATCH_SIZE];
+        uint32_t n = 1;
+        if (batch) {
+            msg_q_rcv_batch(q, msgs, MSG_TASK_BATCH_SIZE, &n);
+        } else {
+            msg_q_rcv(q, &msgs[0]);
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            LocMsg* msg = (LocMsg*)msgs[i];
+            msg->log();
+            msg->proc();
+            delete msg;
+        }
+        received += n;
+    }
+
+    double elapsed = MsgQBenchNow() - start;
+    pthread_join(producer, NULL);
+    msg_q_destroy(&q);
+    return count / elapsed;
 }
+
+// on linux command line:
+// build: make check, for msg_task_bench, linked with libgps_utils
+// test: ./msg_task_bench [number of msgs, 1000000 by default]
+int main(int argc, char** argv) {
+    uint32_t count = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+    for (int ring = 0; ring <= 1; ring++) {
+        double single = MsgQBench(ring, false, count);
+        double batch = MsgQBench(ring, true, count);
+        printf("%s: single %.0f msgs/sec, batch %.0f msgs/sec\n",
+               ring ? "ring" : "list", single, batch);
+    }
+
+    return 0;
+}
+
+#endif
@@ -29,27 +29,161 @@
 #ifndef __MSG_TASK__
 #define __MSG_TASK__
 
+#include <stdint.h>
+#include <new>
 #include <LocThread.h>
 
+class MsgTask;
+class LocExecutor;
+
 struct LocMsg {
     inline LocMsg() {}
     inline virtual ~LocMsg() {}
     virtual void proc() const = 0;
     inline virtual void log() const {}
+
+    // Every LocMsg obj is allocated with a small header in front of it,
+    // which tells operator delete whether the memory goes back to the
+    // pool of a MsgTask or to the heap.
+    static void* operator new(size_t size);
+    static void* operator new(size_t size, const std::nothrow_t&) noexcept;
+    // new (msgTask) LocMsgXxx(...) allocates from the pool of msgTask, so
+    // that high rate messages stop hitting the heap once the pool has warmed
+    // up. Returns NULL only if the heap is exhausted.
+    static void* operator new(size_t size, const MsgTask& msgTask) noexcept;
+    static void operator delete(void* ptr);
+    static void operator delete(void* ptr, const std::nothrow_t&) noexcept;
+    static void operator delete(void* ptr, const MsgTask& msgTask);
 };
 
+// counters of the LocMsg pool of a MsgTask
+struct LocMsgPoolStats {
+    // allocations served from a free block of the pool
+    uint64_t hits;
+    // allocations that had to go to the heap
+    uint64_t misses;
+};
+
+// depth counters of one priority lane of a MsgTask queue
+struct LocMsgLaneStats {
+    // messages currently waiting in the lane
+    uint32_t depth;
+    // highest number of messages seen waiting in the lane
+    uint32_t maxDepth;
+    // messages sent to the lane so far
+    uint64_t total;
+    // messages of the lane dropped to make room for newer ones
+    uint64_t dropped;
+    // messages for the lane rejected, and deleted, for lack of room
+    uint64_t rejected;
+    // sends to the lane that had to wait for room
+    uint64_t blocked;
+};
+
+// queue wait and proc() times of the msgs of one type; each time is the
+// upper bound, in us, of the histogram bucket that holds the percentile
+struct LocMsgTypeStats {
+    // as named by MsgTask::nameMsgType(), else the address of its vtable
+    char name[32];
+    // msgs of the type processed so far
+    uint32_t count;
+    uint32_t waitP50Us;
+    uint32_t waitP99Us;
+    uint32_t waitMaxUs;
+    uint32_t procP50Us;
+    uint32_t procP99Us;
+    uint32_t procMaxUs;
+};
+
+// opaque classes to provide pool and coalescing implementation.
+class LocMsgPool;
+class LocMsgCoalescer;
+class LocMsgStats;
+class LocMsgStrand;
+
 class MsgTask : public LocRunnable {
     const void* mQ;
     LocThread* mThread;
+    LocMsgPool* mPool;
+    LocMsgCoalescer* mCoalescer;
+    LocMsgStats* mStats;
+    LocMsgStrand* mStrand;
     friend class LocThreadDelegate;
+    friend class LocMsgStrand;
+    friend struct LocMsg;
+    static void destroyMsg(void* envelope);
+    void startThread(LocThread::tCreate tCreator, const char* threadName, bool joinable);
+    void procBatch(void** msgs, uint32_t count) const;
+    void procMsg(void* envelope, uint64_t& nowNs) const;
+    bool runStrand();
 protected:
     virtual ~MsgTask();
 public:
+    // Lanes of the queue. CONTROL messages are processed ahead of any
+    // TELEMETRY messages that are waiting, except that one TELEMETRY
+    // message is let through after every burst of CONTROL messages, see
+    // msg_q_snd_prio(). Messages of the same priority keep their order.
+    enum Priority {
+        PRIORITY_CONTROL = 0,
+        PRIORITY_TELEMETRY,
+        PRIORITY_MAX
+    };
+    // What sendMsg() does with a msg while the queue holds capacity msgs,
+    // see msg_q_set_capacity(). A dropped or rejected msg is deleted.
+    enum OverflowPolicy {
+        // wait for room; the MsgTask must then never send msgs to itself
+        OVERFLOW_BLOCK = 0,
+        // drop the oldest TELEMETRY msg, if any, else queue a CONTROL msg
+        // over the capacity and reject a TELEMETRY one
+        OVERFLOW_DROP_OLDEST,
+        // reject the msg
+        OVERFLOW_REJECT
+    };
     MsgTask(LocThread::tCreate tCreator, const char* threadName = NULL, bool joinable = true);
     MsgTask(const char* threadName = NULL, bool joinable = true);
+    // Same as above, with a queue other than the default unbounded list.
+    // ringSize: 0 to queue messages in a mutex protected linked list;
+    //           otherwise the size of a lock-free ring to queue them in,
+    //           which overflows into the list, see msg_q_init_ring().
+    // capacity: 0 for no bound on the number of queued msgs; otherwise the
+    //           most msgs queued before overflowPolicy kicks in.
+    MsgTask(LocThread::tCreate tCreator, const char* threadName, bool joinable,
+            uint32_t ringSize, uint32_t capacity = 0,
+            OverflowPolicy overflowPolicy = OVERFLOW_BLOCK);
+    MsgTask(const char* threadName, bool joinable, uint32_t ringSize,
+            uint32_t capacity = 0, OverflowPolicy overflowPolicy = OVERFLOW_BLOCK);
+    // A MsgTask with no thread of its own; its messages are processed, in
+    // order and one at a time, by the workers of executor. proc() of such
+    // messages must not block.
+    MsgTask(LocExecutor& executor, uint32_t ringSize = 0, uint32_t capacity = 0,
+            OverflowPolicy overflowPolicy = OVERFLOW_BLOCK);
     // this obj will be deleted once thread is deleted
     void destroy();
     void sendMsg(const LocMsg* msg) const;
+    // same as sendMsg(msg), into the lane of the given priority
+    void sendMsg(const LocMsg* msg, Priority priority) const;
+    // Same as sendMsg(msg, priority), for msgs that carry nothing but the
+    // latest value of something, like a position or SV report. While a msg
+    // sent with the same coalesceKey is still queued, msg takes its place in
+    // the queue and the older msg is deleted without being processed. The
+    // key must be unique to the kind of msg and its receiver. NULL keeps the
+    // strict FIFO order.
+    void sendMsg(const LocMsg* msg, Priority priority, const void* coalesceKey) const;
+    // The msg queued with coalesceKey, if any, is no longer replaced; msgs
+    // sent with the key from now on queue up after it. Called ahead of
+    // sending a msg that must not be overtaken by later msgs of the key.
+    void closeCoalescing(const void* coalesceKey) const;
+    void getPoolStats(LocMsgPoolStats& stats) const;
+    void getLaneStats(Priority priority, LocMsgLaneStats& stats) const;
+    // fills in stats for up to maxCount of the message types seen so far,
+    // and returns how many it filled in
+    uint32_t getMsgTypeStats(LocMsgTypeStats* stats, uint32_t maxCount) const;
+    // logs what getMsgTypeStats() gets, for all message types
+    void logMsgStats() const;
+    // Names the type of msg in the per type stats, which otherwise show a
+    // message type as the address of its vtable. A name is kept once per
+    // type, so this is cheap enough to be called on every send.
+    static void nameMsgType(const LocMsg* msg, const char* name);
     // Overrides of LocRunnable methods
     // This method will be repeated called until it returns false; or
     // until thread is stopped.
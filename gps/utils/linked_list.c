@@ -36,18 +36,129 @@
 #include <loc_pla.h>
 #include <log_util.h>
 
+/* Elements are kept by value in fixed size chunks which are chained from the
+   oldest to the newest. Pushes go to the newest chunk and pops come from the
+   oldest one, so both are O(1) and a walk over the list touches contiguous
+   memory rather than one heap node per element. */
+#define LINKED_LIST_CHUNK_SIZE 64
+
 typedef struct list_element {
-   struct list_element* next;
-   struct list_element* prev;
    void* data_ptr;
    void (*dealloc_func)(void*);
 }list_element;
 
+typedef struct list_chunk {
+   struct list_chunk* next;
+   struct list_chunk* prev;
+   list_element elems[LINKED_LIST_CHUNK_SIZE];
+}list_chunk;
+
 typedef struct list_state {
-   list_element* p_head;
-   list_element* p_tail;
+   list_chunk* p_first;   /* chunk holding the oldest element */
+   list_chunk* p_last;    /* chunk holding the newest element */
+   uint32_t first_idx;    /* slot of the oldest element in p_first */
+   uint32_t last_idx;     /* slot past the newest element in p_last */
+   uint32_t count;
+   list_chunk* p_spare;   /* one retired chunk kept to avoid malloc churn */
 } list_state;
 
+/* ----------------------- INTERNAL FUNCTIONS ---------------------------------------- */
+
+static list_chunk* list_get_chunk(list_state* p_list)
+{
+   list_chunk* chunk = p_list->p_spare;
+   if( chunk != NULL )
+   {
+      p_list->p_spare = NULL;
+   }
+   else
+   {
+      chunk = (list_chunk*)malloc(sizeof(list_chunk));
+      if( chunk == NULL )
+      {
+         return NULL;
+      }
+   }
+   chunk->next = NULL;
+   chunk->prev = NULL;
+   return chunk;
+}
+
+static void list_put_chunk(list_state* p_list, list_chunk* chunk)
+{
+   if( p_list->p_spare == NULL )
+   {
+      p_list->p_spare = chunk;
+   }
+   else
+   {
+      free(chunk);
+   }
+}
+
+/* Makes (chunk, idx) the slot past the newest element after count elements
+   remain, and retires every chunk that is no longer in use. */
+static void list_set_end(list_state* p_list, list_chunk* chunk, uint32_t idx,
+                         uint32_t count)
+{
+   list_chunk* tmp = chunk->next;
+   chunk->next = NULL;
+   while( tmp != NULL )
+   {
+      list_chunk* next = tmp->next;
+      list_put_chunk(p_list, tmp);
+      tmp = next;
+   }
+
+   if( idx == 0 && chunk != p_list->p_first )
+   {
+      tmp = chunk;
+      chunk = chunk->prev;
+      chunk->next = NULL;
+      idx = LINKED_LIST_CHUNK_SIZE;
+      list_put_chunk(p_list, tmp);
+   }
+
+   p_list->p_last = chunk;
+   p_list->last_idx = idx;
+   p_list->count = count;
+
+   if( count == 0 )
+   {
+      p_list->first_idx = 0;
+      p_list->last_idx = 0;
+   }
+}
+
+/* Removes the element at (chunk, idx), shifting the newer elements down by
+   one slot so that the order of the remaining elements is kept. */
+static void list_remove_at(list_state* p_list, list_chunk* chunk, uint32_t idx)
+{
+   list_chunk* rd_chunk = chunk;
+   uint32_t rd_idx = idx + 1;
+
+   for( ;; )
+   {
+      if( rd_idx == LINKED_LIST_CHUNK_SIZE && rd_chunk != p_list->p_last )
+      {
+         rd_chunk = rd_chunk->next;
+         rd_idx = 0;
+      }
+      if( rd_chunk == p_list->p_last && rd_idx == p_list->last_idx )
+      {
+         break;
+      }
+      if( idx == LINKED_LIST_CHUNK_SIZE )
+      {
+         chunk = chunk->next;
+         idx = 0;
+      }
+      chunk->elems[idx++] = rd_chunk->elems[rd_idx++];
+   }
+
+   list_set_end(p_list, chunk, idx, p_list->count - 1);
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -71,8 +182,9 @@ linked_list_err_type linked_list_init(void** list_data)
       return eLINKED_LIST_FAILURE_GENERAL;
    }
 
-   tmp_list->p_head = NULL;
-   tmp_list->p_tail = NULL;
+   tmp_list->p_first = NULL;
+   tmp_list->p_last = NULL;
+   tmp_list->p_spare = NULL;
 
    *list_data = tmp_list;
 
@@ -96,6 +208,8 @@ linked_list_err_type linked_list_destroy(void** list_data)
 
    linked_list_flush(p_list);
 
+   free(p_list->p_first);
+   free(p_list->p_spare);
    free(*list_data);
    *list_data = NULL;
 
@@ -122,33 +236,34 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    }
 
    list_state* p_list = (list_state*)list_data;
-   list_element* elem = (list_element*)malloc(sizeof(list_element));
-   if( elem == NULL )
+   if( p_list->p_last == NULL || p_list->last_idx == LINKED_LIST_CHUNK_SIZE )
    {
-      LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
-      return eLINKED_LIST_FAILURE_GENERAL;
+      list_chunk* chunk = list_get_chunk(p_list);
+      if( chunk == NULL )
+      {
+         LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
+         return eLINKED_LIST_FAILURE_GENERAL;
+      }
+
+      if( p_list->p_last == NULL )
+      {
+         p_list->p_first = chunk;
+         p_list->first_idx = 0;
+      }
+      else
+      {
+         chunk->prev = p_list->p_last;
+         p_list->p_last->next = chunk;
+      }
+      p_list->p_last = chunk;
+      p_list->last_idx = 0;
    }
 
-   /* Copy data to newly created element */
+   /* Copy data to the slot past the newest element */
+   list_element* elem = &p_list->p_last->elems[p_list->last_idx++];
    elem->data_ptr = data_obj;
-   elem->next = NULL;
-   elem->prev = NULL;
    elem->dealloc_func = dealloc;
-
-   /* Replace head element */
-   list_element* tmp = p_list->p_head;
-   p_list->p_head = elem;
-   /* Point next to the previous head element */
-   p_list->p_head->next = tmp;
-
-   if( tmp != NULL )
-   {
-      tmp->prev = p_list->p_head;
-   }
-   else
-   {
-      p_list->p_tail = p_list->p_head;
-   }
+   p_list->count++;
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -159,6 +274,17 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
 
   ===========================================================================*/
 linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
+{
+   return linked_list_remove_dealloc(list_data, data_obj, NULL);
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_remove_dealloc
+
+  ===========================================================================*/
+linked_list_err_type linked_list_remove_dealloc(void* list_data, void **data_obj,
+                                                void (**dealloc)(void*))
 {
    if( list_data == NULL )
    {
@@ -173,31 +299,34 @@ linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
    }
 
    list_state* p_list = (list_state*)list_data;
-   if( p_list->p_tail == NULL )
+   if( p_list->count == 0 )
    {
       return eLINKED_LIST_UNAVAILABLE_RESOURCE;
    }
 
-   list_element* tmp = p_list->p_tail;
-
-   /* Replace tail element */
-   p_list->p_tail = tmp->prev;
+   /* Copy the oldest element to output param */
+   list_element* elem = &p_list->p_first->elems[p_list->first_idx++];
+   *data_obj = elem->data_ptr;
+   if( dealloc != NULL )
+   {
+      *dealloc = elem->dealloc_func;
+   }
 
-   if( p_list->p_tail != NULL )
+   if( --p_list->count == 0 )
    {
-      p_list->p_tail->next = NULL;
+      /* p_first is p_last here; keep it for the next add */
+      p_list->first_idx = 0;
+      p_list->last_idx = 0;
    }
-   else
+   else if( p_list->first_idx == LINKED_LIST_CHUNK_SIZE )
    {
-      p_list->p_head = p_list->p_tail;
+      list_chunk* tmp = p_list->p_first;
+      p_list->p_first = tmp->next;
+      p_list->p_first->prev = NULL;
+      p_list->first_idx = 0;
+      list_put_chunk(p_list, tmp);
    }
 
-   /* Copy data to output param */
-   *data_obj = tmp->data_ptr;
-
-   /* Free allocated list element */
-   free(tmp);
-
    return eLINKED_LIST_SUCCESS;
 }
 
@@ -216,7 +345,7 @@ int linked_list_empty(void* list_data)
    else
    {
       list_state* p_list = (list_state*)list_data;
-      return p_list->p_head == NULL ? 1 : 0;
+      return p_list->count == 0 ? 1 : 0;
    }
 }
 
@@ -234,25 +363,30 @@ linked_list_err_type linked_list_flush(void* list_data)
    }
 
    list_state* p_list = (list_state*)list_data;
-
-   /* Remove all dynamically allocated elements */
-   while( p_list->p_head != NULL )
+   if( p_list->p_first == NULL )
    {
-      list_element* tmp = p_list->p_head->next;
+      return eLINKED_LIST_SUCCESS;
+   }
 
-      /* Free data pointer if told to do so. */
-      if( p_list->p_head->dealloc_func != NULL )
+   /* Free data pointers if told to do so, oldest first */
+   list_chunk* chunk = p_list->p_first;
+   uint32_t idx = p_list->first_idx;
+   uint32_t n;
+   for( n = p_list->count; n > 0; n-- )
+   {
+      if( idx == LINKED_LIST_CHUNK_SIZE )
       {
-         p_list->p_head->dealloc_func(p_list->p_head->data_ptr);
+         chunk = chunk->next;
+         idx = 0;
+      }
+      list_element* elem = &chunk->elems[idx++];
+      if( elem->dealloc_func != NULL )
+      {
+         elem->dealloc_func(elem->data_ptr);
       }
-
-      /* Free list element */
-      free(p_list->p_head);
-
-      p_list->p_head = tmp;
    }
 
-   p_list->p_tail = NULL;
+   list_set_end(p_list, p_list->p_first, p_list->first_idx, 0);
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -274,52 +408,309 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
    }
 
    list_state* p_list = (list_state*)list_data;
-   if( p_list->p_tail == NULL )
+   if( p_list->count == 0 )
    {
       return eLINKED_LIST_UNAVAILABLE_RESOURCE;
    }
 
-   list_element* tmp = p_list->p_head;
-
    if (NULL != data_p) {
      *data_p = NULL;
    }
 
-   while (NULL != tmp) {
-     if ((*equal)(data_0, tmp->data_ptr)) {
+   /* Walk from the newest element to the oldest */
+   list_chunk* chunk = p_list->p_last;
+   uint32_t idx = p_list->last_idx;
+   uint32_t n;
+   for (n = p_list->count; n > 0; n--) {
+     if (0 == idx) {
+       chunk = chunk->prev;
+       idx = LINKED_LIST_CHUNK_SIZE;
+     }
+     list_element* elem = &chunk->elems[--idx];
+     if ((*equal)(data_0, elem->data_ptr)) {
        if (NULL != data_p) {
-         *data_p = tmp->data_ptr;
+         *data_p = elem->data_ptr;
        }
 
        if (rm_if_found) {
-         if (NULL == tmp->prev) {
-           p_list->p_head = tmp->next;
-         } else {
-           tmp->prev->next = tmp->next;
-         }
+         void* data = elem->data_ptr;
+         void (*dealloc_func)(void*) = elem->dealloc_func;
 
-         if (NULL == tmp->next) {
-           p_list->p_tail = tmp->prev;
-         } else {
-           tmp->next->prev = tmp->prev;
-         }
-
-         tmp->prev = tmp->next = NULL;
+         list_remove_at(p_list, chunk, idx);
 
          // dealloc data if it is not copied out && caller
          // has given us a dealloc function pointer.
-         if (NULL == data_p && NULL != tmp->dealloc_func) {
-             tmp->dealloc_func(tmp->data_ptr);
+         if (NULL == data_p && NULL != dealloc_func) {
+             dealloc_func(data);
          }
-         free(tmp);
        }
-
-       tmp = NULL;
-     } else {
-       tmp = tmp->next;
+       break;
      }
    }
 
    return eLINKED_LIST_SUCCESS;
 }
 
+/*===========================================================================
+
+  FUNCTION:   linked_list_remove_if
+
+  ===========================================================================*/
+linked_list_err_type linked_list_remove_if(void* list_data,
+                                           bool (*match)(void* data_0, void* data),
+                                           void* data_0, uint32_t* removed)
+{
+   if( list_data == NULL || NULL == match )
+   {
+      LOC_LOGE("%s: Invalid list parameter! list_data %p match %p\n",
+               __FUNCTION__, list_data, match);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   list_state* p_list = (list_state*)list_data;
+   uint32_t kept = 0;
+
+   if( p_list->count != 0 )
+   {
+      /* Compact the survivors towards the oldest end in a single pass */
+      list_chunk* rd_chunk = p_list->p_first;
+      uint32_t rd_idx = p_list->first_idx;
+      list_chunk* wr_chunk = rd_chunk;
+      uint32_t wr_idx = rd_idx;
+      uint32_t n;
+      for( n = p_list->count; n > 0; n-- )
+      {
+         if( rd_idx == LINKED_LIST_CHUNK_SIZE )
+         {
+            rd_chunk = rd_chunk->next;
+            rd_idx = 0;
+         }
+         list_element* elem = &rd_chunk->elems[rd_idx++];
+         if( (*match)(data_0, elem->data_ptr) )
+         {
+            if( elem->dealloc_func != NULL )
+            {
+               elem->dealloc_func(elem->data_ptr);
+            }
+         }
+         else
+         {
+            if( wr_idx == LINKED_LIST_CHUNK_SIZE )
+            {
+               wr_chunk = wr_chunk->next;
+               wr_idx = 0;
+            }
+            wr_chunk->elems[wr_idx++] = *elem;
+            kept++;
+         }
+      }
+
+      if( removed != NULL )
+      {
+         *removed = p_list->count - kept;
+      }
+      if( kept != p_list->count )
+      {
+         list_set_end(p_list, wr_chunk, wr_idx, kept);
+      }
+   }
+   else if( removed != NULL )
+   {
+      *removed = 0;
+   }
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <time.h>
+
+/* The node per element list this file used to implement, kept here as the
+   baseline for the benchmark below. */
+typedef struct ref_node {
+   struct ref_node* next;
+   struct ref_node* prev;
+   void* data_ptr;
+   void (*dealloc_func)(void*);
+} ref_node;
+
+typedef struct ref_list {
+   ref_node* p_head;
+   ref_node* p_tail;
+} ref_list;
+
+static void ref_list_add(ref_list* p_list, void* data_obj)
+{
+   ref_node* elem = (ref_node*)malloc(sizeof(ref_node));
+   elem->data_ptr = data_obj;
+   elem->dealloc_func = NULL;
+   elem->prev = NULL;
+   elem->next = p_list->p_head;
+   if( p_list->p_head != NULL )
+   {
+      p_list->p_head->prev = elem;
+   }
+   else
+   {
+      p_list->p_tail = elem;
+   }
+   p_list->p_head = elem;
+}
+
+static void* ref_list_remove(ref_list* p_list)
+{
+   ref_node* tmp = p_list->p_tail;
+   void* data = tmp->data_ptr;
+   p_list->p_tail = tmp->prev;
+   if( p_list->p_tail != NULL )
+   {
+      p_list->p_tail->next = NULL;
+   }
+   else
+   {
+      p_list->p_head = NULL;
+   }
+   free(tmp);
+   return data;
+}
+
+static void* ref_list_search(ref_list* p_list, bool (*equal)(void*, void*), void* data_0)
+{
+   ref_node* tmp;
+   for( tmp = p_list->p_head; tmp != NULL; tmp = tmp->next )
+   {
+      if( equal(data_0, tmp->data_ptr) )
+      {
+         return tmp->data_ptr;
+      }
+   }
+   return NULL;
+}
+
+static bool bench_equal(void* data_0, void* data)
+{
+   return data_0 == data;
+}
+
+static bool bench_odd(void* data_0, void* data)
+{
+   (void)data_0;
+   return ((uintptr_t)data & 1) != 0;
+}
+
+static uint64_t bench_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Runs add/remove cycles, a miss search over a full list, and bulk removal
+   of every other element, reporting ns per element for both lists. */
+static void bench_run(uint32_t n)
+{
+   uint32_t rounds = 2000000 / n;
+   uint32_t r, i;
+   uint64_t t0, ref_fifo, ref_search, ref_bulk, new_fifo, new_search, new_bulk;
+   void* data;
+   void* new_list = NULL;
+   ref_list ref = { NULL, NULL };
+   volatile uintptr_t sink = 0;
+
+   if( rounds == 0 )
+   {
+      rounds = 1;
+   }
+
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      for( i = 1; i <= n; i++ ) ref_list_add(&ref, (void*)(uintptr_t)i);
+      for( i = 1; i <= n; i++ ) sink += (uintptr_t)ref_list_remove(&ref);
+   }
+   ref_fifo = bench_now_ns() - t0;
+
+   for( i = 1; i <= n; i++ ) ref_list_add(&ref, (void*)(uintptr_t)i);
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      sink += (uintptr_t)ref_list_search(&ref, bench_equal, (void*)(uintptr_t)0);
+   }
+   ref_search = bench_now_ns() - t0;
+
+   /* search based removal is all the old list offered for bulk removal */
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      ref_node* tmp = ref.p_head;
+      while( tmp != NULL )
+      {
+         ref_node* next = tmp->next;
+         if( bench_odd(NULL, tmp->data_ptr) )
+         {
+            if( tmp->prev ) tmp->prev->next = tmp->next; else ref.p_head = tmp->next;
+            if( tmp->next ) tmp->next->prev = tmp->prev; else ref.p_tail = tmp->prev;
+            free(tmp);
+         }
+         tmp = next;
+      }
+      for( i = 1; i <= n; i += 2 ) ref_list_add(&ref, (void*)(uintptr_t)i);
+   }
+   ref_bulk = bench_now_ns() - t0;
+   while( ref.p_tail != NULL ) ref_list_remove(&ref);
+
+   linked_list_init(&new_list);
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      for( i = 1; i <= n; i++ ) linked_list_add(new_list, (void*)(uintptr_t)i, NULL);
+      for( i = 1; i <= n; i++ )
+      {
+         linked_list_remove(new_list, &data);
+         sink += (uintptr_t)data;
+      }
+   }
+   new_fifo = bench_now_ns() - t0;
+
+   for( i = 1; i <= n; i++ ) linked_list_add(new_list, (void*)(uintptr_t)i, NULL);
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      linked_list_search(new_list, &data, bench_equal, (void*)(uintptr_t)0, false);
+      sink += (uintptr_t)data;
+   }
+   new_search = bench_now_ns() - t0;
+
+   t0 = bench_now_ns();
+   for( r = 0; r < rounds; r++ )
+   {
+      linked_list_remove_if(new_list, bench_odd, NULL, NULL);
+      for( i = 1; i <= n; i += 2 ) linked_list_add(new_list, (void*)(uintptr_t)i, NULL);
+   }
+   new_bulk = bench_now_ns() - t0;
+   linked_list_destroy(&new_list);
+
+   printf("%7u elements: fifo %6.1f / %6.1f  search %6.2f / %6.2f  "
+          "remove_if %6.1f / %6.1f ns per element (node / chunked)\n", n,
+          (double)ref_fifo / ((double)rounds * n),
+          (double)new_fifo / ((double)rounds * n),
+          (double)ref_search / ((double)rounds * n),
+          (double)new_search / ((double)rounds * n),
+          (double)ref_bulk / ((double)rounds * n),
+          (double)new_bulk / ((double)rounds * n));
+   (void)sink;
+}
+
+// on linux command line:
+// build: make check, for linked_list_bench, linked with libgps_utils
+// run: ./linked_list_bench
+int main(void)
+{
+   bench_run(10);
+   bench_run(1000);
+   bench_run(100000);
+   return 0;
+}
+
+#endif
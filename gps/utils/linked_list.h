@@ -33,6 +33,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 /** Linked List Return Codes */
@@ -139,6 +140,30 @@ SIDE EFFECTS
 ===========================================================================*/
 linked_list_err_type linked_list_remove(void* list_data, void **data_obj);
 
+/*===========================================================================
+FUNCTION    linked_list_remove_dealloc
+
+DESCRIPTION
+   Same as linked_list_remove, but also retrieves the dealloc function the
+   data was added with, for callers that discard the data.
+
+   p_list_data:  List to remove the tail from.
+   data_obj:     Pointer to data removed from list
+   dealloc:      Pointer to the dealloc function of the data removed
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_remove_dealloc(void* list_data, void **data_obj,
+                                                void (**dealloc)(void*));
+
 /*===========================================================================
 FUNCTION    linked_list_empty
 
@@ -210,6 +235,34 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
                                         bool (*equal)(void* data_0, void* data),
                                         void* data_0, bool rm_if_found);
 
+/*===========================================================================
+FUNCTION    linked_list_remove_if
+
+DESCRIPTION
+   Removes every element for which match returns true, in a single pass.
+   The relative order of the remaining elements is kept.
+
+   list_data:    List handle.
+   match:        Function ptr takes in a list element, and returns
+                 indication if it should be removed.
+   data_0:       The data being compared against.
+   removed:      Set to the number of elements removed; may be NULL.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   Removed elements are freed with the dealloc function given to
+   linked_list_add, if any.
+
+===========================================================================*/
+linked_list_err_type linked_list_remove_if(void* list_data,
+                                           bool (*match)(void* data_0, void* data),
+                                           void* data_0, uint32_t* removed);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
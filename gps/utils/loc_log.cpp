@@ -88,7 +88,8 @@ static const loc_name_val_s_type loc_msg_q_status[] =
     NAME_VAL( eMSG_Q_INVALID_PARAMETER ),
     NAME_VAL( eMSG_Q_INVALID_HANDLE ),
     NAME_VAL( eMSG_Q_UNAVAILABLE_RESOURCE ),
-    NAME_VAL( eMSG_Q_INSUFFICIENT_BUFFER )
+    NAME_VAL( eMSG_Q_INSUFFICIENT_BUFFER ),
+    NAME_VAL( eMSG_Q_QUEUE_FULL )
 };
 static const size_t loc_msg_q_status_num = LOC_TABLE_SIZE(loc_msg_q_status);
 
@@ -31,6 +31,9 @@
 #define LOG_TAG "LocSvc_nmea"
 #include <loc_nmea.h>
 #include <math.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 #include <log_util.h>
 #include <loc_pla.h>
 
@@ -1112,3 +1115,261 @@ void loc_nmea_generate_sv(const GnssSvNotification &svNotify,
 
     EXIT_LOG(%d, 0);
 }
+
+/*===========================================================================
+FUNCTION    LocNmeaFields::LocNmeaFields
+
+DESCRIPTION
+   Split an NMEA sentence into its fields, those before the '*' of its
+   checksum, at the commas; in one pass, with no copy. A sentence without
+   a checksum has no fields. The sentence ends at length bytes, or at a
+   NUL before.
+
+DEPENDENCIES
+   The sentence must outlive the fields
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+LocNmeaFields::LocNmeaFields(const char* sentence, uint32_t length) :
+    mSentence(sentence), mCount(0)
+{
+    if (NULL == sentence) {
+        mSentence = "";
+        return;
+    }
+    // offsets are 16 bits
+    length = strnlen(sentence, (length < UINT16_MAX) ? length : UINT16_MAX);
+    const char* end = (const char*)memchr(sentence, '*', length);
+    if (NULL == end) {
+        return;
+    }
+
+    // fields are short, a plain loop beats a memchr() for each
+    uint32_t fieldStart = 0;
+    const uint32_t endOffset = end - sentence;
+    for (uint32_t i = 0; mCount < LOC_NMEA_MAX_FIELDS; i++) {
+        if (i == endOffset || ',' == sentence[i]) {
+            mFields[mCount].offset = fieldStart;
+            mFields[mCount].length = i - fieldStart;
+            mCount++;
+            if (i == endOffset) {
+                break;
+            }
+            fieldStart = i + 1;
+        }
+    }
+}
+
+// skips the blanks, and takes the sign, that atoi() and the like would
+static inline const char* loc_nmea_skip_sign(const char* p, const char* end, bool& negative)
+{
+    while (p < end && (' ' == *p || ('\t' <= *p && *p <= '\r'))) {
+        p++;
+    }
+    negative = (p < end && '-' == *p);
+    if (p < end && ('-' == *p || '+' == *p)) {
+        p++;
+    }
+    return p;
+}
+
+int64_t LocNmeaFields::getInt(uint32_t i) const
+{
+    uint32_t length = 0;
+    const char* p = get(i, length);
+    const char* end = p + length;
+    bool negative = false;
+    p = loc_nmea_skip_sign(p, end, negative);
+    uint64_t value = 0;
+    for (; p < end && '0' <= *p && *p <= '9'; p++) {
+        value = value * 10 + (*p - '0');
+    }
+    return negative ? -(int64_t)value : (int64_t)value;
+}
+
+uint64_t LocNmeaFields::getHex(uint32_t i) const
+{
+    uint32_t length = 0;
+    const char* p = get(i, length);
+    const char* end = p + length;
+    bool negative = false;
+    p = loc_nmea_skip_sign(p, end, negative);
+    if (end - p > 2 && '0' == p[0] && ('x' == p[1] || 'X' == p[1]) && isxdigit(p[2])) {
+        p += 2;
+    }
+    uint64_t value = 0;
+    for (; p < end && isxdigit(*p); p++) {
+        value = (value << 4) | ((*p <= '9') ? *p - '0' : (*p | 0x20) - 'a' + 10);
+    }
+    return negative ? 0 - value : value;
+}
+
+/*===========================================================================
+FUNCTION    LocNmeaFields::getDouble
+
+DESCRIPTION
+   Convert field i as atof() would. Plain decimals of up to 15 significant
+   digits and 15 decimal places, as in all fields of ours, are converted
+   exactly without strtod(); a mantissa and a power of 10 that are both exact
+   doubles give an exactly rounded quotient. Anything else, e.g. an exponent,
+   goes to strtod().
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The value of the field, or 0
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+double LocNmeaFields::getDouble(uint32_t i) const
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15
+    };
+    uint32_t length = 0;
+    const char* field = get(i, length);
+    const char* end = field + length;
+    bool negative = false;
+    const char* p = loc_nmea_skip_sign(field, end, negative);
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fraction = -1;
+    for (; p < end; p++) {
+        if ('0' <= *p && *p <= '9') {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += (0 != mantissa);
+            fraction += (fraction >= 0);
+        } else if ('.' == *p && fraction < 0) {
+            fraction = 0;
+        } else {
+            break;
+        }
+    }
+    if (p == end && digits <= 15 && fraction <= 15) {
+        double value = (fraction > 0) ? mantissa / pow10[fraction] : mantissa;
+        return negative ? -value : value;
+    }
+
+    char buf[64];
+    length = (length < sizeof(buf)) ? length : sizeof(buf) - 1;
+    memcpy(buf, field, length);
+    buf[length] = '\0';
+    return strtod(buf, NULL);
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+static uint64_t loc_nmea_now_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// the fields as SystemStatusNmeaBase split them before LocNmeaFields
+static void loc_nmea_split_with_strings(const char* sentence, std::vector<std::string>& fields)
+{
+    std::string parser(sentence);
+    std::string::size_type index = parser.find("*");
+    if (index == std::string::npos) {
+        return;
+    }
+    parser[index] = ',';
+    while (1) {
+        std::string str;
+        index = parser.find(",");
+        if (index == std::string::npos) {
+            break;
+        }
+        str = parser.substr(0, index);
+        parser = parser.substr(index + 1);
+        fields.push_back(str);
+    }
+}
+
+// on linux command line:
+// build: make check, for loc_nmea_test, linked with libgps_utils
+// run: ./loc_nmea_test [number of rounds, 100000 by default]
+int main(int argc, char** argv)
+{
+    uint32_t rounds = (argc > 1) ? atoi(argv[1]) : 100000;
+    int failures = 0;
+
+    // as many fields as a $PQWM1 has, with the kinds of values it has
+    const char* m1 = "$PQWM1,123456.00,2001,345678900,1,2,1500,-2345,120,3,-12,"
+            "1200,1300,-45,67,30,31,32,33,0,4.56,-3.25,7.125,0.5,18,2,1100,1110,"
+            "1120,1130,1140,1150*3A";
+    // as a $PQWP3, with hex masks, 64 bit ones among them
+    const char* p3 = "$PQWP3,123456.00,1F,12,24,36,48,60,FFFFFFFF,FFFFFF,"
+            "1FFFFFFFFF,FFFFFFFFF,0x1F*5B";
+    const char* sentences[] = { m1, p3, "$PQWP2,1.5,37.421998333,-122.084000000,"
+            "-12.5e1,1e-3,1234567890.1234567,,x1,0.00000000000000001,"
+            "0.0000000000000000,-0.000000000000000123,0.000000000000001*00",
+            "$PQWS1,1,2", "$PQWS1*00" };
+    for (size_t s = 0; s < sizeof(sentences) / sizeof(sentences[0]); s++) {
+        std::vector<std::string> strings;
+        loc_nmea_split_with_strings(sentences[s], strings);
+        LocNmeaFields fields(sentences[s], strlen(sentences[s]));
+        if (fields.size() != strings.size()) {
+            printf("sentence %zu: %u fields, %zu before FAILED\n", s, fields.size(),
+                   strings.size());
+            failures++;
+            continue;
+        }
+        for (uint32_t i = 0; i < fields.size(); i++) {
+            uint32_t length = 0;
+            const char* field = fields.get(i, length);
+            const char* str = strings[i].c_str();
+            if (std::string(field, length) != strings[i] ||
+                    fields.getInt(i) != atoi(str) ||
+                    fields.getHex(i) != strtoull(str, NULL, 16) ||
+                    fields.getDouble(i) != atof(str)) {
+                printf("sentence %zu field %u \"%s\": %" PRId64 " %" PRIx64 " %.17g FAILED\n",
+                       s, i, str, fields.getInt(i), fields.getHex(i), fields.getDouble(i));
+                failures++;
+            }
+        }
+    }
+    printf("%s\n", failures ? "self test FAILED" : "self test passed");
+
+    // the fields of a $PQWM1 split, and all of them converted, as
+    // SystemStatusPQWM1parser did before and does now
+    uint32_t nFields = LocNmeaFields(m1, strlen(m1)).size();
+    double sum = 0;
+    uint64_t startNs = loc_nmea_now_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        std::vector<std::string> strings;
+        loc_nmea_split_with_strings(m1, strings);
+        for (uint32_t i = 1; i < nFields; i++) {
+            sum += (i >= 19 && i <= 22) ? atof(strings[i].c_str()) : atoi(strings[i].c_str());
+        }
+    }
+    uint64_t stringsNs = loc_nmea_now_ns() - startNs;
+    startNs = loc_nmea_now_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        LocNmeaFields fields(m1, strlen(m1));
+        for (uint32_t i = 1; i < nFields; i++) {
+            sum += (i >= 19 && i <= 22) ? fields.getDouble(i) : fields.getInt(i);
+        }
+    }
+    uint64_t fieldsNs = loc_nmea_now_ns() - startNs;
+    printf("%u rounds of a $PQWM1 of %u fields, ns/sentence: std::string %.0f, "
+           "LocNmeaFields %.0f (%.0f)\n", rounds, nFields, (double)stringsNs / rounds,
+           (double)fieldsNs / rounds, sum / rounds);
+    return failures ? 1 : 0;
+}
+
+#endif
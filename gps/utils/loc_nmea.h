@@ -51,4 +51,36 @@ inline bool loc_nmea_is_debug(const char* nmea, int length) {
             (nmea[0] == '$') && (nmea[1] == 'P') && (nmea[2] == 'Q') && (nmea[3] == 'W'));
 }
 
+// fields of a sentence taken at once, e.g. all of $PQWP7
+#define LOC_NMEA_MAX_FIELDS 512
+
+// The fields of an NMEA sentence, those before its checksum, in one pass and
+// in place: each is an offset into the sentence and a length, with nothing
+// copied. The sentence must outlive the fields. Fields past
+// LOC_NMEA_MAX_FIELDS are left out. The getters convert a field as atoi(),
+// strtol() of base 16 and atof() would, straight off the sentence; a field
+// out of range converts to 0.
+class LocNmeaFields {
+public:
+    LocNmeaFields(const char* sentence, uint32_t length);
+
+    inline uint32_t size() const { return mCount; }
+    // field i, of length bytes, not NUL terminated
+    inline const char* get(uint32_t i, uint32_t& length) const {
+        length = (i < mCount) ? mFields[i].length : 0;
+        return mSentence + ((i < mCount) ? mFields[i].offset : 0);
+    }
+    int64_t getInt(uint32_t i) const;
+    uint64_t getHex(uint32_t i) const;
+    double getDouble(uint32_t i) const;
+
+private:
+    const char* mSentence;
+    uint32_t mCount;
+    struct {
+        uint16_t offset;
+        uint16_t length;
+    } mFields[LOC_NMEA_MAX_FIELDS];
+};
+
 #endif // LOC_ENG_NMEA_H
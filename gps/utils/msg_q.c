@@ -25,59 +25,747 @@
  * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#define LOG_TAG "LocSvc_utils_q"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <loc_pla.h>
+#include <log_util.h>
+#include "linked_list.h"
+#include "msg_q.h"
+
+#define MSG_RING_CACHE_LINE 64
+
+/* Number of control messages received in a row, while telemetry messages
+   are waiting, before one telemetry message gets its turn. */
+#define MSG_Q_CONTROL_BURST 8
+
+/* A slot in the ring. seq tells whose turn it is to use the slot: a producer
+   may fill it when seq == position, the consumer may empty it when
+   seq == position + 1. */
+typedef struct msg_ring_cell {
+   size_t seq;
+   void* data_ptr;
+   void (*dealloc_func)(void*);
+} msg_ring_cell;
+
+/* Bounded multi-producer ring of message pointers. The positions are kept
+   on separate cache lines so that producers and the consumer do not bounce
+   each others' lines. */
+typedef struct msg_ring {
+   msg_ring_cell* cells;
+   size_t mask;
+   size_t enq_pos __attribute__((aligned(MSG_RING_CACHE_LINE)));
+   size_t deq_pos __attribute__((aligned(MSG_RING_CACHE_LINE)));
+} msg_ring;
+
+typedef struct msg_q_lane {
+   void* msg_list;                  /* Linked list to store information; with a
+                                       ring, the messages that overflowed it */
+   msg_ring* msg_ring;              /* Lock-free ring used before msg_list, if not NULL */
+   uint32_t depth;                  /* Number of messages in msg_list */
+   uint32_t max_depth;              /* Highest depth seen */
+   uint64_t total;                  /* Number of messages sent to msg_list */
+   uint64_t dropped;                /* Number of messages dropped for room */
+   uint64_t rejected;               /* Number of messages rejected for lack of room */
+   uint64_t blocked;                /* Number of sends that waited for room */
+   uint32_t drop_pending;           /* Messages the consumer is to drop, ring only */
+} msg_q_lane;
+
+typedef struct msg_q {
+   msg_q_lane lanes[eMSG_Q_LANE_MAX]; /* Lanes in the order they are drained */
+   uint32_t control_streak;         /* Control messages received in a row */
+   pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
+   pthread_cond_t  space_cond;      /* Condition variable for waiting on room in msg queue */
+   uint32_t capacity;               /* Maximum number of messages; 0 for unbounded */
+   msg_q_overflow_policy policy;    /* What to do when a message does not fit */
+   pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
+   int unblocked;                   /* Has this message queue been unblocked? */
+   int is_ring;                     /* Do the lanes use msg_ring instead of msg_list? */
+   int wake_seq __attribute__((aligned(MSG_RING_CACHE_LINE))); /* futex word, ring only */
+   int parked;                      /* Is the consumer sleeping on wake_seq? ring only */
+   int space_seq;                   /* futex word for room in the queue, ring only */
+   uint32_t space_waiters;          /* Senders sleeping on space_seq, ring only */
+} msg_q;
+
+/*===========================================================================
+FUNCTION    convert_linked_list_err_type
+
+DESCRIPTION
+   Converts from one set of enum values to another.
+
+   linked_list_val: Value to convert to msg_q_enum_type
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Corresponding linked_list_enum_type in msg_q_enum_type
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_list_val)
+{
+   switch( linked_list_val )
+   {
+   case eLINKED_LIST_SUCCESS:
+      return eMSG_Q_SUCCESS;
+   case eLINKED_LIST_INVALID_PARAMETER:
+      return eMSG_Q_INVALID_PARAMETER;
+   case eLINKED_LIST_INVALID_HANDLE:
+      return eMSG_Q_INVALID_HANDLE;
+   case eLINKED_LIST_UNAVAILABLE_RESOURCE:
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   case eLINKED_LIST_INSUFFICIENT_BUFFER:
+      return eMSG_Q_INSUFFICIENT_BUFFER;
+
+   case eLINKED_LIST_FAILURE_GENERAL:
+   default:
+      return eMSG_Q_FAILURE_GENERAL;
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_lane_order
+
+DESCRIPTION
+   Gives the order in which the consumer should look at the lanes for its
+   next message. Control goes first, unless it has had MSG_Q_CONTROL_BURST
+   turns in a row, in which case telemetry may go first once.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_lane_order(msg_q* p_msg_q, int order[eMSG_Q_LANE_MAX])
+{
+   if( p_msg_q->control_streak < MSG_Q_CONTROL_BURST )
+   {
+      order[0] = eMSG_Q_LANE_CONTROL;
+      order[1] = eMSG_Q_LANE_TELEMETRY;
+   }
+   else
+   {
+      order[0] = eMSG_Q_LANE_TELEMETRY;
+      order[1] = eMSG_Q_LANE_CONTROL;
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_lane_taken
+
+DESCRIPTION
+   Book keeping of the consumer after it took a message from lane.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_lane_taken(msg_q* p_msg_q, int lane)
+{
+   if( lane == eMSG_Q_LANE_CONTROL )
+   {
+      p_msg_q->control_streak++;
+   }
+   else
+   {
+      p_msg_q->control_streak = 0;
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_put
+
+DESCRIPTION
+   Claims the next free slot of the ring and publishes data into it.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if the data was added; 0 if the ring is full.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_put(msg_ring* p_ring, void* data_obj, void (*dealloc)(void*))
+{
+   size_t pos = __atomic_load_n(&p_ring->enq_pos, __ATOMIC_RELAXED);
+   for (;;)
+   {
+      msg_ring_cell* cell = &p_ring->cells[pos & p_ring->mask];
+      size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+      if( diff == 0 )
+      {
+         if( __atomic_compare_exchange_n(&p_ring->enq_pos, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+         {
+            cell->data_ptr = data_obj;
+            cell->dealloc_func = dealloc;
+            __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+            return 1;
+         }
+         /* pos was reloaded by the failed CAS */
+      }
+      else if( diff < 0 )
+      {
+         /* the consumer has not emptied this slot since the last lap */
+         return 0;
+      }
+      else
+      {
+         pos = __atomic_load_n(&p_ring->enq_pos, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_get
+
+DESCRIPTION
+   Takes the oldest published data out of the ring. A slot that has been
+   claimed by a producer but not yet published reads as empty; that
+   producer will wake the consumer once it publishes.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if data was taken out; 0 if the ring is empty.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_get(msg_ring* p_ring, void** data_obj, void (**dealloc)(void*))
+{
+   size_t pos = __atomic_load_n(&p_ring->deq_pos, __ATOMIC_RELAXED);
+   for (;;)
+   {
+      msg_ring_cell* cell = &p_ring->cells[pos & p_ring->mask];
+      size_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+      if( diff == 0 )
+      {
+         if( __atomic_compare_exchange_n(&p_ring->deq_pos, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+         {
+            *data_obj = cell->data_ptr;
+            if( dealloc != NULL )
+            {
+               *dealloc = cell->dealloc_func;
+            }
+            /* hand the slot to the producers of the next lap */
+            __atomic_store_n(&cell->seq, pos + p_ring->mask + 1, __ATOMIC_RELEASE);
+            return 1;
+         }
+      }
+      else if( diff < 0 )
+      {
+         return 0;
+      }
+      else
+      {
+         pos = __atomic_load_n(&p_ring->deq_pos, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_depth
+
+DESCRIPTION
+   Number of slots claimed by producers and not yet emptied by the consumer.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   depth of the ring
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static uint32_t msg_ring_depth(msg_ring* p_ring)
+{
+   size_t deq_pos = __atomic_load_n(&p_ring->deq_pos, __ATOMIC_RELAXED);
+   size_t enq_pos = __atomic_load_n(&p_ring->enq_pos, __ATOMIC_RELAXED);
+   return (enq_pos > deq_pos) ? (uint32_t)(enq_pos - deq_pos) : 0;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_depth
+
+DESCRIPTION
+   Number of messages in all lanes of the queue, less those the consumer is
+   yet to drop. For a list queue, the caller must hold list_mutex.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   depth of the queue
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static uint32_t msg_q_depth(msg_q* p_msg_q)
+{
+   uint32_t depth = 0;
+   uint32_t pending = 0;
+   int i;
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      depth += __atomic_load_n(&p_msg_q->lanes[i].depth, __ATOMIC_RELAXED);
+      if( p_msg_q->is_ring )
+      {
+         depth += msg_ring_depth(p_msg_q->lanes[i].msg_ring);
+         pending += __atomic_load_n(&p_msg_q->lanes[i].drop_pending, __ATOMIC_RELAXED);
+      }
+   }
+   /* messages doomed to be dropped do not count */
+   return (depth > pending) ? (depth - pending) : 0;
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_lane_put
+
+DESCRIPTION
+   Adds data to the ring of the lane or, if the ring is full, to the end of
+   the overflow list of the lane, so that a sender never waits for the
+   consumer to make room. Once messages are in the list, later ones go there
+   too until it drains, to keep the messages of each sender in order.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_ring_lane_put(msg_q* p_msg_q, msg_q_lane* p_lane,
+                                        void* data_obj, void (*dealloc)(void*))
+{
+   if( __atomic_load_n(&p_lane->depth, __ATOMIC_ACQUIRE) == 0 &&
+       msg_ring_put(p_lane->msg_ring, data_obj, dealloc) )
+   {
+      return eMSG_Q_SUCCESS;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   msq_q_err_type rv =
+      convert_linked_list_err_type(linked_list_add(p_lane->msg_list, data_obj, dealloc));
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      __atomic_add_fetch(&p_lane->total, 1, __ATOMIC_RELAXED);
+      /* releases what this sender put in the ring before, see below */
+      __atomic_add_fetch(&p_lane->depth, 1, __ATOMIC_RELEASE);
+   }
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+   return rv;
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_lane_get
+
+DESCRIPTION
+   Takes the oldest message out of the lane: out of its ring, or out of its
+   overflow list once the ring is empty. A ring with a slot claimed but not
+   yet published is not empty, as the message of that slot may be older
+   than those in the list.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if data_obj was filled; 0 if there is nothing to take yet.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_lane_get(msg_q* p_msg_q, msg_q_lane* p_lane, void** data_obj,
+                             void (**dealloc)(void*))
+{
+   if( msg_ring_get(p_lane->msg_ring, data_obj, dealloc) )
+   {
+      return 1;
+   }
+   /* depth is read first, so that the ring is seen with all that the
+      senders of the list put in it before */
+   if( __atomic_load_n(&p_lane->depth, __ATOMIC_ACQUIRE) == 0 )
+   {
+      return 0;
+   }
+   if( msg_ring_depth(p_lane->msg_ring) != 0 )
+   {
+      return msg_ring_get(p_lane->msg_ring, data_obj, dealloc);
+   }
+
+   int got = 0;
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   if( p_lane->depth != 0 &&
+       linked_list_remove_dealloc(p_lane->msg_list, data_obj, dealloc) == eLINKED_LIST_SUCCESS )
+   {
+      __atomic_sub_fetch(&p_lane->depth, 1, __ATOMIC_RELAXED);
+      got = 1;
+   }
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+   return got;
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_wake
+
+DESCRIPTION
+   Wakes up the consumer if, and only if, it is parked on the futex. Must be
+   called after data is published or after the queue is unblocked.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_ring_wake(msg_q* p_msg_q)
+{
+   /* Pairs with the fence in msg_ring_wait(). Either we see parked set, or
+      the consumer sees what we published before it goes to sleep. */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if( __atomic_load_n(&p_msg_q->parked, __ATOMIC_RELAXED) &&
+       __atomic_exchange_n(&p_msg_q->parked, 0, __ATOMIC_SEQ_CST) )
+   {
+      __atomic_add_fetch(&p_msg_q->wake_seq, 1, __ATOMIC_SEQ_CST);
+      syscall(SYS_futex, &p_msg_q->wake_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_wake_space
+
+DESCRIPTION
+   Wakes up the senders waiting for room in the queue, if any. Must be
+   called after the consumer has taken messages out, or after the queue is
+   unblocked or flushed.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_ring_wake_space(msg_q* p_msg_q)
+{
+   /* Pairs with the fence in msg_ring_wait_space(), as in msg_ring_wake() */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if( __atomic_load_n(&p_msg_q->space_waiters, __ATOMIC_RELAXED) != 0 )
+   {
+      __atomic_add_fetch(&p_msg_q->space_seq, 1, __ATOMIC_SEQ_CST);
+      syscall(SYS_futex, &p_msg_q->space_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_wait_space
+
+DESCRIPTION
+   Parks a sender until there is room in the queue, or the queue gets
+   unblocked.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_ring_wait_space(msg_q* p_msg_q)
+{
+   int seq = __atomic_load_n(&p_msg_q->space_seq, __ATOMIC_ACQUIRE);
+   __atomic_add_fetch(&p_msg_q->space_waiters, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   /* re-check after announcing that we are about to sleep */
+   if( !__atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) &&
+       msg_q_depth(p_msg_q) >= p_msg_q->capacity )
+   {
+      /* returns right away if space_seq has moved on since we sampled it */
+      syscall(SYS_futex, &p_msg_q->space_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+   }
+   __atomic_sub_fetch(&p_msg_q->space_waiters, 1, __ATOMIC_RELAXED);
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_claim_drop
+
+DESCRIPTION
+   Claims the oldest message of the lane, that is not claimed yet, to be
+   dropped by the consumer. The sender never takes messages out of a ring
+   itself, so that the consumer stays its only reader.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if a message was claimed; 0 if the lane holds none left to claim.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_claim_drop(msg_q_lane* p_lane)
+{
+   uint32_t pending = __atomic_load_n(&p_lane->drop_pending, __ATOMIC_RELAXED);
+   for (;;)
+   {
+      uint32_t queued = msg_ring_depth(p_lane->msg_ring) +
+                        __atomic_load_n(&p_lane->depth, __ATOMIC_RELAXED);
+      if( queued <= pending )
+      {
+         return 0;
+      }
+      if( __atomic_compare_exchange_n(&p_lane->drop_pending, &pending, pending + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+      {
+         return 1;
+      }
+      /* pending was reloaded by the failed CAS */
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_drop_claimed
+
+DESCRIPTION
+   Drops, on behalf of the senders, the messages they claimed with
+   msg_ring_claim_drop(). Called by the consumer before it takes messages
+   out of the lanes.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_ring_drop_claimed(msg_q* p_msg_q, msg_q_lane* p_lane)
+{
+   while( __atomic_load_n(&p_lane->drop_pending, __ATOMIC_RELAXED) != 0 )
+   {
+      void* data_obj = NULL;
+      void (*dealloc)(void*) = NULL;
+      if( !msg_ring_lane_get(p_msg_q, p_lane, &data_obj, &dealloc) )
+      {
+         if( msg_ring_depth(p_lane->msg_ring) == 0 &&
+             __atomic_load_n(&p_lane->depth, __ATOMIC_RELAXED) == 0 )
+         {
+            /* the claimed ones were received before we got to them */
+            __atomic_store_n(&p_lane->drop_pending, 0, __ATOMIC_RELAXED);
+         }
+         return;
+      }
+      __atomic_sub_fetch(&p_lane->drop_pending, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&p_lane->dropped, 1, __ATOMIC_RELAXED);
+      if( dealloc != NULL )
+      {
+         dealloc(data_obj);
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_unblocked
+
+DESCRIPTION
+   Tells whether the queue has been unblocked. If it has, also waits for
+   msg_q_unblock to be done with the queue, as the caller may go on to
+   destroy it.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if the queue has been unblocked; 0 otherwise.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_unblocked(msg_q* p_msg_q)
+{
+   if( !__atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+   {
+      return 0;
+   }
+   /* msg_q_unblock holds the mutex until it has woken the consumer */
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+   return 1;
+}
+
+/*===========================================================================
+FUNCTION    msg_ring_get_any
+
+DESCRIPTION
+   Takes the next message out of the lane rings, in lane priority order.
 
-#define LOG_TAG "LocSvc_utils_q"
-#include <stdio.h>
-#include <stdlib.h>
-#include <pthread.h>
-#include <loc_pla.h>
-#include <log_util.h>
-#include "linked_list.h"
-#include "msg_q.h"
+DEPENDENCIES
+   N/A
 
-typedef struct msg_q {
-   void* msg_list;                  /* Linked list to store information */
-   pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
-   pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
-   int unblocked;                   /* Has this message queue been unblocked? */
-} msg_q;
+RETURN VALUE
+   1 if data_obj was filled; 0 if all rings are empty.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_ring_get_any(msg_q* p_msg_q, void** data_obj)
+{
+   int order[eMSG_Q_LANE_MAX];
+   int i;
+
+   msg_ring_drop_claimed(p_msg_q, &p_msg_q->lanes[eMSG_Q_LANE_TELEMETRY]);
+   msg_q_lane_order(p_msg_q, order);
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      msg_q_lane* lane = &p_msg_q->lanes[order[i]];
+      /* sample depth before taking, so the message itself is counted */
+      uint32_t depth = msg_ring_depth(lane->msg_ring) +
+                       __atomic_load_n(&lane->depth, __ATOMIC_RELAXED);
+      if( msg_ring_lane_get(p_msg_q, lane, data_obj, NULL) )
+      {
+         /* only the consumer writes max_depth; msg_q_get_lane_stats reads it */
+         if( depth > lane->max_depth )
+         {
+            __atomic_store_n(&lane->max_depth, depth, __ATOMIC_RELAXED);
+         }
+         msg_q_lane_taken(p_msg_q, order[i]);
+         if( p_msg_q->capacity != 0 )
+         {
+            msg_ring_wake_space(p_msg_q);
+         }
+         return 1;
+      }
+   }
+   return 0;
+}
 
 /*===========================================================================
-FUNCTION    convert_linked_list_err_type
+FUNCTION    msg_ring_wait
 
 DESCRIPTION
-   Converts from one set of enum values to another.
-
-   linked_list_val: Value to convert to msg_q_enum_type
+   Parks the consumer until a producer publishes new data, or the queue gets
+   unblocked.
 
 DEPENDENCIES
    N/A
 
 RETURN VALUE
-   Corresponding linked_list_enum_type in msg_q_enum_type
+   1 if data_obj was filled; 0 if the queue has been unblocked.
 
 SIDE EFFECTS
    N/A
 
 ===========================================================================*/
-static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_list_val)
+static int msg_ring_wait(msg_q* p_msg_q, void** data_obj)
 {
-   switch( linked_list_val )
+   for (;;)
    {
-   case eLINKED_LIST_SUCCESS:
-      return eMSG_Q_SUCCESS;
-   case eLINKED_LIST_INVALID_PARAMETER:
-      return eMSG_Q_INVALID_PARAMETER;
-   case eLINKED_LIST_INVALID_HANDLE:
-      return eMSG_Q_INVALID_HANDLE;
-   case eLINKED_LIST_UNAVAILABLE_RESOURCE:
-      return eMSG_Q_UNAVAILABLE_RESOURCE;
-   case eLINKED_LIST_INSUFFICIENT_BUFFER:
-      return eMSG_Q_INSUFFICIENT_BUFFER;
+      if( msg_ring_get_any(p_msg_q, data_obj) )
+      {
+         return 1;
+      }
+      if( msg_ring_unblocked(p_msg_q) )
+      {
+         return 0;
+      }
+
+      int seq = __atomic_load_n(&p_msg_q->wake_seq, __ATOMIC_ACQUIRE);
+      __atomic_store_n(&p_msg_q->parked, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+      /* re-check after announcing that we are about to sleep */
+      if( msg_ring_get_any(p_msg_q, data_obj) )
+      {
+         __atomic_store_n(&p_msg_q->parked, 0, __ATOMIC_RELAXED);
+         return 1;
+      }
+      if( !__atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         /* returns right away if wake_seq has moved on since we sampled it */
+         syscall(SYS_futex, &p_msg_q->wake_seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+      }
+      __atomic_store_n(&p_msg_q->parked, 0, __ATOMIC_RELAXED);
+   }
+}
 
-   case eLINKED_LIST_FAILURE_GENERAL:
-   default:
-      return eMSG_Q_FAILURE_GENERAL;
+/*===========================================================================
+FUNCTION    msg_ring_flush
+
+DESCRIPTION
+   Removes all elements from the ring and deallocates them.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_ring_flush(msg_ring* p_ring)
+{
+   void* data_obj = NULL;
+   void (*dealloc)(void*) = NULL;
+   while( msg_ring_get(p_ring, &data_obj, &dealloc) )
+   {
+      if( dealloc != NULL )
+      {
+         dealloc(data_obj);
+      }
    }
 }
 
@@ -104,17 +792,28 @@ msq_q_err_type msg_q_init(void** msg_q_data)
       return eMSG_Q_FAILURE_GENERAL;
    }
 
-   if( linked_list_init(&tmp_msg_q->msg_list) != 0 )
+   int i;
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
    {
-      LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
-      free(tmp_msg_q);
-      return eMSG_Q_FAILURE_GENERAL;
+      if( linked_list_init(&tmp_msg_q->lanes[i].msg_list) != 0 )
+      {
+         LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
+         while( i-- > 0 )
+         {
+            linked_list_destroy(&tmp_msg_q->lanes[i].msg_list);
+         }
+         free(tmp_msg_q);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
    }
 
    if( pthread_mutex_init(&tmp_msg_q->list_mutex, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize list mutex!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
+      for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+      {
+         linked_list_destroy(&tmp_msg_q->lanes[i].msg_list);
+      }
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
@@ -122,12 +821,31 @@ msq_q_err_type msg_q_init(void** msg_q_data)
    if( pthread_cond_init(&tmp_msg_q->list_cond, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize msg q cond var!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
+      for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+      {
+         linked_list_destroy(&tmp_msg_q->lanes[i].msg_list);
+      }
+      pthread_mutex_destroy(&tmp_msg_q->list_mutex);
+      free(tmp_msg_q);
+      return eMSG_Q_FAILURE_GENERAL;
+   }
+
+   if( pthread_cond_init(&tmp_msg_q->space_cond, NULL) != 0 )
+   {
+      LOC_LOGE("%s: Unable to initialize msg q space cond var!\n", __FUNCTION__);
+      for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+      {
+         linked_list_destroy(&tmp_msg_q->lanes[i].msg_list);
+      }
       pthread_mutex_destroy(&tmp_msg_q->list_mutex);
+      pthread_cond_destroy(&tmp_msg_q->list_cond);
       free(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
+   tmp_msg_q->capacity = 0;
+   tmp_msg_q->policy = eMSG_Q_OVERFLOW_BLOCK;
+
    tmp_msg_q->unblocked = 0;
 
    *msg_q_data = tmp_msg_q;
@@ -149,6 +867,86 @@ const void* msg_q_init2()
   return q;
 }
 
+/*===========================================================================
+
+  FUNCTION:   msg_q_init_ring
+
+  ===========================================================================*/
+msq_q_err_type msg_q_init_ring(void** msg_q_data, uint32_t capacity)
+{
+   msq_q_err_type rv = msg_q_init(msg_q_data);
+   if( rv != eMSG_Q_SUCCESS )
+   {
+      return rv;
+   }
+
+   size_t size = 2;
+   while( size < capacity )
+   {
+      size <<= 1;
+   }
+
+   msg_q* p_msg_q = (msg_q*)*msg_q_data;
+   p_msg_q->is_ring = 1;
+
+   int i;
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      msg_ring* p_ring = (msg_ring*)calloc(1, sizeof(msg_ring));
+      if( p_ring != NULL )
+      {
+         p_ring->cells = (msg_ring_cell*)calloc(size, sizeof(msg_ring_cell));
+      }
+      if( p_ring == NULL || p_ring->cells == NULL )
+      {
+         LOC_LOGE("%s: Unable to allocate ring of %zu!\n", __FUNCTION__, size);
+         free(p_ring);
+         msg_q_destroy(msg_q_data);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
+
+      size_t j;
+      for( j = 0; j < size; j++ )
+      {
+         p_ring->cells[j].seq = j;
+      }
+      p_ring->mask = size - 1;
+
+      p_msg_q->lanes[i].msg_ring = p_ring;
+   }
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_set_capacity
+
+  ===========================================================================*/
+msq_q_err_type msg_q_set_capacity(void* msg_q_data, uint32_t capacity,
+                                  msg_q_overflow_policy policy)
+{
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+   if( policy < eMSG_Q_OVERFLOW_BLOCK || policy > eMSG_Q_OVERFLOW_REJECT )
+   {
+      LOC_LOGE("%s: Invalid policy parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+   p_msg_q->capacity = capacity;
+   p_msg_q->policy = policy;
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   return eMSG_Q_SUCCESS;
+}
+
 /*===========================================================================
 
   FUNCTION:   msg_q_destroy
@@ -164,9 +962,22 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
    msg_q* p_msg_q = (msg_q*)*msg_q_data;
 
-   linked_list_destroy(&p_msg_q->msg_list);
+   int i;
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      msg_q_lane* lane = &p_msg_q->lanes[i];
+      if( lane->msg_ring != NULL )
+      {
+         msg_ring_flush(lane->msg_ring);
+         free(lane->msg_ring->cells);
+         free(lane->msg_ring);
+         lane->msg_ring = NULL;
+      }
+      linked_list_destroy(&lane->msg_list);
+   }
    pthread_mutex_destroy(&p_msg_q->list_mutex);
    pthread_cond_destroy(&p_msg_q->list_cond);
+   pthread_cond_destroy(&p_msg_q->space_cond);
 
    p_msg_q->unblocked = 0;
 
@@ -182,6 +993,17 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
   ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*))
+{
+   return msg_q_snd_prio(msg_q_data, msg_obj, dealloc, eMSG_Q_LANE_CONTROL);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_prio
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_lane_type lane)
 {
    msq_q_err_type rv;
    if( msg_q_data == NULL )
@@ -189,17 +1011,115 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_HANDLE;
    }
-   if( msg_obj == NULL )
+   if( msg_obj == NULL || lane < 0 || lane >= eMSG_Q_LANE_MAX )
    {
-      LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
+      LOC_LOGE("%s: Invalid msg_obj or lane parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_PARAMETER;
    }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
+   msg_q_lane* p_lane = &p_msg_q->lanes[lane];
+
+   msg_q_lane* p_drop_lane = &p_msg_q->lanes[eMSG_Q_LANE_TELEMETRY];
+   void* dropped_obj = NULL;
+   void (*dropped_dealloc)(void*) = NULL;
+   int blocked = 0;
+
+   if( p_msg_q->is_ring )
+   {
+      int rechecked = 0;
+      LOC_LOGV("%s: Sending message with handle = %p\n", __FUNCTION__, msg_obj);
+      for (;;)
+      {
+         if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+         {
+            LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+            return eMSG_Q_UNAVAILABLE_RESOURCE;
+         }
+         if( p_msg_q->capacity == 0 || msg_q_depth(p_msg_q) < p_msg_q->capacity )
+         {
+            break;
+         }
+
+         if( p_msg_q->policy == eMSG_Q_OVERFLOW_DROP_OLDEST &&
+             msg_ring_claim_drop(p_drop_lane) )
+         {
+            /* the consumer drops it before it gets to ours */
+            break;
+         }
+         else if( p_msg_q->policy == eMSG_Q_OVERFLOW_DROP_OLDEST &&
+                  p_lane != p_drop_lane )
+         {
+            /* no telemetry left to drop; control goes over capacity rather
+               than get lost */
+            break;
+         }
+         else if( p_msg_q->policy != eMSG_Q_OVERFLOW_BLOCK && !rechecked )
+         {
+            /* the consumer may have made room since the queue looked full */
+            rechecked = 1;
+         }
+         else if( p_msg_q->policy != eMSG_Q_OVERFLOW_BLOCK )
+         {
+            __atomic_add_fetch(&p_lane->rejected, 1, __ATOMIC_RELAXED);
+            return eMSG_Q_QUEUE_FULL;
+         }
+         else
+         {
+            if( !blocked )
+            {
+               blocked = 1;
+               __atomic_add_fetch(&p_lane->blocked, 1, __ATOMIC_RELAXED);
+            }
+            msg_ring_wait_space(p_msg_q);
+         }
+      }
+      rv = msg_ring_lane_put(p_msg_q, p_lane, msg_obj, dealloc);
+      if( rv == eMSG_Q_SUCCESS )
+      {
+         msg_ring_wake(p_msg_q);
+      }
+      return rv;
+   }
 
    pthread_mutex_lock(&p_msg_q->list_mutex);
    LOC_LOGV("%s: Sending message with handle = %p\n", __FUNCTION__, msg_obj);
 
+   while( !p_msg_q->unblocked && p_msg_q->capacity != 0 &&
+          msg_q_depth(p_msg_q) >= p_msg_q->capacity )
+   {
+      if( p_msg_q->policy == eMSG_Q_OVERFLOW_DROP_OLDEST &&
+          p_drop_lane->depth != 0 &&
+          linked_list_remove_dealloc(p_drop_lane->msg_list, &dropped_obj,
+                                     &dropped_dealloc) == eLINKED_LIST_SUCCESS )
+      {
+         /* dropped_obj gets deallocated once the mutex is released */
+         p_drop_lane->depth--;
+         p_drop_lane->dropped++;
+      }
+      else if( p_msg_q->policy == eMSG_Q_OVERFLOW_DROP_OLDEST && p_lane != p_drop_lane )
+      {
+         /* no telemetry left to drop; control goes over capacity rather
+            than get lost */
+         break;
+      }
+      else if( p_msg_q->policy != eMSG_Q_OVERFLOW_BLOCK )
+      {
+         p_lane->rejected++;
+         pthread_mutex_unlock(&p_msg_q->list_mutex);
+         return eMSG_Q_QUEUE_FULL;
+      }
+      else
+      {
+         if( !blocked )
+         {
+            blocked = 1;
+            p_lane->blocked++;
+         }
+         pthread_cond_wait(&p_msg_q->space_cond, &p_msg_q->list_mutex);
+      }
+   }
+
    if( p_msg_q->unblocked )
    {
       LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
@@ -207,13 +1127,26 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list, msg_obj, dealloc));
+   rv = convert_linked_list_err_type(linked_list_add(p_lane->msg_list, msg_obj, dealloc));
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      p_lane->total++;
+      if( ++p_lane->depth > p_lane->max_depth )
+      {
+         p_lane->max_depth = p_lane->depth;
+      }
+   }
 
    /* Show data is in the message queue. */
    pthread_cond_signal(&p_msg_q->list_cond);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
+   if( dropped_obj != NULL && dropped_dealloc != NULL )
+   {
+      dropped_dealloc(dropped_obj);
+   }
+
    LOC_LOGV("%s: Finished Sending message with handle = %p\n", __FUNCTION__, msg_obj);
 
    return rv;
@@ -241,6 +1174,17 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
+   if( p_msg_q->is_ring )
+   {
+      if( !msg_ring_wait(p_msg_q, msg_obj) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+      LOC_LOGV("%s: Received message %p rv = %d\n", __FUNCTION__, *msg_obj, eMSG_Q_SUCCESS);
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if( p_msg_q->unblocked )
@@ -251,12 +1195,30 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    }
 
    /* Wait for data in the message queue */
-   while( linked_list_empty(p_msg_q->msg_list) && !p_msg_q->unblocked )
+   while( p_msg_q->lanes[eMSG_Q_LANE_CONTROL].depth == 0 &&
+          p_msg_q->lanes[eMSG_Q_LANE_TELEMETRY].depth == 0 &&
+          !p_msg_q->unblocked )
    {
       pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   /* Pick the lane to take from, there is data in at least one of them
+      unless the queue got unblocked */
+   int order[eMSG_Q_LANE_MAX];
+   msg_q_lane_order(p_msg_q, order);
+   int lane = (p_msg_q->lanes[order[0]].depth != 0) ? order[0] : order[1];
+   msg_q_lane* p_lane = &p_msg_q->lanes[lane];
+
+   rv = convert_linked_list_err_type(linked_list_remove(p_lane->msg_list, msg_obj));
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      p_lane->depth--;
+      msg_q_lane_taken(p_msg_q, lane);
+      if( p_msg_q->capacity != 0 )
+      {
+         pthread_cond_signal(&p_msg_q->space_cond);
+      }
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -265,6 +1227,157 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    return rv;
 }
 
+/*===========================================================================
+FUNCTION    msg_q_rcv_batch_common
+
+DESCRIPTION
+   Implementation of msg_q_rcv_batch and msg_q_try_rcv_batch.
+
+   wait: 1 to wait for the first message; 0 to return right away if there
+         is none.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_rcv_batch_common(void* msg_q_data, void** msg_objs,
+                                             uint32_t max_count, uint32_t* count, int wait)
+{
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( msg_objs == NULL || max_count == 0 || count == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_objs, max_count or count parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   uint32_t n = 0;
+
+   if( p_msg_q->is_ring )
+   {
+      int got = 0;
+      if( wait )
+      {
+         got = msg_ring_wait(p_msg_q, &msg_objs[0]);
+      }
+      else if( !msg_ring_unblocked(p_msg_q) )
+      {
+         if( !msg_ring_get_any(p_msg_q, &msg_objs[0]) )
+         {
+            *count = 0;
+            return eMSG_Q_SUCCESS;
+         }
+         got = 1;
+      }
+      if( !got )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         *count = 0;
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+      for( n = 1; n < max_count && msg_ring_get_any(p_msg_q, &msg_objs[n]); n++ );
+      *count = n;
+      LOC_LOGV("%s: Received %u messages\n", __FUNCTION__, n);
+      return eMSG_Q_SUCCESS;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      *count = 0;
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   /* Wait for data in the message queue */
+   while( wait &&
+          p_msg_q->lanes[eMSG_Q_LANE_CONTROL].depth == 0 &&
+          p_msg_q->lanes[eMSG_Q_LANE_TELEMETRY].depth == 0 &&
+          !p_msg_q->unblocked )
+   {
+      pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
+   }
+
+   /* Take messages in the same order repeated msg_q_rcv calls would */
+   while( n < max_count &&
+          (p_msg_q->lanes[eMSG_Q_LANE_CONTROL].depth != 0 ||
+           p_msg_q->lanes[eMSG_Q_LANE_TELEMETRY].depth != 0) )
+   {
+      int order[eMSG_Q_LANE_MAX];
+      msg_q_lane_order(p_msg_q, order);
+      int lane = (p_msg_q->lanes[order[0]].depth != 0) ? order[0] : order[1];
+      msg_q_lane* p_lane = &p_msg_q->lanes[lane];
+
+      rv = convert_linked_list_err_type(linked_list_remove(p_lane->msg_list, &msg_objs[n]));
+      if( rv != eMSG_Q_SUCCESS )
+      {
+         break;
+      }
+      p_lane->depth--;
+      msg_q_lane_taken(p_msg_q, lane);
+      n++;
+   }
+
+   if( n > 0 && p_msg_q->capacity != 0 )
+   {
+      pthread_cond_broadcast(&p_msg_q->space_cond);
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   *count = n;
+   if( n > 0 )
+   {
+      /* whatever was taken must reach the caller */
+      rv = eMSG_Q_SUCCESS;
+   }
+   else if( rv == eMSG_Q_SUCCESS && wait )
+   {
+      /* woken up by msg_q_unblock */
+      rv = eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   LOC_LOGV("%s: Received %u messages rv = %d\n", __FUNCTION__, n, rv);
+
+   return rv;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_rcv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs, uint32_t max_count,
+                               uint32_t* count)
+{
+   return msg_q_rcv_batch_common(msg_q_data, msg_objs, max_count, count, 1);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_try_rcv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_try_rcv_batch(void* msg_q_data, void** msg_objs, uint32_t max_count,
+                                   uint32_t* count)
+{
+   return msg_q_rcv_batch_common(msg_q_data, msg_objs, max_count, count, 0);
+}
+
 /*===========================================================================
 
   FUNCTION:   msg_q_flush
@@ -272,7 +1385,7 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
   ===========================================================================*/
 msq_q_err_type msg_q_flush(void* msg_q_data)
 {
-   msq_q_err_type rv;
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
    if ( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -283,10 +1396,34 @@ msq_q_err_type msg_q_flush(void* msg_q_data)
 
    LOC_LOGD("%s: Flushing Message Queue\n", __FUNCTION__);
 
+   int i;
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      if( p_msg_q->lanes[i].msg_ring != NULL )
+      {
+         msg_ring_flush(p_msg_q->lanes[i].msg_ring);
+         __atomic_store_n(&p_msg_q->lanes[i].drop_pending, 0, __ATOMIC_RELAXED);
+      }
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
-   /* Remove all elements from the list */
-   rv = convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list));
+   /* Remove all elements from the lists */
+   for( i = 0; i < eMSG_Q_LANE_MAX; i++ )
+   {
+      msq_q_err_type lane_rv =
+         convert_linked_list_err_type(linked_list_flush(p_msg_q->lanes[i].msg_list));
+      if( lane_rv != eMSG_Q_SUCCESS )
+      {
+         rv = lane_rv;
+      }
+      __atomic_store_n(&p_msg_q->lanes[i].depth, 0, __ATOMIC_RELAXED);
+   }
+   pthread_cond_broadcast(&p_msg_q->space_cond);
+   if( p_msg_q->is_ring )
+   {
+      msg_ring_wake_space(p_msg_q);
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -320,10 +1457,16 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
 
    LOC_LOGD("%s: Unblocking Message Queue\n", __FUNCTION__);
    /* Unblocking message queue */
-   p_msg_q->unblocked = 1;
+   __atomic_store_n(&p_msg_q->unblocked, 1, __ATOMIC_RELEASE);
 
    /* Allow all the waiters to wake up */
    pthread_cond_broadcast(&p_msg_q->list_cond);
+   pthread_cond_broadcast(&p_msg_q->space_cond);
+   if( p_msg_q->is_ring )
+   {
+      msg_ring_wake(p_msg_q);
+      msg_ring_wake_space(p_msg_q);
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -331,3 +1474,53 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
 
    return eMSG_Q_SUCCESS;
 }
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_get_lane_stats
+
+  ===========================================================================*/
+msq_q_err_type msg_q_get_lane_stats(void* msg_q_data, msg_q_lane_type lane,
+                                    msg_q_lane_stats* stats)
+{
+   if ( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+   if( stats == NULL || lane < 0 || lane >= eMSG_Q_LANE_MAX )
+   {
+      LOC_LOGE("%s: Invalid stats or lane parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   msg_q_lane* p_lane = &p_msg_q->lanes[lane];
+
+   if( p_msg_q->is_ring )
+   {
+      /* sampled without synchronizing with the consumer, close enough for
+         statistics */
+      stats->depth = msg_ring_depth(p_lane->msg_ring) +
+                     __atomic_load_n(&p_lane->depth, __ATOMIC_RELAXED);
+      stats->max_depth = __atomic_load_n(&p_lane->max_depth, __ATOMIC_RELAXED);
+      stats->total = __atomic_load_n(&p_lane->msg_ring->enq_pos, __ATOMIC_RELAXED) +
+                     __atomic_load_n(&p_lane->total, __ATOMIC_RELAXED);
+      stats->dropped = __atomic_load_n(&p_lane->dropped, __ATOMIC_RELAXED);
+      stats->rejected = __atomic_load_n(&p_lane->rejected, __ATOMIC_RELAXED);
+      stats->blocked = __atomic_load_n(&p_lane->blocked, __ATOMIC_RELAXED);
+   }
+   else
+   {
+      pthread_mutex_lock(&p_msg_q->list_mutex);
+      stats->depth = p_lane->depth;
+      stats->max_depth = p_lane->max_depth;
+      stats->total = p_lane->total;
+      stats->dropped = p_lane->dropped;
+      stats->rejected = p_lane->rejected;
+      stats->blocked = p_lane->blocked;
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+   }
+
+   return eMSG_Q_SUCCESS;
+}
@@ -34,6 +34,7 @@ extern "C" {
 #endif /* __cplusplus */
 
 #include <stdlib.h>
+#include <stdint.h>
 
 /** Linked List Return Codes */
 typedef enum
@@ -50,8 +51,50 @@ typedef enum
      /**< Failed because an there were not enough resources. */
   eMSG_Q_INSUFFICIENT_BUFFER                 = -5,
      /**< Failed because an the supplied buffer was too small. */
+  eMSG_Q_QUEUE_FULL                          = -6,
+     /**< Failed because the queue is at its capacity. */
 }msq_q_err_type;
 
+/** Message Queue Overflow Policies, see msg_q_set_capacity */
+typedef enum
+{
+  eMSG_Q_OVERFLOW_BLOCK                      = 0,
+     /**< The sender waits until there is room. */
+  eMSG_Q_OVERFLOW_DROP_OLDEST                = 1,
+     /**< The oldest telemetry message is dropped to make room; if there is
+          none, a control message is queued over the capacity, and a
+          telemetry message is rejected. */
+  eMSG_Q_OVERFLOW_REJECT                     = 2,
+     /**< The message is rejected. */
+}msg_q_overflow_policy;
+
+/** Message Queue Lanes, in the order they are drained */
+typedef enum
+{
+  eMSG_Q_LANE_CONTROL                        = 0,
+     /**< Commands and state changes; always received first. */
+  eMSG_Q_LANE_TELEMETRY                      = 1,
+     /**< Periodic reports that can wait behind control messages. */
+  eMSG_Q_LANE_MAX
+}msg_q_lane_type;
+
+/** Message Queue Lane Statistics */
+typedef struct
+{
+  uint32_t depth;
+     /**< Number of messages currently waiting in the lane. */
+  uint32_t max_depth;
+     /**< Highest number of messages seen waiting in the lane. */
+  uint64_t total;
+     /**< Number of messages sent to the lane. */
+  uint64_t dropped;
+     /**< Number of messages of the lane dropped to make room. */
+  uint64_t rejected;
+     /**< Number of messages for the lane rejected for lack of room. */
+  uint64_t blocked;
+     /**< Number of sends to the lane that had to wait for room. */
+}msg_q_lane_stats;
+
 /*===========================================================================
 FUNCTION    msg_q_init
 
@@ -90,6 +133,66 @@ SIDE EFFECTS
 ===========================================================================*/
 const void* msg_q_init2();
 
+/*===========================================================================
+FUNCTION    msg_q_init_ring
+
+DESCRIPTION
+   Initializes a message queue that stores its messages in a bounded
+   lock-free ring instead of a mutex protected linked list. Any number of
+   threads may send to the queue, but only one thread may receive from it.
+   The receiver only makes a system call when it has to sleep, and senders
+   only make one when the receiver is sleeping.
+
+   msg_q_data: pointer to an opaque Q handle to be returned; NULL if fails
+   capacity:   number of messages the ring can hold; rounded up to a power
+               of 2. Messages sent while the ring is full go to a mutex
+               protected overflow list until it drains, so a sender never
+               waits for the receiver, not even the receiving thread itself.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_init_ring(void** msg_q_data, uint32_t capacity);
+
+/*===========================================================================
+FUNCTION    msg_q_set_capacity
+
+DESCRIPTION
+   Bounds the number of messages the message queue holds, over all lanes,
+   and sets what happens to a message sent while the queue is full. Must be
+   called right after the queue is initialized, before it is used. By
+   default a queue is unbounded, one from msg_q_init_ring too, its ring
+   overflowing into a list. For a ring queue the capacity is approximate
+   under concurrent sends, and the messages it drops are deallocated by the
+   receiving thread, the next time it receives. A message that is rejected
+   is not deallocated, and remains owned by the caller.
+
+   msg_q_data: Message Queue to bound.
+   capacity:   Maximum number of messages; 0 for no bound.
+   policy:     What to do with a message sent while the queue is full. With
+               eMSG_Q_OVERFLOW_BLOCK, a queue must not be sent to from its
+               own receiving thread.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_set_capacity(void* msg_q_data, uint32_t capacity,
+                                  msg_q_overflow_policy policy);
+
 /*===========================================================================
 FUNCTION    msg_q_destroy
 
@@ -135,12 +238,42 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    msg_q_snd_prio
+
+DESCRIPTION
+   Same as msg_q_snd, but sends data to the given lane of the message queue.
+   msg_q_snd sends to eMSG_Q_LANE_CONTROL. msg_q_rcv returns messages of the
+   control lane before those of the telemetry lane, except that after a burst
+   of control messages one waiting telemetry message is let through, so that
+   telemetry is never starved. Messages within a lane keep their order.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   lane:       Lane to add the element to.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_lane_type lane);
+
 /*===========================================================================
 FUNCTION    msg_q_rcv
 
 DESCRIPTION
    Retrieves data from the message queue. msg_obj is the oldest message received
-   and pointer is simply removed from message queue.
+   and pointer is simply removed from message queue. For a queue created with
+   msg_q_init_ring, this must always be called from the same thread.
 
    msg_q_data: Message Queue to copy data from into msgp.
    msg_obj:    Pointer to space to copy msg_q contents to.
@@ -157,6 +290,60 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj);
 
+/*===========================================================================
+FUNCTION    msg_q_rcv_batch
+
+DESCRIPTION
+   Retrieves up to max_count messages from the message queue with a single
+   lock acquisition. Waits like msg_q_rcv until there is at least one
+   message, then takes every message that is pending, up to max_count, in
+   the same order repeated msg_q_rcv calls would return them.
+
+   msg_q_data: Message Queue to copy data from into msg_objs.
+   msg_objs:   Array of max_count pointers to copy msg_q contents to.
+   max_count:  Size of msg_objs.
+   count:      Set to the number of messages copied to msg_objs.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs, uint32_t max_count,
+                               uint32_t* count);
+
+/*===========================================================================
+FUNCTION    msg_q_try_rcv_batch
+
+DESCRIPTION
+   Same as msg_q_rcv_batch, but never waits: if there is no message pending,
+   it returns eMSG_Q_SUCCESS with count set to 0. For a queue created with
+   msg_q_init_ring, calls need not come from the same thread, as long as
+   they never overlap.
+
+   msg_q_data: Message Queue to copy data from into msg_objs.
+   msg_objs:   Array of max_count pointers to copy msg_q contents to.
+   max_count:  Size of msg_objs.
+   count:      Set to the number of messages copied to msg_objs.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_try_rcv_batch(void* msg_q_data, void** msg_objs, uint32_t max_count,
+                                   uint32_t* count);
+
 /*===========================================================================
 FUNCTION    msg_q_flush
 
@@ -200,6 +387,31 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_unblock(void* msg_q_data);
 
+/*===========================================================================
+FUNCTION    msg_q_get_lane_stats
+
+DESCRIPTION
+   Reads the depth statistics of one lane of the message queue. For a queue
+   created with msg_q_init_ring, max_depth is only updated as messages are
+   received.
+
+   msg_q_data: Message queue to read the statistics of.
+   lane:       Lane to read the statistics of.
+   stats:      Filled in with the statistics of the lane.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_get_lane_stats(void* msg_q_data, msg_q_lane_type lane,
+                                    msg_q_lane_stats* stats);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */